@@ -0,0 +1,425 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_bench.c
+ *
+ * @brief  Benchmarks of the call control hot paths, run on simulated
+ *         devices (jabra_sim.c) so no hardware is needed:
+ *           usage_resolve   findUsage() of an output usage
+ *           write_usage     writeUsage() that sends a report
+ *           write_elided    writeUsage() of an unchanged value
+ *           decode          rdescDecode() of a telephony input report
+ *           call_step       one call control transition, outputs staged
+ *           dispatch        callEvent() to txnCommit() under the lock
+ *           fan_in          events from 64 devices through the event
+ *                           ring to a consumer thread
+ *         Every benchmark is run several times and the fastest run is
+ *         reported as one tab separated line: name, ns/op and ops/s.
+ *         fan_in pushes at full rate like the reader thread does, so
+ *         events are dropped whenever the consumer is behind. It prints
+ *         how many as a comment line and checks that every event was
+ *         either received or counted as dropped, and none reordered.
+ *
+ *         With -b a previous output is read as baseline and the program
+ *         fails when a benchmark got slower than the threshold (-t, in
+ *         percent) allows. -o writes the results to a file as well.
+ *
+ *         Usage: jabra_bench [-q] [-o results] [-b baseline] [-t percent]
+ *         Build and run with make bench, see the Makefile.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jabra_callctl.h"
+#include "jabra_device.h"
+#include "jabra_hid.h"
+#include "jabra_latency.h"
+#include "jabra_log.h"
+#include "jabra_rdesc.h"
+#include "jabra_ring.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+#define BENCH_RUNS           5
+#define BENCH_MAX            16
+#define FANIN_DEVICES        64
+
+struct bench_result {
+  char name[32];
+  double ns_per_op;
+};
+
+/* producer side of fan_in */
+struct fanin {
+  struct event_ring *ring;
+  unsigned long events;
+};
+
+/****************************************************************************/
+/*                              PRIVATE DATA                                */
+/****************************************************************************/
+
+/* same descriptor as the headsets of jabra_uhid_headset.c */
+static const __u8 report_descriptor[] = {
+  0x05, 0x0B, 0x09, 0x05, 0xA1, 0x01,
+  0x85, 0x01, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x02,
+  0x09, 0x20, 0x09, 0x2F, 0x81, 0x02,
+  0x05, 0x0C, 0x09, 0xE9, 0x09, 0xEA, 0x81, 0x02,
+  0x95, 0x04, 0x81, 0x03,
+  0x85, 0x02, 0x05, 0x08, 0x95, 0x03, 0x09, 0x09, 0x09, 0x17, 0x09, 0x18, 0x91, 0x02,
+  0x05, 0x0B, 0x95, 0x01, 0x09, 0x9E, 0x91, 0x02,
+  0x95, 0x04, 0x91, 0x03,
+  0xC0,
+};
+
+static struct bench_result results[BENCH_MAX];
+static int n_results = 0;
+static unsigned long iterations = 1000000;
+static int fanin_failed = 0;
+
+/* the fan_in devices, only their addresses are used */
+static char fanin_dev[FANIN_DEVICES];
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static void report(const char *name, __u64 best_ns, unsigned long ops) {
+  struct bench_result *r = &results[n_results++];
+
+  snprintf(r->name, sizeof(r->name), "%s", name);
+  r->ns_per_op = (double) best_ns / ops;
+  fprintf(stdout, "%s\t%.2f\t%.0f\n", r->name, r->ns_per_op, 1e9 / r->ns_per_op);
+}
+
+static void benchUsageResolve(struct jabra_device *dev) {
+  __u64 best = ~0ull;
+  unsigned long hits = 0;
+
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    __u64 t0 = latencyNow();
+    for (unsigned long i = 0; i < iterations; i++) {
+      /* the code varies so the lookup cannot be hoisted */
+      __u16 code = (i & 1) ? Led_Ring : Led_Mute;
+      hits += findUsage(&dev->usages, HID_REPORT_TYPE_OUTPUT, (LEDUsagePage << 16) | code) != NULL;
+    }
+    __u64 t = latencyNow() - t0;
+    if (t < best)
+      best = t;
+  }
+  if (hits != BENCH_RUNS * iterations)
+    fprintf(stderr, "usage_resolve: usage not found\n");
+  report("usage_resolve", best, iterations);
+}
+
+static void benchWriteUsage(struct jabra_device *dev, const char *name, int toggle) {
+  __u64 best = ~0ull;
+
+  (void)pthread_mutex_lock(&dev->lock);
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    __u64 t0 = latencyNow();
+    for (unsigned long i = 0; i < iterations; i++) {
+      writeUsage(dev, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Mute, toggle ? (i & 1) : 1);
+    }
+    __u64 t = latencyNow() - t0;
+    if (t < best)
+      best = t;
+  }
+  (void)pthread_mutex_unlock(&dev->lock);
+  report(name, best, iterations);
+}
+
+static void benchDecode(void) {
+  static struct rdesc rd;
+  static struct rdesc_decoder dec;
+  static struct rdesc_state st;
+  struct hiddev_event ev[8];
+  __u8 in[2][2 + RDESC_DECODE_PAD] = { { 1, 0x01 }, { 1, 0x02 } };
+  unsigned long events = 0;
+  __u64 best = ~0ull;
+
+  if (rdescParse(&rd, report_descriptor, sizeof(report_descriptor)) < 0) {
+    fprintf(stderr, "decode: descriptor not parsed\n");
+    return;
+  }
+  rdescCompile(&rd, &dec);
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    __u64 t0 = latencyNow();
+    for (unsigned long i = 0; i < iterations; i++) {
+      events += rdescDecode(&dec, &st, in[i & 1], 2, ev, 8);
+    }
+    __u64 t = latencyNow() - t0;
+    if (t < best)
+      best = t;
+  }
+  if (events == 0)
+    fprintf(stderr, "decode: no events\n");
+  report("decode", best, iterations);
+}
+
+static void benchCallStep(struct jabra_device *dev) {
+  static const int script[] = {
+    CALL_EV_KEY_RING, CALL_EV_HOOK_OFF, CALL_EV_MUTE, CALL_EV_MUTE, CALL_EV_HOOK_ON,
+  };
+  struct output_txn txn;
+  __u64 best = ~0ull;
+
+  (void)pthread_mutex_lock(&dev->lock);
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    __u64 t0 = latencyNow();
+    for (unsigned long i = 0; i < iterations; i++) {
+      txnBegin(&txn, dev);
+      (void)callStep(dev, &txn, script[i % (sizeof(script) / sizeof(script[0]))]);
+    }
+    __u64 t = latencyNow() - t0;
+    if (t < best)
+      best = t;
+  }
+  (void)pthread_mutex_unlock(&dev->lock);
+  report("call_step", best, iterations);
+}
+
+/* what the handler thread does for a batch of one event */
+static void benchDispatch(struct jabra_device *dev) {
+  struct output_txn txn;
+  __u64 best = ~0ull;
+  int event;
+
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    __u64 t0 = latencyNow();
+    for (unsigned long i = 0; i < iterations; i++) {
+      __u32 hid = (i & 2) ? ((TelephonyUsagePage << 16) | Tel_Phone_Mute) :
+                            ((TelephonyUsagePage << 16) | Tel_Hook_Switch);
+      (void)pthread_mutex_lock(&dev->lock);
+      txnBegin(&txn, dev);
+      if ((event = callEvent(hid, (i & 1) == 0)) >= 0)
+        (void)callStep(dev, &txn, event);
+      txnCommit(&txn);
+      (void)pthread_mutex_unlock(&dev->lock);
+    }
+    __u64 t = latencyNow() - t0;
+    if (t < best)
+      best = t;
+  }
+  report("dispatch", best, iterations);
+}
+
+/* reader thread: events round robin from every device, value is the
+ * per device sequence number. Never waits for room, like the reader */
+static void* fanin_producer(void *ptr) {
+  struct fanin *f = ptr;
+  struct hiddev_event ev;
+  __s32 seq[FANIN_DEVICES] = { 0 };
+
+  ev.hid = (TelephonyUsagePage << 16) | Tel_Hook_Switch;
+  for (unsigned long i = 0; i < f->events; i++) {
+    int d = i % FANIN_DEVICES;
+    ev.value = seq[d]++;
+    (void)ringPush(f->ring, &fanin_dev[d], RING_EVENT, &ev, 0, 0);
+    if ((i & 63) == 63)
+      ringWake(f->ring);
+  }
+  ringPushControl(f->ring, NULL, RING_STOP);
+  return (void*)0;
+}
+
+static void benchFanIn(void) {
+  static struct event_ring ring;
+  struct ring_record rec[64];
+  struct fanin f;
+  pthread_t producer;
+  __u64 best = ~0ull;
+  unsigned long dropped = 0;
+  unsigned high_water = 0;
+
+  f.ring = &ring;
+  f.events = iterations * 4;
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    __s32 last[FANIN_DEVICES];
+    unsigned long received = 0;
+    int stop = 0;
+
+    if (ringInit(&ring) < 0) {
+      fanin_failed = 1;
+      return;
+    }
+    memset(last, 0xFF, sizeof(last));
+    __u64 t0 = latencyNow();
+    if (pthread_create(&producer, NULL, fanin_producer, &f)) {
+      fprintf(stderr, "Error creating thread\n");
+      ringClose(&ring);
+      fanin_failed = 1;
+      return;
+    }
+    while (!stop) {
+      int n = ringPop(&ring, rec, sizeof(rec) / sizeof(rec[0]));
+      if (n == 0) {
+        ringWait(&ring);
+        continue;
+      }
+      for (int i = 0; i < n; i++) {
+        if (rec[i].kind == RING_STOP) {
+          stop = 1;
+          break;
+        }
+        int d = (char *) rec[i].dev - fanin_dev;
+        if (rec[i].ev.value <= last[d])
+          fanin_failed = 1;
+        last[d] = rec[i].ev.value;
+        received++;
+      }
+    }
+    __u64 t = latencyNow() - t0;
+    (void)pthread_join(producer, NULL);
+    if (received + ring.dropped != f.events || received != ring.pushed)
+      fanin_failed = 1;
+    ringClose(&ring);
+    if (t < best) {
+      best = t;
+      dropped = ring.dropped;
+      high_water = ring.high_water;
+    }
+  }
+  if (fanin_failed)
+    fprintf(stderr, "fan_in: events lost or reordered\n");
+  fprintf(stdout, "# fan_in dropped %lu of %lu events, high water %u\n",
+    dropped, f.events, high_water);
+  report("fan_in", best, f.events);
+}
+
+/* lines of a previous run: name, ns/op, ops/s */
+static int checkBaseline(const char *path, double threshold) {
+  char line[128], name[32];
+  double ns;
+  FILE *f;
+  int regressions = 0;
+
+  if ((f = fopen(path, "re")) == NULL) {
+    perror(path);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (line[0] == '#' || sscanf(line, "%31s %lf", name, &ns) != 2 || ns <= 0) {
+      continue;
+    }
+    for (int i = 0; i < n_results; i++) {
+      if (strcmp(results[i].name, name) == 0 &&
+          results[i].ns_per_op > ns * (1.0 + threshold / 100.0)) {
+        fprintf(stderr, "%s: %.2f ns/op, baseline %.2f ns/op (+%.0f%%, limit %.0f%%)\n",
+          name, results[i].ns_per_op, ns, (results[i].ns_per_op / ns - 1.0) * 100.0, threshold);
+        regressions++;
+      }
+    }
+  }
+  fclose(f);
+  return regressions;
+}
+
+static int writeResults(const char *path) {
+  FILE *f;
+
+  if ((f = fopen(path, "we")) == NULL) {
+    perror(path);
+    return -1;
+  }
+  fprintf(f, "# name\tns/op\tops/s\n");
+  for (int i = 0; i < n_results; i++) {
+    fprintf(f, "%s\t%.2f\t%.0f\n", results[i].name, results[i].ns_per_op,
+      1e9 / results[i].ns_per_op);
+  }
+  return fclose(f);
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int main(int argc, char **argv) {
+  const char *output = NULL, *baseline = NULL;
+  double threshold = 20.0;
+  struct jabra_device *dev;
+  int regressions = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "qo:b:t:")) != -1) {
+    switch (opt) {
+      case 'q':
+        iterations /= 10;
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      case 'b':
+        baseline = optarg;
+        break;
+      case 't':
+        threshold = atof(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-q] [-o results] [-b baseline] [-t percent]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  if (logInit(LOG_WARN) < 0) {
+    return 2;
+  }
+  /* the script never runs, the device only serves the output path */
+  dev = deviceOpen(&sim_transport, "sim0:basic,period=1000000000,repeat=0", 0);
+  if (dev == NULL) {
+    logClose();
+    return 2;
+  }
+
+  fprintf(stdout, "# name\tns/op\tops/s\n");
+  benchUsageResolve(dev);
+  benchWriteUsage(dev, "write_usage", 1);
+  benchWriteUsage(dev, "write_elided", 0);
+  benchDecode();
+  benchCallStep(dev);
+  benchDispatch(dev);
+  benchFanIn();
+
+  deviceClose(dev);
+  logClose();
+
+  if (output != NULL && writeResults(output) < 0) {
+    return 2;
+  }
+  if (baseline != NULL && (regressions = checkBaseline(baseline, threshold)) < 0) {
+    return 2;
+  }
+  if (fanin_failed || regressions > 0) {
+    return 1;
+  }
+  return 0;
+}
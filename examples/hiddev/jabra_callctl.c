@@ -0,0 +1,139 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_callctl.c
+ *
+ * @brief  Call control state machine, see jabra_callctl.h.
+ *
+ *         The transitions are written once as constant expressions of
+ *         state and event and expanded by the preprocessor into the full
+ *         CALL_STATES x CALL_EVENTS table, so a step is one indexed load
+ *         whatever the event.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <linux/hiddev.h>
+
+#include "jabra_callctl.h"
+#include "jabra_hid.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+#define HOOK(s)              ((s) & CALL_HOOK)
+#define MUTE(s)              ((s) & CALL_MUTE)
+
+/* lifting the hook answers the call, so the ringer stops */
+#define LIFT(s)              (((s) | CALL_HOOK) & ~CALL_RING)
+#define PLACE(s)             ((s) & ~CALL_HOOK)
+
+#define NEXT(s, e) \
+  ((e) == CALL_EV_HOOK_ON  ? LIFT(s) : \
+   (e) == CALL_EV_HOOK_OFF ? PLACE(s) : \
+   (e) == CALL_EV_MUTE     ? (s) ^ CALL_MUTE : \
+   (e) == CALL_EV_KEY_HOOK ? (HOOK(s) ? PLACE(s) : LIFT(s)) : \
+   (e) == CALL_EV_KEY_MUTE ? (s) ^ CALL_MUTE : \
+                             (s) ^ CALL_RING)
+
+#define OUTPUTS(s, e) \
+  ((e) == CALL_EV_HOOK_ON  ? (HOOK(s) ? 0 : CALL_OUT_OFF_HOOK | CALL_OUT_RING) : \
+   (e) == CALL_EV_HOOK_OFF ? (HOOK(s) ? CALL_OUT_OFF_HOOK : 0) : \
+   (e) == CALL_EV_MUTE     ? CALL_OUT_MUTE : \
+   (e) == CALL_EV_KEY_HOOK ? (HOOK(s) ? CALL_OUT_OFF_HOOK : CALL_OUT_OFF_HOOK | CALL_OUT_RING) : \
+   (e) == CALL_EV_KEY_MUTE ? CALL_OUT_MUTE : \
+                             CALL_OUT_RING)
+
+#define MESSAGE(s, e) \
+  ((e) == CALL_EV_HOOK_ON  ? (HOOK(s) ? CALL_MSG_NONE : CALL_MSG_HOOK_LIFTED) : \
+   (e) == CALL_EV_HOOK_OFF ? (HOOK(s) ? CALL_MSG_HOOK_PLACED : CALL_MSG_NONE) : \
+   (e) == CALL_EV_MUTE     ? (MUTE(s) ? CALL_MSG_UNMUTED : CALL_MSG_MUTED) : \
+   (e) == CALL_EV_KEY_HOOK ? (HOOK(s) ? CALL_MSG_KEY_PUTBACK : CALL_MSG_KEY_LIFT) : \
+   (e) == CALL_EV_KEY_MUTE ? (MUTE(s) ? CALL_MSG_KEY_UNMUTE : CALL_MSG_KEY_MUTE) : \
+                             CALL_MSG_NONE)
+
+#define T(s, e)              { NEXT(s, e), OUTPUTS(s, e), MESSAGE(s, e) }
+#define ROW(s)               { T(s, 0), T(s, 1), T(s, 2), T(s, 3), T(s, 4), T(s, 5) }
+
+/****************************************************************************/
+/*                              PRIVATE DATA                                */
+/****************************************************************************/
+static const char *const messages[] = {
+  [CALL_MSG_NONE]        = "",
+  [CALL_MSG_HOOK_LIFTED] = "--> Hook lifted",
+  [CALL_MSG_HOOK_PLACED] = "--> Hook in place",
+  [CALL_MSG_MUTED]       = "--> Muted",
+  [CALL_MSG_UNMUTED]     = "--> Unmuted",
+  [CALL_MSG_KEY_LIFT]    = "<-- Lift Hook",
+  [CALL_MSG_KEY_PUTBACK] = "<-- Put back Hook",
+  [CALL_MSG_KEY_MUTE]    = "<-- Mute",
+  [CALL_MSG_KEY_UNMUTE]  = "<-- Unmute",
+};
+
+/****************************************************************************/
+/*                              EXPORTED DATA                               */
+/****************************************************************************/
+const struct call_transition callTable[CALL_STATES][CALL_EVENTS] = {
+  ROW(0), ROW(1), ROW(2), ROW(3), ROW(4), ROW(5), ROW(6), ROW(7)
+};
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int callEvent(__u32 hid, __s32 value) {
+  switch (hid) {
+    case (TelephonyUsagePage << 16) | Tel_Hook_Switch:
+      return value ? CALL_EV_HOOK_ON : CALL_EV_HOOK_OFF;
+    case (TelephonyUsagePage << 16) | Tel_Phone_Mute:
+      return value == 1 ? CALL_EV_MUTE : -1;
+    default:
+      return -1;
+  }
+}
+
+const char *callMessage(int message) {
+  return messages[message];
+}
+
+int callStep(struct jabra_device *dev, struct output_txn *txn, int event) {
+  const struct call_transition *t;
+  __u32 next;
+
+  t = &callTable[callState(dev) & (CALL_STATES - 1)][event];
+  next = t->next;
+  callStateUpdate(dev, next);
+
+  if (t->outputs & CALL_OUT_RING) {
+    txnStage(txn, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Ring, (next & CALL_RING) != 0);
+    txnStage(txn, HID_REPORT_TYPE_OUTPUT, TelephonyUsagePage, Tel_Ringer, (next & CALL_RING) != 0);
+  }
+  if (t->outputs & CALL_OUT_OFF_HOOK) {
+    txnStage(txn, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Off_Hook, (next & CALL_HOOK) != 0);
+  }
+  if (t->outputs & CALL_OUT_MUTE) {
+    txnStage(txn, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Mute, (next & CALL_MUTE) != 0);
+  }
+  return t->message;
+}
@@ -0,0 +1,97 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_callctl.h
+ *
+ * @brief  Call control state machine. Hook, mute and ring are the state,
+ *         device input and local commands are the events, and a constant
+ *         table indexed by both gives the next state and the output
+ *         usages to write. The table and callEvent() need no device.
+ */
+
+#ifndef JABRA_CALLCTL_H
+#define JABRA_CALLCTL_H
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+
+#include "jabra_device.h"
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+
+/* States are the CALL_HOOK, CALL_MUTE and CALL_RING bits */
+#define CALL_STATES          8
+
+/* Events */
+#define CALL_EV_HOOK_ON      0   /* device hook switch lifted */
+#define CALL_EV_HOOK_OFF     1   /* device hook switch in place */
+#define CALL_EV_MUTE         2   /* device mute button pressed */
+#define CALL_EV_KEY_HOOK     3   /* local hook toggle */
+#define CALL_EV_KEY_MUTE     4   /* local mute toggle */
+#define CALL_EV_KEY_RING     5   /* local ringer toggle */
+#define CALL_EVENTS          6
+
+/* Outputs, written with the value of the next state */
+#define CALL_OUT_OFF_HOOK    0x01  /* Led_Off_Hook */
+#define CALL_OUT_MUTE        0x02  /* Led_Mute */
+#define CALL_OUT_RING        0x04  /* Led_Ring and Tel_Ringer */
+
+/* Messages */
+#define CALL_MSG_NONE        0
+#define CALL_MSG_HOOK_LIFTED 1
+#define CALL_MSG_HOOK_PLACED 2
+#define CALL_MSG_MUTED       3
+#define CALL_MSG_UNMUTED     4
+#define CALL_MSG_KEY_LIFT    5
+#define CALL_MSG_KEY_PUTBACK 6
+#define CALL_MSG_KEY_MUTE    7
+#define CALL_MSG_KEY_UNMUTE  8
+
+struct call_transition {
+  __u8 next;
+  __u8 outputs;
+  __u8 message;
+};
+
+extern const struct call_transition callTable[CALL_STATES][CALL_EVENTS];
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+
+/* call control event of a device input, -1 if it is none */
+int callEvent(__u32 hid, __s32 value);
+
+const char *callMessage(int message);
+
+/* run one event on the device: update the call state and stage the
+ * outputs into txn, which must belong to dev. The device lock must be
+ * held. Returns the message to show */
+int callStep(struct jabra_device *dev, struct output_txn *txn, int event);
+
+#endif /* JABRA_CALLCTL_H */
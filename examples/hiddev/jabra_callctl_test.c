@@ -0,0 +1,186 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_callctl_test.c
+ *
+ * @brief  Test of the call control table and of callEvent(). Every one
+ *         of the CALL_STATES x CALL_EVENTS cells of callTable is compared
+ *         with the transition written out below, and callEvent() is fed
+ *         the telephony inputs and usages that are no call control
+ *         event. Run by make check.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <stdio.h>
+
+#include "jabra_callctl.h"
+#include "jabra_hid.h"
+#include "jabra_test.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+#define USAGE(page, id)      (((__u32) (page) << 16) | (id))
+
+struct cell {
+  __u8 state;
+  __u8 event;
+  __u8 next;
+  __u8 outputs;
+  __u8 message;
+};
+
+struct input {
+  __u32 hid;
+  __s32 value;
+  int event;
+};
+
+/****************************************************************************/
+/*                              PRIVATE DATA                                */
+/****************************************************************************/
+/* state, event: next state, outputs and message */
+static const struct cell cells[CALL_STATES * CALL_EVENTS] = {
+  { 0, CALL_EV_HOOK_ON, CALL_HOOK, CALL_OUT_OFF_HOOK | CALL_OUT_RING, CALL_MSG_HOOK_LIFTED },
+  { 0, CALL_EV_HOOK_OFF, 0, 0, CALL_MSG_NONE },
+  { 0, CALL_EV_MUTE, CALL_MUTE, CALL_OUT_MUTE, CALL_MSG_MUTED },
+  { 0, CALL_EV_KEY_HOOK, CALL_HOOK, CALL_OUT_OFF_HOOK | CALL_OUT_RING, CALL_MSG_KEY_LIFT },
+  { 0, CALL_EV_KEY_MUTE, CALL_MUTE, CALL_OUT_MUTE, CALL_MSG_KEY_MUTE },
+  { 0, CALL_EV_KEY_RING, CALL_RING, CALL_OUT_RING, CALL_MSG_NONE },
+  { CALL_HOOK, CALL_EV_HOOK_ON, CALL_HOOK, 0, CALL_MSG_NONE },
+  { CALL_HOOK, CALL_EV_HOOK_OFF, 0, CALL_OUT_OFF_HOOK, CALL_MSG_HOOK_PLACED },
+  { CALL_HOOK, CALL_EV_MUTE, CALL_HOOK | CALL_MUTE, CALL_OUT_MUTE, CALL_MSG_MUTED },
+  { CALL_HOOK, CALL_EV_KEY_HOOK, 0, CALL_OUT_OFF_HOOK, CALL_MSG_KEY_PUTBACK },
+  { CALL_HOOK, CALL_EV_KEY_MUTE, CALL_HOOK | CALL_MUTE, CALL_OUT_MUTE, CALL_MSG_KEY_MUTE },
+  { CALL_HOOK, CALL_EV_KEY_RING, CALL_HOOK | CALL_RING, CALL_OUT_RING, CALL_MSG_NONE },
+  { CALL_MUTE, CALL_EV_HOOK_ON, CALL_HOOK | CALL_MUTE, CALL_OUT_OFF_HOOK | CALL_OUT_RING, CALL_MSG_HOOK_LIFTED },
+  { CALL_MUTE, CALL_EV_HOOK_OFF, CALL_MUTE, 0, CALL_MSG_NONE },
+  { CALL_MUTE, CALL_EV_MUTE, 0, CALL_OUT_MUTE, CALL_MSG_UNMUTED },
+  { CALL_MUTE, CALL_EV_KEY_HOOK, CALL_HOOK | CALL_MUTE, CALL_OUT_OFF_HOOK | CALL_OUT_RING, CALL_MSG_KEY_LIFT },
+  { CALL_MUTE, CALL_EV_KEY_MUTE, 0, CALL_OUT_MUTE, CALL_MSG_KEY_UNMUTE },
+  { CALL_MUTE, CALL_EV_KEY_RING, CALL_MUTE | CALL_RING, CALL_OUT_RING, CALL_MSG_NONE },
+  { CALL_HOOK | CALL_MUTE, CALL_EV_HOOK_ON, CALL_HOOK | CALL_MUTE, 0, CALL_MSG_NONE },
+  { CALL_HOOK | CALL_MUTE, CALL_EV_HOOK_OFF, CALL_MUTE, CALL_OUT_OFF_HOOK, CALL_MSG_HOOK_PLACED },
+  { CALL_HOOK | CALL_MUTE, CALL_EV_MUTE, CALL_HOOK, CALL_OUT_MUTE, CALL_MSG_UNMUTED },
+  { CALL_HOOK | CALL_MUTE, CALL_EV_KEY_HOOK, CALL_MUTE, CALL_OUT_OFF_HOOK, CALL_MSG_KEY_PUTBACK },
+  { CALL_HOOK | CALL_MUTE, CALL_EV_KEY_MUTE, CALL_HOOK, CALL_OUT_MUTE, CALL_MSG_KEY_UNMUTE },
+  { CALL_HOOK | CALL_MUTE, CALL_EV_KEY_RING, CALL_HOOK | CALL_MUTE | CALL_RING, CALL_OUT_RING, CALL_MSG_NONE },
+  { CALL_RING, CALL_EV_HOOK_ON, CALL_HOOK, CALL_OUT_OFF_HOOK | CALL_OUT_RING, CALL_MSG_HOOK_LIFTED },
+  { CALL_RING, CALL_EV_HOOK_OFF, CALL_RING, 0, CALL_MSG_NONE },
+  { CALL_RING, CALL_EV_MUTE, CALL_MUTE | CALL_RING, CALL_OUT_MUTE, CALL_MSG_MUTED },
+  { CALL_RING, CALL_EV_KEY_HOOK, CALL_HOOK, CALL_OUT_OFF_HOOK | CALL_OUT_RING, CALL_MSG_KEY_LIFT },
+  { CALL_RING, CALL_EV_KEY_MUTE, CALL_MUTE | CALL_RING, CALL_OUT_MUTE, CALL_MSG_KEY_MUTE },
+  { CALL_RING, CALL_EV_KEY_RING, 0, CALL_OUT_RING, CALL_MSG_NONE },
+  { CALL_HOOK | CALL_RING, CALL_EV_HOOK_ON, CALL_HOOK, 0, CALL_MSG_NONE },
+  { CALL_HOOK | CALL_RING, CALL_EV_HOOK_OFF, CALL_RING, CALL_OUT_OFF_HOOK, CALL_MSG_HOOK_PLACED },
+  { CALL_HOOK | CALL_RING, CALL_EV_MUTE, CALL_HOOK | CALL_MUTE | CALL_RING, CALL_OUT_MUTE, CALL_MSG_MUTED },
+  { CALL_HOOK | CALL_RING, CALL_EV_KEY_HOOK, CALL_RING, CALL_OUT_OFF_HOOK, CALL_MSG_KEY_PUTBACK },
+  { CALL_HOOK | CALL_RING, CALL_EV_KEY_MUTE, CALL_HOOK | CALL_MUTE | CALL_RING, CALL_OUT_MUTE, CALL_MSG_KEY_MUTE },
+  { CALL_HOOK | CALL_RING, CALL_EV_KEY_RING, CALL_HOOK, CALL_OUT_RING, CALL_MSG_NONE },
+  { CALL_MUTE | CALL_RING, CALL_EV_HOOK_ON, CALL_HOOK | CALL_MUTE, CALL_OUT_OFF_HOOK | CALL_OUT_RING, CALL_MSG_HOOK_LIFTED },
+  { CALL_MUTE | CALL_RING, CALL_EV_HOOK_OFF, CALL_MUTE | CALL_RING, 0, CALL_MSG_NONE },
+  { CALL_MUTE | CALL_RING, CALL_EV_MUTE, CALL_RING, CALL_OUT_MUTE, CALL_MSG_UNMUTED },
+  { CALL_MUTE | CALL_RING, CALL_EV_KEY_HOOK, CALL_HOOK | CALL_MUTE, CALL_OUT_OFF_HOOK | CALL_OUT_RING, CALL_MSG_KEY_LIFT },
+  { CALL_MUTE | CALL_RING, CALL_EV_KEY_MUTE, CALL_RING, CALL_OUT_MUTE, CALL_MSG_KEY_UNMUTE },
+  { CALL_MUTE | CALL_RING, CALL_EV_KEY_RING, CALL_MUTE, CALL_OUT_RING, CALL_MSG_NONE },
+  { CALL_HOOK | CALL_MUTE | CALL_RING, CALL_EV_HOOK_ON, CALL_HOOK | CALL_MUTE, 0, CALL_MSG_NONE },
+  { CALL_HOOK | CALL_MUTE | CALL_RING, CALL_EV_HOOK_OFF, CALL_MUTE | CALL_RING, CALL_OUT_OFF_HOOK, CALL_MSG_HOOK_PLACED },
+  { CALL_HOOK | CALL_MUTE | CALL_RING, CALL_EV_MUTE, CALL_HOOK | CALL_RING, CALL_OUT_MUTE, CALL_MSG_UNMUTED },
+  { CALL_HOOK | CALL_MUTE | CALL_RING, CALL_EV_KEY_HOOK, CALL_MUTE | CALL_RING, CALL_OUT_OFF_HOOK, CALL_MSG_KEY_PUTBACK },
+  { CALL_HOOK | CALL_MUTE | CALL_RING, CALL_EV_KEY_MUTE, CALL_HOOK | CALL_RING, CALL_OUT_MUTE, CALL_MSG_KEY_UNMUTE },
+  { CALL_HOOK | CALL_MUTE | CALL_RING, CALL_EV_KEY_RING, CALL_HOOK | CALL_MUTE, CALL_OUT_RING, CALL_MSG_NONE },
+};
+
+static const struct input inputs[] = {
+  { USAGE(TelephonyUsagePage, Tel_Hook_Switch), 1, CALL_EV_HOOK_ON },
+  { USAGE(TelephonyUsagePage, Tel_Hook_Switch), 0, CALL_EV_HOOK_OFF },
+  { USAGE(TelephonyUsagePage, Tel_Hook_Switch), 2, CALL_EV_HOOK_ON },
+  { USAGE(TelephonyUsagePage, Tel_Phone_Mute), 1, CALL_EV_MUTE },
+  /* the release of the mute button */
+  { USAGE(TelephonyUsagePage, Tel_Phone_Mute), 0, -1 },
+  { USAGE(TelephonyUsagePage, Tel_Phone_Mute), 2, -1 },
+  /* no call control event */
+  { USAGE(TelephonyUsagePage, Tel_Flash), 1, -1 },
+  { USAGE(ConsumerUsagePage, Con_Volume_Incr), 1, -1 },
+  { USAGE(ConsumerUsagePage, Con_Volume_Decr), 1, -1 },
+  { USAGE(LEDUsagePage, Led_Off_Hook), 1, -1 },
+  { USAGE(LEDUsagePage, Led_Mute), 1, -1 },
+  /* the right ids on another page */
+  { USAGE(ConsumerUsagePage, Tel_Hook_Switch), 1, -1 },
+  { USAGE(LEDUsagePage, Tel_Phone_Mute), 1, -1 },
+  { Tel_Hook_Switch, 1, -1 },
+  { 0, 1, -1 },
+  { 0xFFFFFFFF, 1, -1 },
+};
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static void testTable(void) {
+  int seen[CALL_STATES][CALL_EVENTS] = { { 0 } };
+
+  for (unsigned i = 0; i < sizeof(cells) / sizeof(cells[0]); i++) {
+    const struct cell *c = &cells[i];
+    const struct call_transition *t = &callTable[c->state][c->event];
+
+    if (t->next != c->next || t->outputs != c->outputs || t->message != c->message) {
+      fprintf(stderr, "state %u, event %u: next %u outputs 0x%x message %u, "
+        "expected %u 0x%x %u\n", c->state, c->event, t->next, t->outputs, t->message,
+        c->next, c->outputs, c->message);
+      test_failures++;
+    }
+    seen[c->state][c->event]++;
+  }
+  /* the list above covers every cell once */
+  for (int s = 0; s < CALL_STATES; s++) {
+    for (int e = 0; e < CALL_EVENTS; e++) {
+      CHECK_EQ(seen[s][e], 1);
+      CHECK(callMessage(callTable[s][e].message) != NULL);
+    }
+  }
+}
+
+static void testEvents(void) {
+  for (unsigned i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+    int event = callEvent(inputs[i].hid, inputs[i].value);
+
+    if (event != inputs[i].event) {
+      fprintf(stderr, "callEvent(0x%08x, %d) = %d, expected %d\n",
+        inputs[i].hid, inputs[i].value, event, inputs[i].event);
+      test_failures++;
+    }
+  }
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int main(int argc, char **argv) {
+  testTable();
+  testEvents();
+  return testResult("jabra_callctl_test");
+}
@@ -0,0 +1,385 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_capcache.c
+ *
+ * @brief  Persistent capability cache, see jabra_capcache.h.
+ *
+ *         File layout, host byte order:
+ *           capcache_header
+ *           n_records times:
+ *             capcache_record
+ *             count times layout_usage
+ *
+ *         Every record carries a checksum of its usages, a record that
+ *         does not match is ignored and the device is walked again.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "jabra_capcache.h"
+#include "jabra_layout.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+#define CAPCACHE_MAGIC       0x5041434A  /* "JCAP" */
+#define CAPCACHE_FORMAT      1
+#define CAPCACHE_FILE        "jabra_hiddev_demo.caps"
+
+struct capcache_header {
+  __u32 magic;
+  __u16 format;
+  __u16 n_records;
+  __u32 size;            /* total file size */
+};
+
+struct capcache_record {
+  __u16 vendor;
+  __u16 product;
+  __s16 version;
+  __u16 count;
+  __u32 checksum;        /* FNV-1a of the usages that follow */
+};
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static __u32 checksum(const void *data, size_t len) {
+  const __u8 *p = data;
+  __u32 h = 2166136261u;
+
+  while (len--) {
+    h = (h ^ *p++) * 16777619u;
+  }
+  return h;
+}
+
+/* first record of a checked mapping, NULL if the file is unusable */
+static const struct capcache_record *firstRecord(const void *map, size_t size, int *n) {
+  const struct capcache_header *hdr = map;
+
+  if (map == NULL || size < sizeof(*hdr) ||
+      hdr->magic != CAPCACHE_MAGIC || hdr->format != CAPCACHE_FORMAT ||
+      hdr->size != size) {
+    return NULL;
+  }
+  *n = hdr->n_records;
+  return (const struct capcache_record *)(hdr + 1);
+}
+
+/* next record or NULL if rec would run past the end of the file */
+static const struct capcache_record *nextRecord(const void *map, size_t size,
+                                                const struct capcache_record *rec) {
+  size_t off = (const char *)rec - (const char *)map;
+
+  if (off + sizeof(*rec) > size ||
+      off + sizeof(*rec) + rec->count * sizeof(struct layout_usage) > size) {
+    return NULL;
+  }
+  return (const struct capcache_record *)
+    ((const char *)(rec + 1) + rec->count * sizeof(struct layout_usage));
+}
+
+static const struct capcache_record *findRecord(const void *map, size_t size,
+                                                __u16 vendor, __u16 product, __s16 version) {
+  const struct capcache_record *rec;
+  int n;
+
+  rec = firstRecord(map, size, &n);
+  for (int i = 0; rec != NULL && i < n; i++) {
+    const struct capcache_record *next = nextRecord(map, size, rec);
+    if (next == NULL) {
+      return NULL;
+    }
+    if (rec->vendor == vendor && rec->product == product && rec->version == version) {
+      return rec;
+    }
+    rec = next;
+  }
+  return NULL;
+}
+
+static int writeRecord(FILE *f, __u16 vendor, __u16 product, __s16 version,
+                       const struct layout_usage *cu, int count) {
+  struct capcache_record rec;
+
+  rec.vendor   = vendor;
+  rec.product  = product;
+  rec.version  = version;
+  rec.count    = count;
+  rec.checksum = checksum(cu, count * sizeof(*cu));
+  if (fwrite(&rec, sizeof(rec), 1, f) != 1 ||
+      (count > 0 && fwrite(cu, sizeof(*cu), count, f) != (size_t)count)) {
+    return -1;
+  }
+  return (int)(sizeof(rec) + count * sizeof(*cu));
+}
+
+/* a new file from the mkstemp() template tmp, never one that exists */
+static FILE *createFile(char *tmp) {
+  char dir[512];
+  char *slash;
+  FILE *f;
+  int fd;
+
+  if ((fd = mkstemp(tmp)) < 0 && errno == ENOENT) {
+    /* first run, create the cache directory */
+    snprintf(dir, sizeof(dir), "%.*s", (int) strlen(tmp) - 7, tmp);
+    if ((slash = strrchr(dir, '/')) != NULL && slash != dir) {
+      *slash = '\0';
+      (void)mkdir(dir, 0755);
+      /* the failed call has overwritten the template */
+      memcpy(tmp + strlen(tmp) - 6, "XXXXXX", 6);
+      fd = mkstemp(tmp);
+    }
+  }
+  if (fd < 0) {
+    return NULL;
+  }
+  if (fcntl(fd, F_SETFD, FD_CLOEXEC) < 0 || fchmod(fd, 0644) < 0 ||
+      (f = fdopen(fd, "w")) == NULL) {
+    close(fd);
+    unlink(tmp);
+    return NULL;
+  }
+  return f;
+}
+
+static void unmap(struct capcache *cc) {
+  if (cc->map != NULL) {
+    munmap((void *)cc->map, cc->size);
+    cc->map = NULL;
+    cc->size = 0;
+  }
+}
+
+static void mapFile(struct capcache *cc) {
+  struct stat st;
+  void *map;
+  int fd;
+  int n;
+
+  unmap(cc);
+  if ((fd = open(cc->path, O_RDONLY | O_CLOEXEC)) < 0) {
+    return;
+  }
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map != MAP_FAILED) {
+      cc->map = map;
+      cc->size = st.st_size;
+    }
+  }
+  close(fd);
+
+  if (cc->map != NULL && firstRecord(cc->map, cc->size, &n) == NULL) {
+    fprintf(stderr, "%s: not a valid capability cache, ignored\n", cc->path);
+    unmap(cc);
+  }
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int capcacheDefaultPath(char *path, size_t size) {
+  const char *env;
+
+  if ((env = getenv("JABRA_CAPCACHE")) != NULL) {
+    snprintf(path, size, "%s", env);
+  } else if ((env = getenv("XDG_CACHE_HOME")) != NULL) {
+    snprintf(path, size, "%s/" CAPCACHE_FILE, env);
+  } else if ((env = getenv("HOME")) != NULL) {
+    snprintf(path, size, "%s/.cache/" CAPCACHE_FILE, env);
+  } else {
+    path[0] = '\0';
+    return -1;
+  }
+  return 0;
+}
+
+void capcacheOpen(struct capcache *cc, const char *path) {
+  snprintf(cc->path, sizeof(cc->path), "%s", path);
+  pthread_mutex_init(&cc->lock, NULL);
+  cc->map = NULL;
+  cc->size = 0;
+  cc->pending = NULL;
+  mapFile(cc);
+}
+
+void capcacheClose(struct capcache *cc) {
+  while (cc->pending != NULL) {
+    struct capcache_pending *p = cc->pending;
+    cc->pending = p->next;
+    free(p);
+  }
+  unmap(cc);
+  pthread_mutex_destroy(&cc->lock);
+}
+
+int capcacheLoad(struct capcache *cc, __u16 vendor, __u16 product, __s16 version,
+                 struct usage_cache *usages) {
+  const struct capcache_record *rec;
+  const struct layout_usage *cu;
+  int ret = -1;
+
+  (void)pthread_mutex_lock(&cc->lock);
+  rec = findRecord(cc->map, cc->size, vendor, product, version);
+  if (rec != NULL && rec->count <= MAX_CACHED_USAGES) {
+    cu = (const struct layout_usage *)(rec + 1);
+    if (checksum(cu, rec->count * sizeof(*cu)) == rec->checksum) {
+      layoutUnpack(usages, cu, rec->count);
+      ret = 0;
+    }
+  }
+  (void)pthread_mutex_unlock(&cc->lock);
+  return ret;
+}
+
+void capcacheStore(struct capcache *cc, __u16 vendor, __u16 product, __s16 version,
+                   const struct usage_cache *usages) {
+  struct capcache_pending *p;
+
+  /* a later run would take the part that fitted for the whole device */
+  if (usages->skipped > 0) {
+    return;
+  }
+  (void)pthread_mutex_lock(&cc->lock);
+  for (p = cc->pending; p != NULL; p = p->next) {
+    if (p->vendor == vendor && p->product == product && p->version == version) {
+      break;
+    }
+  }
+  if (p == NULL && (p = malloc(sizeof(*p))) != NULL) {
+    p->vendor  = vendor;
+    p->product = product;
+    p->version = version;
+    p->next    = cc->pending;
+    cc->pending = p;
+  }
+  if (p != NULL) {
+    p->usages = *usages;
+  }
+  (void)pthread_mutex_unlock(&cc->lock);
+}
+
+int capcacheSync(struct capcache *cc) {
+  struct layout_usage cu[MAX_CACHED_USAGES];
+  struct capcache_header hdr;
+  const struct capcache_record *rec;
+  struct capcache_pending *p;
+  char tmp[sizeof(cc->path) + 8];
+  FILE *f;
+  int n = 0;
+  int ret = 0;
+
+  (void)pthread_mutex_lock(&cc->lock);
+  if (cc->pending == NULL) {
+    (void)pthread_mutex_unlock(&cc->lock);
+    return 0;
+  }
+
+  snprintf(tmp, sizeof(tmp), "%s.XXXXXX", cc->path);
+  if ((f = createFile(tmp)) == NULL) {
+    perror(tmp);
+    (void)pthread_mutex_unlock(&cc->lock);
+    return -1;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  if (fwrite(&hdr, sizeof(hdr), 1, f) != 1) {
+    ret = -1;
+  }
+  hdr.size = sizeof(hdr);
+
+  /* new models first, then the old records that were not replaced */
+  for (p = cc->pending; p != NULL && ret == 0; p = p->next) {
+    layoutPack(cu, &p->usages);
+    int len = writeRecord(f, p->vendor, p->product, p->version, cu, p->usages.count);
+    if (len < 0) {
+      ret = -1;
+    }
+    hdr.size += len;
+    n++;
+  }
+
+  int old_n = 0;
+  rec = firstRecord(cc->map, cc->size, &old_n);
+  for (int i = 0; rec != NULL && i < old_n && ret == 0; i++) {
+    const struct capcache_record *next = nextRecord(cc->map, cc->size, rec);
+    if (next == NULL) {
+      break;
+    }
+    for (p = cc->pending; p != NULL; p = p->next) {
+      if (p->vendor == rec->vendor && p->product == rec->product && p->version == rec->version)
+        break;
+    }
+    if (p == NULL) {
+      int len = writeRecord(f, rec->vendor, rec->product, rec->version,
+                            (const struct layout_usage *)(rec + 1), rec->count);
+      if (len < 0) {
+        ret = -1;
+      }
+      hdr.size += len;
+      n++;
+    }
+    rec = next;
+  }
+
+  hdr.magic     = CAPCACHE_MAGIC;
+  hdr.format    = CAPCACHE_FORMAT;
+  hdr.n_records = n;
+  if (ret == 0 && (fseek(f, 0, SEEK_SET) < 0 || fwrite(&hdr, sizeof(hdr), 1, f) != 1)) {
+    ret = -1;
+  }
+  if (fclose(f) != 0) {
+    ret = -1;
+  }
+  if (ret == 0 && rename(tmp, cc->path) < 0) {
+    ret = -1;
+  }
+  if (ret < 0) {
+    perror(cc->path);
+    unlink(tmp);
+  } else {
+    while (cc->pending != NULL) {
+      p = cc->pending;
+      cc->pending = p->next;
+      free(p);
+    }
+    mapFile(cc);
+  }
+  (void)pthread_mutex_unlock(&cc->lock);
+  return ret;
+}
@@ -0,0 +1,95 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_capcache.h
+ *
+ * @brief  Persistent capability cache. Keeps the usage to report/field/
+ *         index map and logical ranges of every device model seen, keyed
+ *         by vendor, product and version from HIDIOCGDEVINFO, so known
+ *         devices skip the report descriptor walk at startup.
+ *
+ *         The file is memory-mapped read-only. New or changed models are
+ *         collected in memory and written by capcacheSync() to a new file,
+ *         created with a unique name next to the old one, that replaces
+ *         it.
+ */
+
+#ifndef JABRA_CAPCACHE_H
+#define JABRA_CAPCACHE_H
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+#include <pthread.h>
+#include <stddef.h>
+
+#include "jabra_device.h"
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+
+/* Model not yet written to the cache file */
+struct capcache_pending {
+  struct capcache_pending *next;
+  __u16 vendor;
+  __u16 product;
+  __s16 version;
+  struct usage_cache usages;
+};
+
+struct capcache {
+  char path[256];
+  pthread_mutex_t lock;
+  const void *map;       /* current file contents, NULL if none */
+  size_t size;
+  struct capcache_pending *pending;
+};
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+
+/* $JABRA_CAPCACHE, else $XDG_CACHE_HOME or ~/.cache based, -1 if there
+ * is none of them: a shared directory like /tmp is no place for it */
+int capcacheDefaultPath(char *path, size_t size);
+
+/* map the cache file, a missing or corrupt file gives an empty cache */
+void capcacheOpen(struct capcache *cc, const char *path);
+void capcacheClose(struct capcache *cc);
+
+/* fill usages from the cache, -1 if the model is not cached */
+int capcacheLoad(struct capcache *cc, __u16 vendor, __u16 product, __s16 version,
+                 struct usage_cache *usages);
+
+/* remember the usages of a model for the next capcacheSync(), unless
+ * some of its fields did not fit the usage cache */
+void capcacheStore(struct capcache *cc, __u16 vendor, __u16 product, __s16 version,
+                   const struct usage_cache *usages);
+
+/* write the file if models were stored since the last sync */
+int capcacheSync(struct capcache *cc);
+
+#endif /* JABRA_CAPCACHE_H */
@@ -0,0 +1,196 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_capcache_test.c
+ *
+ * @brief  Test of the capability cache of jabra_capcache.h in a
+ *         temporary directory. The test checks:
+ *           - that a stored layout is written, in a directory created
+ *             on the first sync, and read back the same;
+ *           - that the file is written through a new file of its own,
+ *             so a symbolic link planted next to it is not followed;
+ *           - that a layout with fields left out of the usage cache is
+ *             not stored;
+ *           - that there is no default path without a cache directory.
+ *         Run by make check.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "jabra_capcache.h"
+#include "jabra_test.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+#define VENDOR               0x0B0E
+#define PRODUCT              0x0412
+#define VERSION              0x0100
+
+/****************************************************************************/
+/*                              PRIVATE DATA                                */
+/****************************************************************************/
+static struct usage_cache layout;
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static void makeLayout(struct usage_cache *u, int count) {
+  memset(u, 0, sizeof(*u));
+  for (int i = 0; i < count; i++) {
+    struct usage_entry *e = &u->entry[u->count++];
+    e->report_type     = i < 4 ? HID_REPORT_TYPE_OUTPUT : HID_REPORT_TYPE_INPUT;
+    e->report_id       = 1 + i / 8;
+    e->field_index     = i % 8;
+    e->usage_index     = i;
+    e->usage_code      = (LEDUsagePage << 16) | (0x09 + i);
+    e->logical_minimum = 0;
+    e->logical_maximum = i;
+  }
+}
+
+/* number of entries of dir */
+static int countFiles(const char *dir) {
+  struct dirent *d;
+  DIR *dp;
+  int n = 0;
+
+  if ((dp = opendir(dir)) == NULL) {
+    return -1;
+  }
+  while ((d = readdir(dp)) != NULL) {
+    n += strcmp(d->d_name, ".") != 0 && strcmp(d->d_name, "..") != 0;
+  }
+  closedir(dp);
+  return n;
+}
+
+static void testRoundTrip(const char *dir) {
+  struct capcache cc;
+  struct usage_cache loaded;
+  char sub[300], path[320], planted[340], victim[300];
+  struct stat st;
+  FILE *f;
+
+  snprintf(sub, sizeof(sub), "%s/cache", dir);
+  snprintf(path, sizeof(path), "%s/jabra.caps", sub);
+  snprintf(victim, sizeof(victim), "%s/victim", dir);
+
+  capcacheOpen(&cc, path);
+  CHECK(cc.map == NULL);
+  CHECK(capcacheLoad(&cc, VENDOR, PRODUCT, VERSION, &loaded) < 0);
+  makeLayout(&layout, 12);
+  capcacheStore(&cc, VENDOR, PRODUCT, VERSION, &layout);
+  CHECK_EQ(capcacheSync(&cc), 0);
+  CHECK(stat(path, &st) == 0 && S_ISREG(st.st_mode) && (st.st_mode & 0777) == 0644);
+
+  memset(&loaded, 0xFF, sizeof(loaded));
+  CHECK_EQ(capcacheLoad(&cc, VENDOR, PRODUCT, VERSION, &loaded), 0);
+  CHECK_EQ(loaded.count, layout.count);
+  CHECK_EQ(loaded.skipped, 0);
+  for (int i = 0; i < layout.count && i < loaded.count; i++) {
+    CHECK_EQ(loaded.entry[i].usage_code, layout.entry[i].usage_code);
+    CHECK_EQ(loaded.entry[i].report_type, layout.entry[i].report_type);
+    CHECK_EQ(loaded.entry[i].report_id, layout.entry[i].report_id);
+    CHECK_EQ(loaded.entry[i].field_index, layout.entry[i].field_index);
+    CHECK_EQ(loaded.entry[i].usage_index, layout.entry[i].usage_index);
+    CHECK_EQ(loaded.entry[i].logical_maximum, layout.entry[i].logical_maximum);
+    CHECK_EQ(loaded.entry[i].shadow_valid, 0);
+  }
+  CHECK(capcacheLoad(&cc, VENDOR, PRODUCT + 1, VERSION, &loaded) < 0);
+
+  /* a link where the temporary file used to be written */
+  if ((f = fopen(victim, "we")) != NULL) {
+    fprintf(f, "victim\n");
+    fclose(f);
+  }
+  snprintf(planted, sizeof(planted), "%s.tmp", path);
+  CHECK_EQ(symlink(victim, planted), 0);
+  makeLayout(&layout, 20);
+  capcacheStore(&cc, VENDOR, PRODUCT + 1, VERSION, &layout);
+  CHECK_EQ(capcacheSync(&cc), 0);
+  CHECK(stat(victim, &st) == 0 && st.st_size == 7);
+  CHECK_EQ(capcacheLoad(&cc, VENDOR, PRODUCT + 1, VERSION, &loaded), 0);
+  CHECK_EQ(loaded.count, 20);
+  CHECK_EQ(capcacheLoad(&cc, VENDOR, PRODUCT, VERSION, &loaded), 0);
+  CHECK_EQ(loaded.count, 12);
+  /* the cache file and the planted link, no temporary file left */
+  CHECK_EQ(countFiles(sub), 2);
+
+  /* some fields did not fit the usage cache */
+  makeLayout(&layout, 30);
+  layout.skipped = 300;
+  capcacheStore(&cc, VENDOR, PRODUCT + 2, VERSION, &layout);
+  CHECK_EQ(capcacheSync(&cc), 0);
+  CHECK(capcacheLoad(&cc, VENDOR, PRODUCT + 2, VERSION, &loaded) < 0);
+  capcacheClose(&cc);
+
+  unlink(planted);
+  unlink(path);
+  unlink(victim);
+  rmdir(sub);
+}
+
+static void testDefaultPath(void) {
+  char path[256];
+
+  unsetenv("JABRA_CAPCACHE");
+  unsetenv("XDG_CACHE_HOME");
+  setenv("HOME", "/home/user", 1);
+  CHECK_EQ(capcacheDefaultPath(path, sizeof(path)), 0);
+  CHECK(strcmp(path, "/home/user/.cache/jabra_hiddev_demo.caps") == 0);
+  unsetenv("HOME");
+  CHECK(capcacheDefaultPath(path, sizeof(path)) < 0);
+  CHECK_EQ(path[0], '\0');
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int main(int argc, char **argv) {
+  char dir[256];
+
+  snprintf(dir, sizeof(dir), "%s/jabra_capcache_test.XXXXXX",
+    getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+  if (mkdtemp(dir) == NULL) {
+    perror(dir);
+    return 1;
+  }
+  testRoundTrip(dir);
+  testDefaultPath();
+  if (rmdir(dir) < 0) {
+    perror(dir);
+    test_failures++;
+  }
+  return testResult("jabra_capcache_test");
+}
@@ -0,0 +1,295 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_control.c
+ *
+ * @brief  Local control socket, see jabra_control.h.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "jabra_control.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+
+/* a client as given to the handler: generation above the slot */
+#define CLIENT_SLOT_BITS     8
+#define CLIENT_ID(c, i)      (((c)->generation << CLIENT_SLOT_BITS) | (i))
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+/* make way for binding addr: 0 if nothing is there or a socket nobody
+ * listens on any more was removed */
+static int removeStale(const struct sockaddr_un *addr) {
+  struct stat st;
+  int fd, ret;
+
+  if (lstat(addr->sun_path, &st) < 0) {
+    return errno == ENOENT ? 0 : -1;
+  }
+  if (!S_ISSOCK(st.st_mode)) {
+    fprintf(stderr, "%s: exists and is not a socket\n", addr->sun_path);
+    return -1;
+  }
+  if ((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) < 0) {
+    perror("socket");
+    return -1;
+  }
+  ret = connect(fd, (const struct sockaddr *) addr, sizeof(*addr));
+  close(fd);
+  if (ret == 0) {
+    fprintf(stderr, "%s: in use by another server\n", addr->sun_path);
+    return -1;
+  }
+  if (errno != ECONNREFUSED) {
+    perror(addr->sun_path);
+    return -1;
+  }
+  if (unlink(addr->sun_path) < 0 && errno != ENOENT) {
+    perror(addr->sun_path);
+    return -1;
+  }
+  return 0;
+}
+
+static __u32 eventClass(__u8 type) {
+  switch (type) {
+    case CTL_STATE:
+      return CTL_EV_STATE;
+    case CTL_VOLUME:
+      return CTL_EV_VOLUME;
+    case CTL_ATTACH:
+    case CTL_DETACH:
+      return CTL_EV_DEVICE;
+    default:
+      return 0;
+  }
+}
+
+static void dropClient(struct control_client *c) {
+  struct control *ctl = c->ctl;
+
+  reactorRemove(ctl->reactor, c->fd);
+  (void)pthread_mutex_lock(&ctl->lock);
+  close(c->fd);
+  c->fd = -1;
+  c->mask = 0;
+  (void)pthread_mutex_unlock(&ctl->lock);
+}
+
+/* every request waiting on the socket, each answered at once */
+static void client_event(int fd, __u32 events, void *arg) {
+  struct control_client *c = arg;
+  struct control *ctl = c->ctl;
+  __u32 client = CLIENT_ID(c, c - ctl->client);
+  struct ctl_msg req, reply;
+  ssize_t rd;
+
+  for (;;) {
+    rd = recv(fd, &req, sizeof(req), MSG_DONTWAIT);
+    if (rd < 0 && (errno == EAGAIN || errno == EINTR)) {
+      return;
+    }
+    if (rd <= 0) {
+      dropClient(c);
+      return;
+    }
+    memset(&reply, 0, sizeof(reply));
+    reply.type   = CTL_REPLY;
+    reply.device = req.device;
+    reply.seq    = req.seq;
+    if (rd != sizeof(req)) {
+      reply.value = -EINVAL;
+    } else if (req.type == CTL_SUBSCRIBE) {
+      (void)pthread_mutex_lock(&ctl->lock);
+      c->mask = req.value;
+      (void)pthread_mutex_unlock(&ctl->lock);
+    } else if (ctl->handler(&req, &reply, client, ctl->arg) == CTL_PENDING) {
+      continue;
+    }
+    if (send(fd, &reply, sizeof(reply), MSG_DONTWAIT | MSG_NOSIGNAL) < 0 && errno != EAGAIN) {
+      dropClient(c);
+      return;
+    }
+  }
+}
+
+static void listen_event(int fd, __u32 events, void *arg) {
+  struct control *ctl = arg;
+  struct control_client *c = NULL;
+  int cfd;
+
+  if ((cfd = accept(fd, NULL, NULL)) < 0) {
+    return;
+  }
+  (void)fcntl(cfd, F_SETFD, FD_CLOEXEC);
+  (void)fcntl(cfd, F_SETFL, O_NONBLOCK);
+  (void)pthread_mutex_lock(&ctl->lock);
+  for (int i = 0; i < MAX_CONTROL_CLIENTS && c == NULL; i++) {
+    if (ctl->client[i].fd < 0) {
+      c = &ctl->client[i];
+      c->fd = cfd;
+      c->generation = ++ctl->generation;
+      c->mask = 0;
+      c->missed = 0;
+    }
+  }
+  (void)pthread_mutex_unlock(&ctl->lock);
+
+  if (c == NULL) {
+    fprintf(stderr, "%s: too many clients\n", ctl->path);
+    close(cfd);
+  } else if (reactorAdd(ctl->reactor, cfd, client_event, c) < 0) {
+    (void)pthread_mutex_lock(&ctl->lock);
+    c->fd = -1;
+    (void)pthread_mutex_unlock(&ctl->lock);
+    close(cfd);
+  }
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int controlOpen(struct control *ctl, const char *path, struct reactor *r,
+                control_handler handler, void *arg) {
+  struct sockaddr_un addr;
+
+  ctl->reactor = r;
+  ctl->handler = handler;
+  ctl->arg = arg;
+  ctl->notified = 0;
+  ctl->missed = 0;
+  ctl->generation = 0;
+  pthread_mutex_init(&ctl->lock, NULL);
+  for (int i = 0; i < MAX_CONTROL_CLIENTS; i++) {
+    ctl->client[i].fd = -1;
+    ctl->client[i].ctl = ctl;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "%s: socket path too long\n", path);
+    ctl->fd = -1;
+    return -1;
+  }
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+  snprintf(ctl->path, sizeof(ctl->path), "%s", path);
+
+  if ((ctl->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) < 0) {
+    perror("socket");
+    return -1;
+  }
+  if (removeStale(&addr) < 0) {
+    close(ctl->fd);
+    ctl->fd = -1;
+    return -1;
+  }
+  if (bind(ctl->fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+      listen(ctl->fd, 16) < 0) {
+    perror(path);
+    close(ctl->fd);
+    ctl->fd = -1;
+    return -1;
+  }
+  if (reactorAdd(r, ctl->fd, listen_event, ctl) < 0) {
+    close(ctl->fd);
+    ctl->fd = -1;
+    (void)unlink(path);
+    return -1;
+  }
+  return 0;
+}
+
+void controlClose(struct control *ctl) {
+  if (ctl->fd < 0) {
+    return;
+  }
+  for (int i = 0; i < MAX_CONTROL_CLIENTS; i++) {
+    if (ctl->client[i].fd >= 0) {
+      dropClient(&ctl->client[i]);
+    }
+  }
+  reactorRemove(ctl->reactor, ctl->fd);
+  close(ctl->fd);
+  ctl->fd = -1;
+  (void)unlink(ctl->path);
+  pthread_mutex_destroy(&ctl->lock);
+}
+
+void controlNotify(struct control *ctl, const struct ctl_msg *msg) {
+  __u32 class = eventClass(msg->type);
+
+  if (ctl->fd < 0) {
+    return;
+  }
+  (void)pthread_mutex_lock(&ctl->lock);
+  for (int i = 0; i < MAX_CONTROL_CLIENTS; i++) {
+    struct control_client *c = &ctl->client[i];
+
+    if (c->fd < 0 || (c->mask & class) == 0) {
+      continue;
+    }
+    /* a lost notification is only counted, the reactor notices a
+     * client that went away */
+    if (send(c->fd, msg, sizeof(*msg), MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+      c->missed++;
+      ctl->missed++;
+    } else {
+      ctl->notified++;
+    }
+  }
+  (void)pthread_mutex_unlock(&ctl->lock);
+}
+
+void controlReply(struct control *ctl, __u32 client, const struct ctl_msg *reply) {
+  unsigned slot = client & ((1u << CLIENT_SLOT_BITS) - 1);
+  struct control_client *c;
+
+  if (ctl->fd < 0 || slot >= MAX_CONTROL_CLIENTS) {
+    return;
+  }
+  c = &ctl->client[slot];
+  (void)pthread_mutex_lock(&ctl->lock);
+  if (c->fd >= 0 && CLIENT_ID(c, slot) == client &&
+      send(c->fd, reply, sizeof(*reply), MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+    c->missed++;
+    ctl->missed++;
+  }
+  (void)pthread_mutex_unlock(&ctl->lock);
+}
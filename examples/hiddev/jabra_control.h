@@ -0,0 +1,142 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_control.h
+ *
+ * @brief  Local control socket, so that several processes (soft-phone,
+ *         presence agent, recorder) can drive and observe the same
+ *         headsets. A SOCK_SEQPACKET Unix socket carries fixed 8 byte
+ *         messages, one per packet, in both directions.
+ *
+ *         Requests are answered with CTL_REPLY, or CTL_STATE for
+ *         CTL_GET_STATE, carrying the seq of the request. Notifications
+ *         are sent to every client subscribed to their class, with seq 0.
+ *         Clients are served from the reactor thread. A request that
+ *         needs the device is handed on and answered with controlReply()
+ *         once done, so the reactor never waits for a device; its reply
+ *         may follow the notifications it caused. Replies and
+ *         notifications may be sent from any thread and are never waited
+ *         for: a client whose socket buffer is full misses them, and can
+ *         catch up with CTL_GET_STATE.
+ */
+
+#ifndef JABRA_CONTROL_H
+#define JABRA_CONTROL_H
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+#include <pthread.h>
+
+#include "jabra_reactor.h"
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+
+/* Requests, value is 0 or 1 for the hook, mute and ringer */
+#define CTL_HOOK             0x01
+#define CTL_MUTE             0x02
+#define CTL_RING             0x03
+#define CTL_GET_STATE        0x04
+#define CTL_SUBSCRIBE        0x05  /* value is a mask of CTL_EV_* */
+
+/* Replies and notifications */
+#define CTL_REPLY            0x80  /* value 0, or a negative errno */
+#define CTL_STATE            0x81  /* value holds CALL_HOOK, CALL_MUTE, CALL_RING */
+#define CTL_VOLUME           0x82  /* value +1 or -1 per button press */
+#define CTL_ATTACH           0x83
+#define CTL_DETACH           0x84
+
+/* Notification classes */
+#define CTL_EV_STATE         0x01  /* CTL_STATE */
+#define CTL_EV_VOLUME        0x02  /* CTL_VOLUME */
+#define CTL_EV_DEVICE        0x04  /* CTL_ATTACH and CTL_DETACH */
+
+/* device of a request, the one selected in the program. Never a registry
+ * index, see MAX_DEVICES */
+#define CTL_DEVICE_SELECTED  0xFF
+
+struct ctl_msg {
+  __u8  type;
+  __u8  device;          /* registry index */
+  __u16 seq;             /* echoed in the reply */
+  __s32 value;
+};
+
+/* Maximum number of clients connected at the same time */
+#define MAX_CONTROL_CLIENTS  64
+
+/* control_handler result: the reply is sent later with controlReply() */
+#define CTL_PENDING          1
+
+struct control;
+
+/* fill reply for a request other than CTL_SUBSCRIBE and return 0, or
+ * return CTL_PENDING and pass client to controlReply(). Reactor thread */
+typedef int (*control_handler)(const struct ctl_msg *req, struct ctl_msg *reply,
+                               __u32 client, void *arg);
+
+struct control_client {
+  int fd;                /* -1 for a free slot */
+  __u32 generation;      /* tells a later client of the slot apart */
+  __u32 mask;            /* CTL_EV_* subscribed to */
+  unsigned long missed;  /* notifications lost to a full socket */
+  struct control *ctl;
+};
+
+struct control {
+  int fd;                /* listening socket */
+  char path[108];
+  struct reactor *reactor;
+  control_handler handler;
+  void *arg;
+  pthread_mutex_t lock;  /* protects the client table */
+  __u32 generation;      /* clients accepted */
+  struct control_client client[MAX_CONTROL_CLIENTS];
+  unsigned long notified;
+  unsigned long missed;
+};
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+
+/* listen on path and serve the clients from r. A socket left at path by
+ * a server that is gone is replaced, -1 if a server still answers there
+ * or path is something else than a socket */
+int controlOpen(struct control *ctl, const char *path, struct reactor *r,
+                control_handler handler, void *arg);
+void controlClose(struct control *ctl);
+
+/* send msg to every client subscribed to its class, any thread */
+void controlNotify(struct control *ctl, const struct ctl_msg *msg);
+
+/* answer a request the handler left CTL_PENDING, any thread. Dropped if
+ * the client has gone meanwhile */
+void controlReply(struct control *ctl, __u32 client, const struct ctl_msg *reply);
+
+#endif /* JABRA_CONTROL_H */
@@ -0,0 +1,429 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_control_test.c
+ *
+ * @brief  Test of the control socket protocol of jabra_control.h, with
+ *         the server in this process and its clients on real sockets.
+ *
+ *         The server side is set up like the demo's: the reactor thread
+ *         serves the clients, and CTL_HOOK is left CTL_PENDING for a
+ *         worker thread. The worker changes the state, notifies the
+ *         subscribers and then replies with controlReply(). CTL_GET_STATE
+ *         is answered at once. The test checks:
+ *           - CTL_SUBSCRIBE and the replies echoing the seq of requests;
+ *           - every CTL_HOOK round trip, and the CTL_STATE notification
+ *             each subscriber gets for it, with the new value;
+ *           - that a client not subscribed gets no notification;
+ *           - CTL_GET_STATE, and -EINVAL for a short message;
+ *           - that a reply for a client that has gone is not delivered
+ *             to the next client in its slot;
+ *           - that controlOpen() replaces the socket of a server that is
+ *             gone, but neither a live one nor another kind of file.
+ *         The round trip time of CTL_HOOK is printed as a histogram.
+ *
+ *         Usage: jabra_control_test [-c clients] [-r rounds], run by
+ *         make check.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "jabra_control.h"
+#include "jabra_latency.h"
+#include "jabra_reactor.h"
+#include "jabra_test.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+#define TEST_TIMEOUT_MS      2000
+#define MAX_PENDING          64
+
+/* a CTL_HOOK waiting for the worker */
+struct pending {
+  __u32 client;
+  __u16 seq;
+  __s32 value;
+};
+
+/****************************************************************************/
+/*                              PRIVATE DATA                                */
+/****************************************************************************/
+static struct reactor reactor;
+static struct control control = { -1 };
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static struct pending queue[MAX_PENDING];
+static int n_queued = 0;
+static int stopping = 0;
+static __s32 state = 0;          /* the "device" */
+static __u32 held_client = 0;    /* client of the CTL_RING left unanswered */
+static int n_clients = 40;
+static int rounds = 200;
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+
+/* reactor thread */
+static int control_request(const struct ctl_msg *req, struct ctl_msg *reply,
+                           __u32 client, void *arg) {
+  switch (req->type) {
+    case CTL_HOOK:
+      (void)pthread_mutex_lock(&lock);
+      if (n_queued == MAX_PENDING) {
+        (void)pthread_mutex_unlock(&lock);
+        reply->value = -EBUSY;
+        return 0;
+      }
+      queue[n_queued].client = client;
+      queue[n_queued].seq = req->seq;
+      queue[n_queued].value = req->value;
+      n_queued++;
+      (void)pthread_cond_signal(&cond);
+      (void)pthread_mutex_unlock(&lock);
+      return CTL_PENDING;
+    case CTL_RING:
+      /* answered by the test itself, after the client is gone */
+      __atomic_store_n(&held_client, client, __ATOMIC_RELEASE);
+      return CTL_PENDING;
+    case CTL_GET_STATE:
+      reply->type = CTL_STATE;
+      reply->value = __atomic_load_n(&state, __ATOMIC_ACQUIRE);
+      return 0;
+    default:
+      reply->value = -EINVAL;
+      return 0;
+  }
+}
+
+/* like the demo's handler thread: change, notify, then reply */
+static void *worker(void *arg) {
+  struct pending p;
+  struct ctl_msg msg;
+
+  for (;;) {
+    (void)pthread_mutex_lock(&lock);
+    while (n_queued == 0 && !stopping) {
+      (void)pthread_cond_wait(&cond, &lock);
+    }
+    if (n_queued == 0) {
+      (void)pthread_mutex_unlock(&lock);
+      return NULL;
+    }
+    p = queue[0];
+    memmove(&queue[0], &queue[1], --n_queued * sizeof(queue[0]));
+    (void)pthread_mutex_unlock(&lock);
+
+    __atomic_store_n(&state, p.value, __ATOMIC_RELEASE);
+    memset(&msg, 0, sizeof(msg));
+    msg.type  = CTL_STATE;
+    msg.value = p.value;
+    controlNotify(&control, &msg);
+
+    msg.type  = CTL_REPLY;
+    msg.seq   = p.seq;
+    msg.value = 0;
+    controlReply(&control, p.client, &msg);
+  }
+}
+
+static void *event_loop(void *arg) {
+  reactorRun(&reactor);
+  return NULL;
+}
+
+static int connectClient(const char *path) {
+  struct sockaddr_un addr;
+  int fd;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+  if ((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) < 0 ||
+      connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    perror(path);
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void sendMsg(int fd, __u8 type, __u8 device, __u16 seq, __s32 value) {
+  struct ctl_msg msg;
+
+  msg.type   = type;
+  msg.device = device;
+  msg.seq    = seq;
+  msg.value  = value;
+  if (send(fd, &msg, sizeof(msg), MSG_NOSIGNAL) != sizeof(msg)) {
+    perror("send");
+  }
+}
+
+/* 1 with msg filled, 0 if nothing came within timeout_ms */
+static int recvMsg(int fd, struct ctl_msg *msg, int timeout_ms) {
+  struct pollfd pfd = { fd, POLLIN, 0 };
+
+  if (poll(&pfd, 1, timeout_ms) <= 0) {
+    return 0;
+  }
+  return recv(fd, msg, sizeof(*msg), 0) == sizeof(*msg);
+}
+
+/* the reply to seq, counting the notifications that came before it */
+static int awaitReply(int fd, __u16 seq, struct ctl_msg *reply, int *notified) {
+  while (recvMsg(fd, reply, TEST_TIMEOUT_MS)) {
+    if (reply->seq == seq && (reply->type == CTL_REPLY || reply->type == CTL_STATE)) {
+      return 1;
+    }
+    if (reply->seq == 0 && reply->type == CTL_STATE && notified != NULL) {
+      (*notified)++;
+    }
+  }
+  return 0;
+}
+
+static void testRoundTrips(int *fd) {
+  struct histogram rtt;
+  struct ctl_msg msg;
+  int got = 0;
+
+  histReset(&rtt);
+  for (int r = 0; r < rounds; r++) {
+    int requester = 1 + r % (n_clients - 1);
+    __u16 seq = 1000 + r;
+    __s32 value = (r & 1) == 0;
+    int notified = 0;
+    __u64 t0 = latencyNow();
+
+    sendMsg(fd[requester], CTL_HOOK, 0, seq, value);
+    got = awaitReply(fd[requester], seq, &msg, &notified);
+    histRecord(&rtt, latencyNow() - t0);
+    CHECK(got);
+    CHECK_EQ(msg.type, CTL_REPLY);
+    CHECK_EQ(msg.value, 0);
+    /* the notification is sent before the reply */
+    CHECK_EQ(notified, 1);
+
+    /* every other subscriber sees the new state once */
+    for (int c = 1; c < n_clients; c++) {
+      if (c == requester) {
+        continue;
+      }
+      got = recvMsg(fd[c], &msg, TEST_TIMEOUT_MS);
+      CHECK(got);
+      CHECK_EQ(msg.type, CTL_STATE);
+      CHECK_EQ(msg.seq, 0);
+      CHECK_EQ(msg.value, value);
+    }
+  }
+  histPrint("jabra_control_test: ", "CTL_HOOK rtt", &rtt);
+
+  /* client 0 did not subscribe */
+  CHECK(!recvMsg(fd[0], &msg, 0));
+}
+
+static void testRequests(int fd) {
+  struct ctl_msg msg;
+  __s32 expect = __atomic_load_n(&state, __ATOMIC_ACQUIRE);
+
+  sendMsg(fd, CTL_GET_STATE, CTL_DEVICE_SELECTED, 77, 0);
+  CHECK(awaitReply(fd, 77, &msg, NULL));
+  CHECK_EQ(msg.type, CTL_STATE);
+  CHECK_EQ(msg.value, expect);
+
+  /* a message shorter than struct ctl_msg */
+  CHECK_EQ(send(fd, "\x01\x00\x4E\x00", 4, MSG_NOSIGNAL), 4);
+  CHECK(recvMsg(fd, &msg, TEST_TIMEOUT_MS));
+  CHECK_EQ(msg.type, CTL_REPLY);
+  CHECK_EQ(msg.value, -EINVAL);
+}
+
+/* a pending reply must not reach whoever took the slot of its client */
+static void testStaleReply(const char *path) {
+  struct ctl_msg msg;
+  __u32 client;
+  int fd, next;
+
+  if ((fd = connectClient(path)) < 0) {
+    test_failures++;
+    return;
+  }
+  sendMsg(fd, CTL_SUBSCRIBE, 0, 5, 0);
+  CHECK(awaitReply(fd, 5, &msg, NULL));
+  sendMsg(fd, CTL_RING, 0, 6, 1);
+  for (int i = 0; i < 200 && __atomic_load_n(&held_client, __ATOMIC_ACQUIRE) == 0; i++) {
+    usleep(10000);
+  }
+  client = __atomic_load_n(&held_client, __ATOMIC_ACQUIRE);
+  CHECK(client != 0);
+  close(fd);
+
+  /* once the server has dropped the old client */
+  usleep(50000);
+  if ((next = connectClient(path)) < 0) {
+    test_failures++;
+    return;
+  }
+  sendMsg(next, CTL_SUBSCRIBE, 0, 7, 0);
+  CHECK(awaitReply(next, 7, &msg, NULL));
+
+  memset(&msg, 0, sizeof(msg));
+  msg.type = CTL_REPLY;
+  msg.seq  = 6;
+  controlReply(&control, client, &msg);
+  CHECK(!recvMsg(next, &msg, 100));
+  close(next);
+}
+
+/* what controlOpen() may take over, with the server at path running */
+static void testOpen(const char *path) {
+  struct sockaddr_un addr;
+  struct control other = { -1 };
+  char stale[128], file[128];
+  struct stat st;
+  int fd;
+
+  CHECK(controlOpen(&other, path, &reactor, control_request, NULL) < 0);
+  CHECK(stat(path, &st) == 0 && S_ISSOCK(st.st_mode));
+
+  snprintf(file, sizeof(file), "%s.file", path);
+  if ((fd = open(file, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600)) >= 0) {
+    close(fd);
+  }
+  CHECK(controlOpen(&other, file, &reactor, control_request, NULL) < 0);
+  CHECK(stat(file, &st) == 0 && S_ISREG(st.st_mode));
+  unlink(file);
+
+  /* a socket whose server exited without removing it */
+  snprintf(stale, sizeof(stale), "%s.stale", path);
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%.*s", (int) sizeof(addr.sun_path) - 1, stale);
+  if ((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) >= 0) {
+    CHECK_EQ(bind(fd, (struct sockaddr *) &addr, sizeof(addr)), 0);
+    close(fd);
+  }
+  CHECK_EQ(controlOpen(&other, stale, &reactor, control_request, NULL), 0);
+  controlClose(&other);
+  CHECK(stat(stale, &st) < 0);
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int main(int argc, char **argv) {
+  pthread_t event_thread, worker_thread;
+  int fd[MAX_CONTROL_CLIENTS];
+  char path[108];
+  struct ctl_msg msg;
+  sigset_t mask;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "c:r:")) != -1) {
+    switch (opt) {
+      case 'c':
+        n_clients = atoi(optarg);
+        break;
+      case 'r':
+        rounds = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-c clients] [-r rounds]\n", argv[0]);
+        return 2;
+    }
+  }
+  /* one more client connects in testStaleReply() */
+  if (n_clients < 2 || n_clients > MAX_CONTROL_CLIENTS - 1) {
+    fprintf(stderr, "clients must be 2 to %d\n", MAX_CONTROL_CLIENTS - 1);
+    return 2;
+  }
+
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+  snprintf(path, sizeof(path), "%s/jabra_control_test.%d",
+    getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp", (int) getpid());
+  if (reactorInit(&reactor) < 0 ||
+      controlOpen(&control, path, &reactor, control_request, NULL) < 0) {
+    reactorClose(&reactor);
+    return 1;
+  }
+  testOpen(path);
+  if (pthread_create(&worker_thread, NULL, worker, NULL) ||
+      pthread_create(&event_thread, NULL, event_loop, NULL)) {
+    fprintf(stderr, "Error creating thread\n");
+    return 1;
+  }
+
+  /* client 0 stays unsubscribed, the others want CTL_EV_STATE */
+  for (int c = 0; c < n_clients; c++) {
+    if ((fd[c] = connectClient(path)) < 0) {
+      return 1;
+    }
+    sendMsg(fd[c], CTL_SUBSCRIBE, 0, 1 + c, c == 0 ? 0 : CTL_EV_STATE);
+    CHECK(awaitReply(fd[c], 1 + c, &msg, NULL));
+    CHECK_EQ(msg.value, 0);
+  }
+
+  testRoundTrips(fd);
+  testRequests(fd[1]);
+  testStaleReply(path);
+
+  for (int c = 0; c < n_clients; c++) {
+    close(fd[c]);
+  }
+  reactorStop(&reactor);
+  pthread_join(event_thread, NULL);
+  (void)pthread_mutex_lock(&lock);
+  stopping = 1;
+  (void)pthread_cond_signal(&cond);
+  (void)pthread_mutex_unlock(&lock);
+  pthread_join(worker_thread, NULL);
+  fprintf(stdout, "jabra_control_test: notifications sent=%lu missed=%lu\n",
+    control.notified, control.missed);
+  CHECK_EQ(control.missed, 0);
+  controlClose(&control);
+  reactorClose(&reactor);
+  return testResult("jabra_control_test");
+}
@@ -0,0 +1,544 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_device.c
+ *
+ * @brief  Per-device context for the Jabra hiddev demo, see jabra_device.h.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+#include "jabra_capcache.h"
+#include "jabra_device.h"
+#include "jabra_log.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+
+/* Paths shared by the deviceOpenAll() workers */
+struct probe_job {
+  const struct transport_ops *ops;
+  const char *const *paths;
+  int n;
+  __u16 vendor;
+  struct jabra_device **dev;
+  int next;              /* next path to open, taken atomically */
+};
+
+/****************************************************************************/
+/*                              PRIVATE DATA                                */
+/****************************************************************************/
+static struct capcache *capabilities = NULL;
+
+static const char *const call_names[DEVCALLS] = {
+  [DEVCALL_GDEVINFO]    = "HIDIOCGDEVINFO",
+  [DEVCALL_INITREPORT]  = "HIDIOCINITREPORT",
+  [DEVCALL_GNAME]       = "HIDIOCGNAME",
+  [DEVCALL_GREPORTINFO] = "HIDIOCGREPORTINFO",
+  [DEVCALL_GFIELDINFO]  = "HIDIOCGFIELDINFO",
+  [DEVCALL_GUCODE]      = "HIDIOCGUCODE",
+  [DEVCALL_GUSAGE]      = "HIDIOCGUSAGE",
+  [DEVCALL_SUSAGE]      = "HIDIOCSUSAGE",
+  [DEVCALL_SUSAGES]     = "HIDIOCSUSAGES",
+  [DEVCALL_SREPORT]     = "HIDIOCSREPORT",
+  [DEVCALL_GRAWINFO]    = "HIDIOCGRAWINFO",
+  [DEVCALL_GRAWNAME]    = "HIDIOCGRAWNAME",
+  [DEVCALL_GRDESC]      = "HIDIOCGRDESC",
+  [DEVCALL_GFEATURE]    = "HIDIOCGFEATURE",
+  [DEVCALL_SFEATURE]    = "HIDIOCSFEATURE",
+  [DEVCALL_GOUTPUT]     = "HIDIOCGOUTPUT",
+  [DEVCALL_READ]        = "read",
+  [DEVCALL_WRITE]       = "write",
+};
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static struct usage_entry *lookupUsage(struct jabra_device *dev,
+                                       unsigned report_type, unsigned page, unsigned code) {
+  struct usage_cache *cache = &dev->usages;
+  struct usage_entry *u;
+  struct usage_entry found;
+  __u32 usage_code = (page << 16) | code;
+
+  u = findUsage(cache, report_type, usage_code);
+  if (u != NULL) {
+    return u;
+  }
+
+  /* not cached, resolve it the slow way and remember the result */
+  if (dev->ops->resolve_usage == NULL ||
+      dev->ops->resolve_usage(dev, report_type, usage_code, &found) < 0) {
+    fprintf(stderr, "%s: usage 0x%X not found\n", dev->path, usage_code);
+    return NULL;
+  }
+  if (cache->count >= MAX_CACHED_USAGES) {
+    /* cache is full: nothing cached is evicted, this usage is resolved
+     * again next time and its writes are never elided */
+    u = &cache->uncached;
+  } else {
+    u = &cache->entry[cache->count++];
+  }
+  *u = found;
+  u->shadow_valid = 0;
+  return u;
+}
+
+static void *probeWorker(void *arg) {
+  struct probe_job *job = arg;
+  int i;
+
+  while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->n) {
+    job->dev[i] = deviceOpen(job->ops, job->paths[i], job->vendor);
+  }
+  return NULL;
+}
+
+static int stagedBefore(const struct staged_usage *a, const struct staged_usage *b) {
+  if (a->usage.report_type != b->usage.report_type)
+    return a->usage.report_type < b->usage.report_type;
+  if (a->usage.report_id != b->usage.report_id)
+    return a->usage.report_id < b->usage.report_id;
+  if (a->usage.field_index != b->usage.field_index)
+    return a->usage.field_index < b->usage.field_index;
+  return a->usage.usage_index < b->usage.usage_index;
+}
+
+static void updateShadow(struct jabra_device *dev, const struct staged_usage *st, int n, int ok) {
+  for (int i = 0; i < n; i++) {
+    struct usage_entry *u = findUsage(&dev->usages, st[i].usage.report_type, st[i].usage.usage_code);
+    if (u != NULL) {
+      u->shadow_valid = ok;
+      u->shadow = st[i].value;
+    }
+  }
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+const char *usagePageName(__u32 usage_code) {
+  __u16 hi = (usage_code >> 16) & 0xFFFF;
+
+  switch (hi) {
+    case TelephonyUsagePage:   return "TelephonyUsagePage";
+    case ConsumerUsagePage:    return "ConsumerUsagePage";
+    case LEDUsagePage:         return "LEDUsagePage";
+    case ButtonUsagePage:      return "ButtonUsagePage";
+    default:                   return "not translated";
+  }
+}
+
+int usagesFit(struct usage_cache *cache, int n) {
+  if (cache->count + n > MAX_CACHED_USAGES) {
+    cache->skipped += n;
+    return 0;
+  }
+  return 1;
+}
+
+struct usage_entry *addUsage(struct usage_cache *cache,
+                             const struct hiddev_field_info *finfo,
+                             __u32 usage_index, __u32 usage_code) {
+  struct usage_entry *u;
+
+  if (cache->count >= MAX_CACHED_USAGES) {
+    return NULL;
+  }
+  u = &cache->entry[cache->count++];
+  u->report_type     = finfo->report_type;
+  u->report_id       = finfo->report_id;
+  u->field_index     = finfo->field_index;
+  u->usage_index     = usage_index;
+  u->usage_code      = usage_code;
+  u->logical_minimum = finfo->logical_minimum;
+  u->logical_maximum = finfo->logical_maximum;
+  u->shadow_valid    = 0;
+  u->shadow          = 0;
+  return u;
+}
+
+struct usage_entry *findUsage(struct usage_cache *cache, __u32 report_type, __u32 usage_code) {
+  for (int i = 0; i < cache->count; i++) {
+    struct usage_entry *u = &cache->entry[i];
+    if (u->usage_code == usage_code && u->report_type == report_type) {
+      return u;
+    }
+  }
+  return NULL;
+}
+
+void deviceUseCapCache(struct capcache *cc) {
+  capabilities = cc;
+}
+
+struct jabra_device *deviceOpen(const struct transport_ops *ops, const char *path, __u16 vendor) {
+  struct jabra_device *dev;
+  __s32 mute = 0, hook = 0, ring = 0;
+
+  dev = calloc(1, sizeof(*dev));
+  if (dev == NULL) {
+    perror("calloc");
+    return NULL;
+  }
+  dev->index = -1;
+  dev->ops = ops;
+  snprintf(dev->path, sizeof(dev->path), "%s", path);
+
+  if (ops->open(dev) < 0) {
+    free(dev);
+    return NULL;
+  }
+  if (vendor != 0 && dev->devinfo.vendor != vendor) {
+    ops->close(dev);
+    free(dev);
+    return NULL;
+  }
+
+  if (capabilities == NULL || ops->check_usages == NULL ||
+      capcacheLoad(capabilities, dev->devinfo.vendor, dev->devinfo.product,
+                   dev->devinfo.version, &dev->usages) < 0 ||
+      ops->check_usages(dev) < 0) {
+    ops->build_usages(dev);
+    if (capabilities != NULL && ops->check_usages != NULL) {
+      capcacheStore(capabilities, dev->devinfo.vendor, dev->devinfo.product,
+                    dev->devinfo.version, &dev->usages);
+    }
+  }
+  pthread_mutex_init(&dev->lock, NULL);
+
+  /* set initial values */
+  readUsage(dev, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Mute, &mute);
+  readUsage(dev, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Off_Hook, &hook);
+  readUsage(dev, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Ring, &ring);
+  (void)pthread_mutex_lock(&dev->lock);
+  callStateUpdate(dev, (mute ? CALL_MUTE : 0) | (hook ? CALL_HOOK : 0) | (ring ? CALL_RING : 0));
+  (void)pthread_mutex_unlock(&dev->lock);
+  return dev;
+}
+
+void deviceOpenAll(const struct transport_ops *ops, const char *const paths[], int n,
+                   __u16 vendor, struct jabra_device *dev[]) {
+  pthread_t worker[MAX_PROBE_WORKERS];
+  struct probe_job job;
+  int workers = n < MAX_PROBE_WORKERS ? n : MAX_PROBE_WORKERS;
+  int started = 0;
+
+  job.ops    = ops;
+  job.paths  = paths;
+  job.n      = n;
+  job.vendor = vendor;
+  job.dev    = dev;
+  job.next   = 0;
+
+  for (int i = 0; i < workers; i++) {
+    if (pthread_create(&worker[started], NULL, probeWorker, &job) == 0) {
+      started++;
+    }
+  }
+  if (started == 0) {
+    /* no threads available, open them one by one */
+    probeWorker(&job);
+  }
+  for (int i = 0; i < started; i++) {
+    pthread_join(worker[i], NULL);
+  }
+}
+
+void deviceClose(struct jabra_device *dev) {
+  dev->ops->close(dev);
+  pthread_mutex_destroy(&dev->lock);
+  free(dev);
+}
+
+int deviceIoctl(struct jabra_device *dev, int call, unsigned long request, void *arg) {
+  __u64 start = latencyNow();
+  int ret = ioctl(dev->fd, request, arg);
+
+  deviceAccount(dev, call, start, ret < 0);
+  return ret;
+}
+
+void deviceAccount(struct jabra_device *dev, int call, __u64 start_ns, int failed) {
+  struct call_stats *cs = &dev->calls;
+
+  __atomic_fetch_add(&cs->count[call], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&cs->ns[call], latencyNow() - start_ns, __ATOMIC_RELAXED);
+  if (failed)
+    __atomic_fetch_add(&cs->errors[call], 1, __ATOMIC_RELAXED);
+}
+
+const char *deviceCallName(int call) {
+  return call_names[call];
+}
+
+int deviceReadEvents(struct jabra_device *dev, struct hiddev_event *ev, int max) {
+  return dev->ops->read_events(dev, ev, max);
+}
+
+void txnBegin(struct output_txn *txn, struct jabra_device *dev) {
+  txn->dev = dev;
+  txn->count = 0;
+  txn->elided_count = 0;
+}
+
+void txnStage(struct output_txn *txn, unsigned report_type, unsigned page, unsigned code, __s32 value) {
+  struct usage_entry *u;
+  struct staged_usage *st;
+
+  /* find the requested usage code */
+  u = lookupUsage(txn->dev, report_type, page, code);
+  if (u == NULL) {
+    return;
+  }
+#if (HIDDEBUG == 1)
+  fprintf(stdout, " >> report_id=0x%X field_index=%u usage_index=%u usage_code=0x%X (%s)"
+    " logical_minimum=%d,maximum=%d\n",
+    u->report_id,
+    u->field_index,
+    u->usage_index,
+    u->usage_code,
+    usagePageName(u->usage_code),
+    u->logical_minimum,
+    u->logical_maximum);
+#endif
+  if ((value < u->logical_minimum) || (value > u->logical_maximum)) {
+    LOG(LOG_WARN, "%s: value %d outside of allowed range (%d-%d)\n",
+      usagePageName(u->usage_code),
+      value,
+      u->logical_minimum,
+      u->logical_maximum);
+    return;
+  }
+
+  /* a usage staged twice keeps the last value */
+  for (int i = 0; i < txn->count; i++) {
+    st = &txn->staged[i];
+    if (st->usage.usage_code == u->usage_code && st->usage.report_type == u->report_type) {
+      st->value = value;
+      return;
+    }
+  }
+
+  /* drop writes that would not change what the device already holds */
+  if (u->shadow_valid && u->shadow == value) {
+    txn->dev->ostats.usages_elided++;
+    if (txn->elided_count < MAX_STAGED_USAGES) {
+      txn->elided[txn->elided_count].report_type = u->report_type;
+      txn->elided[txn->elided_count].report_id   = u->report_id;
+      txn->elided_count++;
+    }
+    return;
+  }
+
+  if (txn->count >= MAX_STAGED_USAGES) {
+    LOG(LOG_WARN, "%s: too many usages in transaction\n", usagePageName(u->usage_code));
+    return;
+  }
+  st = &txn->staged[txn->count++];
+  st->usage = *u;
+  st->value = value;
+}
+
+void txnCommit(struct output_txn *txn) {
+  const struct transport_ops *ops = txn->dev->ops;
+  __s32 values[MAX_STAGED_USAGES];
+  struct staged_usage *st = txn->staged;
+  int n = txn->count;
+  int report_start = 0;
+  int ok = 1;
+  __u64 t0;
+  int i, j;
+
+  /* order by report, field and usage index so that runs can be merged */
+  for (i = 1; i < n; i++) {
+    struct staged_usage tmp = st[i];
+    for (j = i; j > 0 && stagedBefore(&tmp, &st[j - 1]); j--) {
+      st[j] = st[j - 1];
+    }
+    st[j] = tmp;
+  }
+
+  for (i = 0; i < n; i = j) {
+    /* consecutive usages of one field are set in one go */
+    for (j = i + 1; j < n; j++) {
+      if (st[j].usage.report_type != st[i].usage.report_type ||
+          st[j].usage.report_id   != st[i].usage.report_id ||
+          st[j].usage.field_index != st[i].usage.field_index ||
+          st[j].usage.usage_index != st[i].usage.usage_index + (j - i)) {
+        break;
+      }
+    }
+
+    for (int k = i; k < j; k++) {
+      values[k - i] = st[k].value;
+    }
+    t0 = latencyNow();
+    if (ops->set_usages(txn->dev, &st[i].usage, values, j - i) < 0) {
+      ok = 0;
+    }
+    histRecord(&txn->dev->latency.stage[LAT_OUTPUT_CALL], latencyNow() - t0);
+    txn->dev->ostats.usages_written += j - i;
+
+    /* send the report once all of its usages have been set */
+    if (j == n ||
+        st[j].usage.report_type != st[i].usage.report_type ||
+        st[j].usage.report_id   != st[i].usage.report_id) {
+      t0 = latencyNow();
+      if (ops->send_report(txn->dev, st[i].usage.report_type, st[i].usage.report_id) < 0) {
+        ok = 0;
+      }
+      histRecord(&txn->dev->latency.stage[LAT_OUTPUT_CALL], latencyNow() - t0);
+      txn->dev->ostats.reports_sent++;
+      updateShadow(txn->dev, &st[report_start], j - report_start, ok);
+      report_start = j;
+      ok = 1;
+    }
+  }
+
+  /* reports that had nothing left to send after elision */
+  for (i = 0; i < txn->elided_count; i++) {
+    int sent = 0;
+    for (j = 0; j < n && !sent; j++) {
+      sent = (st[j].usage.report_type == txn->elided[i].report_type &&
+              st[j].usage.report_id   == txn->elided[i].report_id);
+    }
+    for (j = 0; j < i && !sent; j++) {
+      sent = (txn->elided[j].report_type == txn->elided[i].report_type &&
+              txn->elided[j].report_id   == txn->elided[i].report_id);
+    }
+    if (!sent) {
+      txn->dev->ostats.reports_elided++;
+    }
+  }
+  txn->count = 0;
+  txn->elided_count = 0;
+}
+
+void writeUsage(struct jabra_device *dev, unsigned report_type, unsigned page, unsigned code, __s32 value) {
+  struct output_txn txn;
+
+  txnBegin(&txn, dev);
+  txnStage(&txn, report_type, page, code, value);
+  txnCommit(&txn);
+}
+
+void readUsage(struct jabra_device *dev, unsigned report_type, unsigned page, unsigned code, __s32* value) {
+  struct usage_entry *u;
+  __s32 v;
+
+  /* find the requested usage code */
+  u = lookupUsage(dev, report_type, page, code);
+  if (u == NULL) {
+    return;
+  }
+
+  /* get value */
+  if (dev->ops->get_usage(dev, u, &v) < 0) {
+    return;
+  }
+#if (HIDDEBUG == 1)
+  fprintf(stdout, " >> usage_index=%u usage_code=0x%X (%s) value=%d\n",
+    u->usage_index,
+    u->usage_code,
+    usagePageName(u->usage_code),
+    v);
+#endif
+
+  /* only read: the value may never have reached the device, e.g. from an
+   * output report hiddev has not sent yet, so it does not seed the shadow
+   * and the first write of the usage is never elided */
+  *value = v;
+}
+
+const struct transport_ops *transportByName(const char *name) {
+  if (strcmp(name, hiddev_transport.name) == 0)
+    return &hiddev_transport;
+  if (strcmp(name, hidraw_transport.name) == 0)
+    return &hidraw_transport;
+  return NULL;
+}
+
+void registryInit(struct device_registry *reg) {
+  pthread_mutex_init(&reg->lock, NULL);
+  reg->count = 0;
+  memset(reg->dev, 0, sizeof(reg->dev));
+}
+
+int registryAdd(struct device_registry *reg, struct jabra_device *dev) {
+  int index = -1;
+
+  (void)pthread_mutex_lock(&reg->lock);
+  for (int i = 0; i < MAX_DEVICES; i++) {
+    if (reg->dev[i] == NULL) {
+      reg->dev[i] = dev;
+      reg->count++;
+      index = i;
+      break;
+    }
+  }
+  (void)pthread_mutex_unlock(&reg->lock);
+  dev->index = index;
+  return index;
+}
+
+void registryRemove(struct device_registry *reg, struct jabra_device *dev) {
+  (void)pthread_mutex_lock(&reg->lock);
+  if (dev->index >= 0 && reg->dev[dev->index] == dev) {
+    reg->dev[dev->index] = NULL;
+    reg->count--;
+  }
+  (void)pthread_mutex_unlock(&reg->lock);
+}
+
+struct jabra_device *registryGet(struct device_registry *reg, int index) {
+  struct jabra_device *dev = NULL;
+
+  if (index >= 0 && index < MAX_DEVICES) {
+    (void)pthread_mutex_lock(&reg->lock);
+    dev = reg->dev[index];
+    (void)pthread_mutex_unlock(&reg->lock);
+  }
+  return dev;
+}
+
+struct jabra_device *registryFind(struct device_registry *reg, const char *path) {
+  struct jabra_device *dev = NULL;
+
+  (void)pthread_mutex_lock(&reg->lock);
+  for (int i = 0; i < MAX_DEVICES && dev == NULL; i++) {
+    if (reg->dev[i] != NULL && strcmp(reg->dev[i]->path, path) == 0) {
+      dev = reg->dev[i];
+    }
+  }
+  (void)pthread_mutex_unlock(&reg->lock);
+  return dev;
+}
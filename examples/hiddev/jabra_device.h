@@ -0,0 +1,268 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_device.h
+ *
+ * @brief  Per-device context for the Jabra hiddev demo: usage resolution
+ *         cache, shadowed output writes, call state and the registry
+ *         holding every opened device.
+ */
+
+#ifndef JABRA_DEVICE_H
+#define JABRA_DEVICE_H
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+#include <linux/hiddev.h>
+#include <pthread.h>
+
+#include "jabra_hid.h"
+#include "jabra_latency.h"
+#include "jabra_transport.h"
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+
+/* Maximum number of usages kept in the usage resolution cache */
+#define MAX_CACHED_USAGES    256
+
+/* Resolved location and logical range of a single usage */
+struct usage_entry {
+  __u32 report_type;
+  __u32 report_id;
+  __u32 field_index;
+  __u32 usage_index;
+  __u32 usage_code;
+  __s32 logical_minimum;
+  __s32 logical_maximum;
+  int shadow_valid;      /* shadow holds the value the device was last given */
+  __s32 shadow;
+};
+
+/* Usage resolution cache, built once per device after HIDIOCINITREPORT.
+ * The transports add output and feature fields before input fields, so
+ * the usages that are written are the last to miss a full cache */
+struct usage_cache {
+  int count;
+  int skipped;           /* usages of fields that did not fit */
+  struct usage_entry entry[MAX_CACHED_USAGES];
+  struct usage_entry uncached;  /* last usage resolved without a slot */
+};
+
+/* Output write statistics */
+struct output_stats {
+  unsigned long usages_written;
+  unsigned long usages_elided;
+  unsigned long reports_sent;
+  unsigned long reports_elided;
+};
+
+/* Call state bits, packed into jabra_device.callstate with a generation
+ * count above them that changes on every update */
+#define CALL_HOOK            0x01
+#define CALL_MUTE            0x02
+#define CALL_RING            0x04
+#define CALL_FLAGS           0xFF
+#define CALL_GENERATION      0x100
+
+/* System calls counted per device */
+#define DEVCALL_GDEVINFO     0
+#define DEVCALL_INITREPORT   1
+#define DEVCALL_GNAME        2
+#define DEVCALL_GREPORTINFO  3
+#define DEVCALL_GFIELDINFO   4
+#define DEVCALL_GUCODE       5
+#define DEVCALL_GUSAGE       6
+#define DEVCALL_SUSAGE       7
+#define DEVCALL_SUSAGES      8
+#define DEVCALL_SREPORT      9
+#define DEVCALL_GRAWINFO     10
+#define DEVCALL_GRAWNAME     11
+#define DEVCALL_GRDESC       12
+#define DEVCALL_GFEATURE     13
+#define DEVCALL_SFEATURE     14
+#define DEVCALL_GOUTPUT      15
+#define DEVCALL_READ         16
+#define DEVCALL_WRITE        17
+#define DEVCALLS             18
+
+/* Count, failures and time spent per system call, updated atomically
+ * since reads and writes happen on different threads */
+struct call_stats {
+  unsigned long count[DEVCALLS];
+  unsigned long errors[DEVCALLS];
+  __u64 ns[DEVCALLS];
+};
+
+/* Input dispatch statistics, one batch per read from the device */
+struct input_stats {
+  unsigned long batches;
+  unsigned long events;
+  unsigned long max_batch;
+};
+
+/* One opened HID device */
+struct jabra_device {
+  int index;             /* slot in the device registry */
+  const struct transport_ops *ops;
+  void *priv;            /* transport private data */
+  int fd;
+  char path[64];
+  char name[128];
+  struct hiddev_devinfo devinfo;
+  /* written with the lock held, read anywhere through callState() */
+  __u32 callstate;
+  pthread_mutex_t lock;  /* protects everything below */
+  struct usage_cache usages;
+  struct output_stats ostats;
+  struct input_stats istats;
+  struct latency latency;
+  struct call_stats calls;
+};
+
+/* Maximum number of usages staged in one output transaction */
+#define MAX_STAGED_USAGES    16
+
+/* Usage value waiting to be sent by txnCommit() */
+struct staged_usage {
+  struct usage_entry usage;
+  __s32 value;
+};
+
+/* Report whose writes were all dropped because nothing changed */
+struct elided_report {
+  __u32 report_type;
+  __u32 report_id;
+};
+
+/* Group of usage writes sent with one HIDIOCSREPORT per report id,
+ * the device lock must be held from txnBegin() to txnCommit() */
+struct output_txn {
+  struct jabra_device *dev;
+  int count;
+  struct staged_usage staged[MAX_STAGED_USAGES];
+  int elided_count;
+  struct elided_report elided[MAX_STAGED_USAGES];
+};
+
+/* Maximum number of threads opening devices at startup */
+#define MAX_PROBE_WORKERS    16
+
+/* Maximum number of devices served at the same time, enough for load
+ * tests with simulated devices. Indexes run up to 254 so that they fit the
+ * __u8 of a control message, where 255 is CTL_DEVICE_SELECTED */
+#define MAX_DEVICES          255
+
+/* All opened devices, indexed by jabra_device.index */
+struct device_registry {
+  pthread_mutex_t lock;
+  int count;
+  struct jabra_device *dev[MAX_DEVICES];
+};
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+const char *usagePageName(__u32 usage_code);
+
+/* known report layouts are taken from cc instead of walking the device,
+ * new ones are stored in it; NULL disables the capability cache */
+struct capcache;
+void deviceUseCapCache(struct capcache *cc);
+
+/* open and initialize a device node and read its call state, NULL on
+ * failure or if vendor is non-zero and does not match */
+struct jabra_device *deviceOpen(const struct transport_ops *ops, const char *path, __u16 vendor);
+
+/* deviceOpen() paths[0..n-1] on up to MAX_PROBE_WORKERS threads,
+ * dev[i] is NULL where paths[i] could not be opened */
+void deviceOpenAll(const struct transport_ops *ops, const char *const paths[], int n,
+                   __u16 vendor, struct jabra_device *dev[]);
+void deviceClose(struct jabra_device *dev);
+
+/* consistent snapshot of hook, mute and ring without taking the lock */
+static inline __u32 callState(const struct jabra_device *dev) {
+  return __atomic_load_n(&dev->callstate, __ATOMIC_ACQUIRE);
+}
+
+static inline int callFlag(__u32 state, __u32 flag) {
+  return (state & flag) != 0;
+}
+
+/* the device lock must be held, so there is only one writer. Replaces
+ * all of the CALL_FLAGS bits */
+static inline void callStateUpdate(struct jabra_device *dev, __u32 flags) {
+  __u32 state = __atomic_load_n(&dev->callstate, __ATOMIC_RELAXED);
+
+  if ((state & CALL_FLAGS) != flags) {
+    state = (state & ~CALL_FLAGS) | flags;
+    __atomic_store_n(&dev->callstate, state + CALL_GENERATION, __ATOMIC_RELEASE);
+  }
+}
+
+/* ioctl() on the device, counted and timed as call */
+int deviceIoctl(struct jabra_device *dev, int call, unsigned long request, void *arg);
+
+/* count a call made directly, started at start_ns from latencyNow() */
+void deviceAccount(struct jabra_device *dev, int call, __u64 start_ns, int failed);
+
+const char *deviceCallName(int call);
+
+/* see transport_ops.read_events */
+int deviceReadEvents(struct jabra_device *dev, struct hiddev_event *ev, int max);
+
+#if (HIDDEBUG == 1)
+/* hiddev devices only */
+void showReports(struct jabra_device *dev, __u16 report_type);
+#endif
+
+/* used by the transports to fill dev->usages: usagesFit() before the n
+ * usages of a field are added, 0 and the field counted in skipped if
+ * they do not all fit, so one large field does not stop the walk */
+int usagesFit(struct usage_cache *cache, int n);
+struct usage_entry *addUsage(struct usage_cache *cache,
+                             const struct hiddev_field_info *finfo,
+                             __u32 usage_index, __u32 usage_code);
+struct usage_entry *findUsage(struct usage_cache *cache, __u32 report_type, __u32 usage_code);
+
+void txnBegin(struct output_txn *txn, struct jabra_device *dev);
+void txnStage(struct output_txn *txn, unsigned report_type, unsigned page, unsigned code, __s32 value);
+void txnCommit(struct output_txn *txn);
+
+/* the device lock must be held */
+void writeUsage(struct jabra_device *dev, unsigned report_type, unsigned page, unsigned code, __s32 value);
+void readUsage(struct jabra_device *dev, unsigned report_type, unsigned page, unsigned code, __s32* value);
+
+void registryInit(struct device_registry *reg);
+/* assigns dev->index, -1 if the registry is full */
+int registryAdd(struct device_registry *reg, struct jabra_device *dev);
+/* dev keeps its index for the messages about it until it is closed */
+void registryRemove(struct device_registry *reg, struct jabra_device *dev);
+struct jabra_device *registryGet(struct device_registry *reg, int index);
+struct jabra_device *registryFind(struct device_registry *reg, const char *path);
+
+#endif /* JABRA_DEVICE_H */
@@ -0,0 +1,177 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_enum.c
+ *
+ * @brief  HID node enumeration through sysfs, see jabra_enum.h.
+ *
+ *         <sysfs>/class/usbmisc/hiddevN/device is the USB interface, its
+ *         parent is the USB device holding idVendor and idProduct.
+ *         <sysfs>/class/hidraw/hidrawN/device is the HID device, its
+ *         uevent file carries the ids as HID_ID=bus:vendor:product. The
+ *         node name below /dev is taken from DEVNAME in the uevent file.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jabra_enum.h"
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static int readHexAttr(const char *path, __u16 *value) {
+  char buf[16];
+  FILE *f;
+  int ok;
+
+  if ((f = fopen(path, "re")) == NULL) {
+    return -1;
+  }
+  ok = (fgets(buf, sizeof(buf), f) != NULL);
+  fclose(f);
+  if (!ok) {
+    return -1;
+  }
+  *value = (__u16) strtoul(buf, NULL, 16);
+  return 0;
+}
+
+/* HID_ID=0003:00000B0E:00000412 from the uevent file of the HID device */
+static int readHidId(const char *path, __u16 *vendor, __u16 *product) {
+  char line[128];
+  FILE *f;
+  int found = -1;
+  unsigned bus, vid, pid;
+
+  if ((f = fopen(path, "re")) == NULL) {
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "HID_ID=%x:%x:%x", &bus, &vid, &pid) == 3) {
+      *vendor = (__u16) vid;
+      *product = (__u16) pid;
+      found = 0;
+      break;
+    }
+  }
+  fclose(f);
+  return found;
+}
+
+static void devnodeName(const char *sysfs_root, const char *subsystem, const char *node_prefix,
+                        const char *name, char *devnode, size_t size) {
+  const char *slash = strrchr(node_prefix, '/');
+  char path[512];
+  char line[128];
+  FILE *f;
+
+  /* without DEVNAME guess the node next to the prefix */
+  snprintf(devnode, size, "%.*s%s", (int) (slash - node_prefix + 1), node_prefix, name);
+  snprintf(path, sizeof(path), "%s/class/%s/%s/uevent", sysfs_root, subsystem, name);
+  if ((f = fopen(path, "re")) == NULL) {
+    return;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (strncmp(line, "DEVNAME=", 8) == 0) {
+      line[strcspn(line, "\n")] = '\0';
+      snprintf(devnode, size, "/dev/%s", line + 8);
+      break;
+    }
+  }
+  fclose(f);
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int deviceUsbIds(const char *sysfs_root, const char *subsystem, const char *name,
+                 __u16 *vendor, __u16 *product) {
+  char path[512];
+
+  snprintf(path, sizeof(path), "%s/class/%s/%s/device/uevent", sysfs_root, subsystem, name);
+  if (readHidId(path, vendor, product) == 0) {
+    return 0;
+  }
+  snprintf(path, sizeof(path), "%s/class/%s/%s/device/../idVendor", sysfs_root, subsystem, name);
+  if (readHexAttr(path, vendor) < 0) {
+    return -1;
+  }
+  snprintf(path, sizeof(path), "%s/class/%s/%s/device/../idProduct", sysfs_root, subsystem, name);
+  if (readHexAttr(path, product) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+int deviceReportDescriptor(const char *sysfs_root, const char *subsystem, const char *name,
+                           __u8 *buf, int size) {
+  char path[512];
+  FILE *f;
+  int len;
+
+  snprintf(path, sizeof(path), "%s/class/%s/%s/device/report_descriptor",
+    sysfs_root, subsystem, name);
+  if ((f = fopen(path, "re")) == NULL) {
+    return -1;
+  }
+  len = fread(buf, 1, size, f);
+  fclose(f);
+  return len;
+}
+
+int enumerateDevices(const char *sysfs_root, const char *subsystem, const char *node_prefix,
+                     __u16 vendor, enum_handler handler, void *arg) {
+  const char *base = strrchr(node_prefix, '/') + 1;
+  char path[512];
+  char devnode[64 + 256];
+  struct dirent *de;
+  DIR *dir;
+  int found = 0;
+
+  snprintf(path, sizeof(path), "%s/class/%s", sysfs_root, subsystem);
+  if ((dir = opendir(path)) == NULL) {
+    return -1;
+  }
+  while ((de = readdir(dir)) != NULL) {
+    __u16 vid, pid;
+
+    if (strncmp(de->d_name, base, strlen(base)) != 0 ||
+        deviceUsbIds(sysfs_root, subsystem, de->d_name, &vid, &pid) < 0 ||
+        vid != vendor) {
+      continue;
+    }
+    devnodeName(sysfs_root, subsystem, node_prefix, de->d_name, devnode, sizeof(devnode));
+    handler(devnode, vid, pid, arg);
+    found++;
+  }
+  closedir(dir);
+  return found;
+}
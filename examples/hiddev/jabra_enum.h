@@ -0,0 +1,69 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_enum.h
+ *
+ * @brief  HID node enumeration through sysfs. Vendor and product ids are
+ *         read from the device behind <sysfs>/class/<subsystem>/<node>,
+ *         so only matching nodes are ever opened. The sysfs root is a
+ *         parameter so that a fake tree can be used instead of /sys.
+ */
+
+#ifndef JABRA_ENUM_H
+#define JABRA_ENUM_H
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+#define SYSFS_ROOT           "/sys"
+
+/* devnode is the /dev path of a node matching the vendor id */
+typedef void (*enum_handler)(const char *devnode, __u16 vendor, __u16 product, void *arg);
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+
+/* read the ids of node "name" (e.g. "hiddev3") of a sysfs class
+ * (e.g. "usbmisc"), -1 if unknown */
+int deviceUsbIds(const char *sysfs_root, const char *subsystem, const char *name,
+                 __u16 *vendor, __u16 *product);
+
+/* read the raw HID report descriptor of node "name" into buf, returns
+ * its length or -1 if the node has none */
+int deviceReportDescriptor(const char *sysfs_root, const char *subsystem, const char *name,
+                           __u8 *buf, int size);
+
+/* call handler for every node of the class whose name matches the last
+ * component of node_prefix (e.g. "/dev/usb/hiddev") and whose vendor
+ * matches, returns the number of matches or -1 if the class is not found */
+int enumerateDevices(const char *sysfs_root, const char *subsystem, const char *node_prefix,
+                     __u16 vendor, enum_handler handler, void *arg);
+
+#endif /* JABRA_ENUM_H */
@@ -0,0 +1,241 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_enum_test.c
+ *
+ * @brief  Test of the sysfs enumeration of jabra_enum.h on a fake sysfs
+ *         tree built in a temporary directory. It holds a Jabra and a
+ *         Logitech node in both the usbmisc (hiddev) and the hidraw
+ *         class, laid out the way the kernel does it, plus a usbmisc
+ *         node of another kind. Only the Jabra nodes may be reported.
+ *
+ *         Usage: jabra_enum_test, run by make check.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "jabra_enum.h"
+#include "jabra_hid.h"
+#include "jabra_test.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+#define OTHER_VID            ((__u16) 0x046D)
+
+/* what enumerateDevices() reported */
+struct found {
+  int count;
+  char devnode[4][64];
+  __u16 vendor[4];
+  __u16 product[4];
+};
+
+/****************************************************************************/
+/*                              PRIVATE DATA                                */
+/****************************************************************************/
+static char root[256];
+
+/* an empty telephony headset collection */
+static const __u8 descriptor[] = { 0x05, 0x0B, 0x09, 0x05, 0xA1, 0x01, 0xC0 };
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+
+/* mkdir -p root/rel */
+static void makeDir(const char *rel) {
+  char path[512];
+
+  snprintf(path, sizeof(path), "%s/%s", root, rel);
+  for (char *s = strchr(path + strlen(root) + 1, '/'); s != NULL; s = strchr(s + 1, '/')) {
+    *s = '\0';
+    (void)mkdir(path, 0755);
+    *s = '/';
+  }
+  (void)mkdir(path, 0755);
+}
+
+static void writeFile(const char *rel, const void *data, size_t len) {
+  char path[512];
+  FILE *f;
+
+  snprintf(path, sizeof(path), "%s/%s", root, rel);
+  if ((f = fopen(path, "we")) == NULL) {
+    perror(path);
+    return;
+  }
+  (void)fwrite(data, 1, len, f);
+  fclose(f);
+}
+
+static void writeText(const char *rel, const char *text) {
+  writeFile(rel, text, strlen(text));
+}
+
+/* root/rel is a symlink to target, relative like those of sysfs */
+static void makeLink(const char *target, const char *rel) {
+  char path[512];
+
+  snprintf(path, sizeof(path), "%s/%s", root, rel);
+  if (symlink(target, path) < 0) {
+    perror(path);
+  }
+}
+
+/* class/usbmisc/<node>/device is the USB interface, the USB device above
+ * it holds the ids */
+static void addHiddev(const char *node, const char *usbdev, const char *vid, const char *pid) {
+  char rel[256], text[256];
+
+  snprintf(rel, sizeof(rel), "devices/usb1/%s/%s:1.3", usbdev, usbdev);
+  makeDir(rel);
+  snprintf(text, sizeof(text), "DEVTYPE=usb_interface\nDRIVER=usbhid\n");
+  snprintf(rel, sizeof(rel), "devices/usb1/%s/%s:1.3/uevent", usbdev, usbdev);
+  writeText(rel, text);
+  snprintf(rel, sizeof(rel), "devices/usb1/%s/idVendor", usbdev);
+  writeText(rel, vid);
+  snprintf(rel, sizeof(rel), "devices/usb1/%s/idProduct", usbdev);
+  writeText(rel, pid);
+
+  snprintf(rel, sizeof(rel), "class/usbmisc/%s", node);
+  makeDir(rel);
+  snprintf(text, sizeof(text), "../../../devices/usb1/%s/%s:1.3", usbdev, usbdev);
+  snprintf(rel, sizeof(rel), "class/usbmisc/%s/device", node);
+  makeLink(text, rel);
+  snprintf(text, sizeof(text), "MAJOR=180\nMINOR=0\nDEVNAME=usb/%s\n", node);
+  snprintf(rel, sizeof(rel), "class/usbmisc/%s/uevent", node);
+  writeText(rel, text);
+}
+
+/* class/hidraw/<node>/device is the HID device, its uevent has HID_ID */
+static void addHidraw(const char *node, const char *hiddev, __u16 vid, __u16 pid) {
+  char rel[256], text[256];
+
+  snprintf(rel, sizeof(rel), "devices/usb1/%s", hiddev);
+  makeDir(rel);
+  snprintf(text, sizeof(text), "DRIVER=hid-generic\nHID_ID=0003:%08X:%08X\nHID_NAME=Test\n",
+    vid, pid);
+  snprintf(rel, sizeof(rel), "devices/usb1/%s/uevent", hiddev);
+  writeText(rel, text);
+  snprintf(rel, sizeof(rel), "devices/usb1/%s/report_descriptor", hiddev);
+  writeFile(rel, descriptor, sizeof(descriptor));
+
+  snprintf(rel, sizeof(rel), "class/hidraw/%s", node);
+  makeDir(rel);
+  snprintf(text, sizeof(text), "../../../devices/usb1/%s", hiddev);
+  snprintf(rel, sizeof(rel), "class/hidraw/%s/device", node);
+  makeLink(text, rel);
+  snprintf(text, sizeof(text), "MAJOR=244\nMINOR=0\nDEVNAME=%s\n", node);
+  snprintf(rel, sizeof(rel), "class/hidraw/%s/uevent", node);
+  writeText(rel, text);
+}
+
+static void enum_found(const char *devnode, __u16 vendor, __u16 product, void *arg) {
+  struct found *f = arg;
+
+  if (f->count < 4) {
+    snprintf(f->devnode[f->count], sizeof(f->devnode[0]), "%.*s",
+      (int) sizeof(f->devnode[0]) - 1, devnode);
+    f->vendor[f->count] = vendor;
+    f->product[f->count] = product;
+  }
+  f->count++;
+}
+
+static void testHiddev(void) {
+  struct found f;
+  __u16 vid, pid;
+
+  memset(&f, 0, sizeof(f));
+  CHECK_EQ(enumerateDevices(root, "usbmisc", "/dev/usb/hiddev", JABRA_VID, enum_found, &f), 1);
+  CHECK_EQ(f.count, 1);
+  CHECK(strcmp(f.devnode[0], "/dev/usb/hiddev0") == 0);
+  CHECK_EQ(f.vendor[0], JABRA_VID);
+  CHECK_EQ(f.product[0], 0x0412);
+
+  CHECK_EQ(deviceUsbIds(root, "usbmisc", "hiddev1", &vid, &pid), 0);
+  CHECK_EQ(vid, OTHER_VID);
+  CHECK_EQ(pid, 0xC52B);
+  CHECK_EQ(deviceUsbIds(root, "usbmisc", "hiddev9", &vid, &pid), -1);
+}
+
+static void testHidraw(void) {
+  struct found f;
+  __u8 buf[64];
+
+  memset(&f, 0, sizeof(f));
+  CHECK_EQ(enumerateDevices(root, "hidraw", "/dev/hidraw", JABRA_VID, enum_found, &f), 1);
+  CHECK_EQ(f.count, 1);
+  CHECK(strcmp(f.devnode[0], "/dev/hidraw1") == 0);
+  CHECK_EQ(f.vendor[0], JABRA_VID);
+  CHECK_EQ(f.product[0], 0x2456);
+
+  CHECK_EQ(deviceReportDescriptor(root, "hidraw", "hidraw1", buf, sizeof(buf)), sizeof(descriptor));
+  CHECK(memcmp(buf, descriptor, sizeof(descriptor)) == 0);
+}
+
+static void testMissing(void) {
+  struct found f;
+
+  memset(&f, 0, sizeof(f));
+  CHECK_EQ(enumerateDevices(root, "nosuchclass", "/dev/hidraw", JABRA_VID, enum_found, &f), -1);
+  CHECK_EQ(enumerateDevices(root, "usbmisc", "/dev/usb/hiddev", 0x1234, enum_found, &f), 0);
+  CHECK_EQ(f.count, 0);
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int main(int argc, char **argv) {
+  char cmd[300];
+
+  snprintf(root, sizeof(root), "%s/jabra_sysfs.XXXXXX", getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+  if (mkdtemp(root) == NULL) {
+    perror(root);
+    return 1;
+  }
+  addHiddev("hiddev0", "1-1", "0b0e\n", "0412\n");
+  addHiddev("hiddev1", "1-2", "046d\n", "c52b\n");
+  /* another usbmisc node of a Jabra device, not a hiddev node */
+  addHiddev("lp0", "1-3", "0b0e\n", "0001\n");
+  addHidraw("hidraw0", "0003:046D:C52B.0001", OTHER_VID, 0xC52B);
+  addHidraw("hidraw1", "0003:0B0E:2456.0002", JABRA_VID, 0x2456);
+
+  testHiddev();
+  testHidraw();
+  testMissing();
+
+  snprintf(cmd, sizeof(cmd), "rm -rf '%s'", root);
+  (void)system(cmd);
+  return testResult("jabra_enum_test");
+}
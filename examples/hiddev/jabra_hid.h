@@ -0,0 +1,106 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_hid.h
+ *
+ * @brief  HID usage pages and usage ids used by the Jabra hiddev demo.
+ *
+ * @author Flemming Mortensen
+ */
+
+#ifndef JABRA_HID_H
+#define JABRA_HID_H
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+#define HIDDEBUG 0
+
+/* Jabra Vendor Id */
+#define JABRA_VID            ((__u16) 0x0B0E)
+
+/* HID Usage Page definitions */
+#define TelephonyUsagePage   ((__u16) 0x000B)
+#define ConsumerUsagePage    ((__u16) 0x000C)
+#define LEDUsagePage         ((__u16) 0x0008)
+#define ButtonUsagePage      ((__u16) 0x0009)
+
+/* HID Usage Id definitions: LED usage page (0x08) */
+#define Led_Mute             ((__u16) 0x0009)
+#define Led_Off_Hook         ((__u16) 0x0017)
+#define Led_Ring             ((__u16) 0x0018)
+#define Led_Hold             ((__u16) 0x0020)
+#define Led_Microphone       ((__u16) 0x0021)
+#define Led_On_Line          ((__u16) 0x002A)
+#define Led_Off_Line         ((__u16) 0x002B)
+
+/* HID Usage Id definitions:  Telephony usage page (0x0B) */
+#define Tel_Hook_Switch      ((__u16) 0x0020)
+#define Tel_Flash            ((__u16) 0x0021)
+#define Tel_Feature          ((__u16) 0x0022)
+#define Tel_Hold             ((__u16) 0x0023)
+#define Tel_Redial           ((__u16) 0x0024)
+#define Tel_Transfer         ((__u16) 0x0025)
+#define Tel_Drop             ((__u16) 0x0026)
+#define Tel_Park             ((__u16) 0x0027)
+#define Tel_Forward          ((__u16) 0x0028)
+#define Tel_Alternate        ((__u16) 0x0029)
+#define Tel_Line             ((__u16) 0x002A)
+#define Tel_Speaker          ((__u16) 0x002B)
+#define Tel_Conference       ((__u16) 0x002C)
+#define Tel_Ring_Enable      ((__u16) 0x002D)
+#define Tel_Ring_Select      ((__u16) 0x002E)
+#define Tel_Phone_Mute       ((__u16) 0x002F)
+#define Tel_Caller           ((__u16) 0x0030)
+#define Tel_Send             ((__u16) 0x0031)
+#define Tel_VoiceMail        ((__u16) 0x0070)
+#define Tel_Ringer           ((__u16) 0x009E)
+#define Tel_Phone_Key_0      ((__u16) 0x00B0)
+#define Tel_Phone_Key_1      ((__u16) 0x00B1)
+#define Tel_Phone_Key_2      ((__u16) 0x00B2)
+#define Tel_Phone_Key_3      ((__u16) 0x00B3)
+#define Tel_Phone_Key_4      ((__u16) 0x00B4)
+#define Tel_Phone_Key_5      ((__u16) 0x00B5)
+#define Tel_Phone_Key_6      ((__u16) 0x00B6)
+#define Tel_Phone_Key_7      ((__u16) 0x00B7)
+#define Tel_Phone_Key_8      ((__u16) 0x00B8)
+#define Tel_Phone_Key_9      ((__u16) 0x00B9)
+#define Tel_Phone_Key_Star   ((__u16) 0x00BA)
+#define Tel_Phone_Key_Pound  ((__u16) 0x00BB)
+#define Tel_Phone_Key_A      ((__u16) 0x00BC)
+#define Tel_Phone_Key_B      ((__u16) 0x00BD)
+#define Tel_Phone_Key_C      ((__u16) 0x00BE)
+#define Tel_Phone_Key_D      ((__u16) 0x00BF)
+#define Tel_Control          ((__u16) 0xFFFF)
+
+/* HID Usage Id definitions: Consumer usage page (0x0C) */
+#define Con_Volume_Incr      ((__u16) 0x00E9)
+#define Con_Volume_Decr      ((__u16) 0x00EA)
+
+#endif /* JABRA_HID_H */
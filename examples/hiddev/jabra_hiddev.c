@@ -0,0 +1,330 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_hiddev.c
+ *
+ * @brief  hiddev transport. Usages are located by walking the report,
+ *         field and usage tables with ioctls, written with HIDIOCSUSAGE(S)
+ *         plus HIDIOCSREPORT, and input arrives as struct hiddev_event.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "jabra_device.h"
+#include "jabra_transport.h"
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static int hiddevOpen(struct jabra_device *dev) {
+  if ((dev->fd = open(dev->path, O_RDONLY | O_CLOEXEC)) < 0) {
+    if (errno == EACCES) {
+      fprintf(stderr, "%s: No permission, try this as root.\n", dev->path);
+    } else {
+      perror(dev->path);
+    }
+    return -1;
+  }
+  if (deviceIoctl(dev, DEVCALL_GDEVINFO, HIDIOCGDEVINFO, &dev->devinfo) < 0) {
+    perror("ioctl HIDIOCGDEVINFO");
+    close(dev->fd);
+    return -1;
+  }
+  deviceIoctl(dev, DEVCALL_INITREPORT, HIDIOCINITREPORT, NULL);
+  deviceIoctl(dev, DEVCALL_GNAME, HIDIOCGNAME(sizeof(dev->name)), dev->name);
+  return 0;
+}
+
+static void hiddevClose(struct jabra_device *dev) {
+  close(dev->fd);
+}
+
+static void hiddevBuildUsages(struct jabra_device *dev) {
+  struct usage_cache *cache = &dev->usages;
+  /* the written usages first, should the cache run out */
+  static const __u32 report_types[] = {
+    HID_REPORT_TYPE_OUTPUT, HID_REPORT_TYPE_FEATURE, HID_REPORT_TYPE_INPUT
+  };
+  struct hiddev_report_info rinfo;
+  struct hiddev_field_info finfo;
+  struct hiddev_usage_ref uref;
+
+  cache->count = 0;
+  cache->skipped = 0;
+  for (int t = 0; t < sizeof(report_types) / sizeof(report_types[0]); t++) {
+    rinfo.report_type = report_types[t];
+    rinfo.report_id = HID_REPORT_ID_FIRST;
+
+    while (deviceIoctl(dev, DEVCALL_GREPORTINFO, HIDIOCGREPORTINFO, &rinfo) >= 0) {
+      for (int i = 0; i < rinfo.num_fields; i++) {
+        finfo.report_type = rinfo.report_type;
+        finfo.report_id   = rinfo.report_id;
+        finfo.field_index = i;
+        if (deviceIoctl(dev, DEVCALL_GFIELDINFO, HIDIOCGFIELDINFO, &finfo) < 0 ||
+            !usagesFit(cache, finfo.maxusage)) {
+          continue;
+        }
+        for (int j = 0; j < finfo.maxusage; j++) {
+          uref.report_type = finfo.report_type;
+          uref.report_id   = finfo.report_id;
+          uref.field_index = i;
+          uref.usage_index = j;
+          if (deviceIoctl(dev, DEVCALL_GUCODE, HIDIOCGUCODE, &uref) < 0) {
+            continue;
+          }
+          (void)addUsage(cache, &finfo, j, uref.usage_code);
+        }
+      }
+      rinfo.report_id |= HID_REPORT_ID_NEXT;
+    }
+  }
+}
+
+/* spot check a cached layout: one HIDIOCGFIELDINFO and HIDIOCGUCODE per
+ * output and feature field, -1 if the device does not match */
+static int hiddevCheckUsages(struct jabra_device *dev) {
+  struct usage_cache *cache = &dev->usages;
+  struct hiddev_field_info finfo;
+  struct hiddev_usage_ref uref;
+  const struct usage_entry *prev = NULL;
+
+  for (int i = 0; i < cache->count; i++) {
+    const struct usage_entry *u = &cache->entry[i];
+
+    if (u->report_type == HID_REPORT_TYPE_INPUT ||
+        (prev != NULL && prev->report_type == u->report_type &&
+         prev->report_id == u->report_id && prev->field_index == u->field_index)) {
+      continue;
+    }
+    prev = u;
+
+    finfo.report_type = u->report_type;
+    finfo.report_id   = u->report_id;
+    finfo.field_index = u->field_index;
+    if (deviceIoctl(dev, DEVCALL_GFIELDINFO, HIDIOCGFIELDINFO, &finfo) < 0 ||
+        finfo.maxusage <= u->usage_index ||
+        finfo.logical_minimum != u->logical_minimum ||
+        finfo.logical_maximum != u->logical_maximum) {
+      return -1;
+    }
+    uref.report_type = u->report_type;
+    uref.report_id   = u->report_id;
+    uref.field_index = u->field_index;
+    uref.usage_index = u->usage_index;
+    if (deviceIoctl(dev, DEVCALL_GUCODE, HIDIOCGUCODE, &uref) < 0 || uref.usage_code != u->usage_code) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int hiddevResolveUsage(struct jabra_device *dev, __u32 report_type, __u32 usage_code,
+                              struct usage_entry *u) {
+  struct hiddev_field_info finfo;
+  struct hiddev_usage_ref uref;
+
+  uref.report_type = report_type;
+  uref.report_id   = HID_REPORT_ID_UNKNOWN;
+  uref.usage_code  = usage_code;
+  if (deviceIoctl(dev, DEVCALL_GUSAGE, HIDIOCGUSAGE, &uref) < 0) {
+    perror("HIDIOCGUSAGE");
+    return -1;
+  }
+  finfo.report_type = uref.report_type;
+  finfo.report_id   = uref.report_id;
+  finfo.field_index = uref.field_index;
+  if (deviceIoctl(dev, DEVCALL_GFIELDINFO, HIDIOCGFIELDINFO, &finfo) < 0) {
+    perror("HIDIOCGFIELDINFO");
+    return -1;
+  }
+  u->report_type     = finfo.report_type;
+  u->report_id       = finfo.report_id;
+  u->field_index     = finfo.field_index;
+  u->usage_index     = uref.usage_index;
+  u->usage_code      = usage_code;
+  u->logical_minimum = finfo.logical_minimum;
+  u->logical_maximum = finfo.logical_maximum;
+  return 0;
+}
+
+static int hiddevGetUsage(struct jabra_device *dev, const struct usage_entry *u, __s32 *value) {
+  struct hiddev_usage_ref uref;
+
+  uref.report_type = u->report_type;
+  uref.report_id   = u->report_id;
+  uref.field_index = u->field_index;
+  uref.usage_index = u->usage_index;
+  uref.usage_code  = u->usage_code;
+  if (deviceIoctl(dev, DEVCALL_GUSAGE, HIDIOCGUSAGE, &uref) < 0) {
+    perror("HIDIOCGUSAGE");
+    return -1;
+  }
+  *value = uref.value;
+  return 0;
+}
+
+static int hiddevSetUsages(struct jabra_device *dev, const struct usage_entry *u,
+                           const __s32 *values, int n) {
+  struct hiddev_usage_ref_multi mref;
+
+  mref.uref.report_type = u->report_type;
+  mref.uref.report_id   = u->report_id;
+  mref.uref.field_index = u->field_index;
+  mref.uref.usage_index = u->usage_index;
+  mref.uref.usage_code  = u->usage_code;
+  if (n == 1) {
+    mref.uref.value = values[0];
+    if (deviceIoctl(dev, DEVCALL_SUSAGE, HIDIOCSUSAGE, &mref.uref) < 0) {
+      perror("HIDIOCSUSAGE");
+      return -1;
+    }
+    return 0;
+  }
+
+  mref.num_values = n;
+  for (int k = 0; k < n; k++) {
+    mref.values[k] = values[k];
+  }
+  if (deviceIoctl(dev, DEVCALL_SUSAGES, HIDIOCSUSAGES, &mref) < 0) {
+    perror("HIDIOCSUSAGES");
+    return -1;
+  }
+  return 0;
+}
+
+static int hiddevSendReport(struct jabra_device *dev, __u32 report_type, __u32 report_id) {
+  struct hiddev_report_info rinfo;
+
+  rinfo.report_type = report_type;
+  rinfo.report_id   = report_id;
+  if (deviceIoctl(dev, DEVCALL_SREPORT, HIDIOCSREPORT, &rinfo) < 0) {
+    perror("HIDIOCSREPORT");
+    return -1;
+  }
+  return 0;
+}
+
+static int hiddevReadEvents(struct jabra_device *dev, struct hiddev_event *ev, int max) {
+  __u64 start = latencyNow();
+  int rd = read(dev->fd, ev, max * sizeof(ev[0]));
+
+  deviceAccount(dev, DEVCALL_READ, start, rd < 0);
+
+  if (rd < (int) sizeof(ev[0])) {
+    if (rd < 0)
+      perror("error reading");
+    else
+      fprintf(stderr, "got too short read from device\n");
+    return -1;
+  }
+  return rd / sizeof(ev[0]);
+}
+
+/****************************************************************************/
+/*                              EXPORTED DATA                               */
+/****************************************************************************/
+const struct transport_ops hiddev_transport = {
+  .name          = "hiddev",
+  .subsystem     = "usbmisc",
+  .node_prefix   = "/dev/usb/hiddev",
+  .open          = hiddevOpen,
+  .close         = hiddevClose,
+  .build_usages  = hiddevBuildUsages,
+  .check_usages  = hiddevCheckUsages,
+  .resolve_usage = hiddevResolveUsage,
+  .get_usage     = hiddevGetUsage,
+  .set_usages    = hiddevSetUsages,
+  .send_report   = hiddevSendReport,
+  .read_events   = hiddevReadEvents,
+};
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+#if (HIDDEBUG == 1)
+void showReports(struct jabra_device *dev, __u16 report_type) {
+  int fd = dev->fd;
+  struct hiddev_report_info rinfo;
+  struct hiddev_field_info finfo;
+  struct hiddev_usage_ref uref;
+  int ret;
+
+  rinfo.report_type = report_type;
+  rinfo.report_id = HID_REPORT_ID_FIRST;
+  ret = ioctl(fd, HIDIOCGREPORTINFO, &rinfo);
+
+  while (ret >= 0) {
+    printf("HIDIOCGREPORTINFO: report_id=0x%X (%u fields)\n", rinfo.report_id, rinfo.num_fields);
+    for (int i = 0; i < rinfo.num_fields; i++) {
+      finfo.report_type = rinfo.report_type;
+      finfo.report_id   = rinfo.report_id;
+      finfo.field_index = i;
+      ioctl(fd, HIDIOCGFIELDINFO, &finfo);
+
+      fprintf(stdout, "HIDIOCGFIELDINFO: field_index=%u maxusage=%u flags=0x%X\n"
+          "\tphysical=0x%X logical=0x%X application=0x%X reportid=0x%X\n"
+          "\tlogical_minimum=%d,maximum=%d physical_minimum=%d,maximum=%d\n",
+        finfo.field_index,
+        finfo.maxusage,
+        finfo.flags,
+        finfo.physical,
+        finfo.logical,
+        finfo.application,
+        finfo.report_id,
+        finfo.logical_minimum,
+        finfo.logical_maximum,
+        finfo.physical_minimum,
+        finfo.physical_maximum);
+
+      for (int j = 0; j < finfo.maxusage; j++) {
+        uref.report_type = finfo.report_type;
+        uref.report_id   = finfo.report_id;
+        uref.field_index = i;
+        uref.usage_index = j;
+        ioctl(fd, HIDIOCGUCODE, &uref);
+        ioctl(fd, HIDIOCGUSAGE, &uref);
+
+        fprintf(stdout, " >> usage_index=%u usage_code=0x%X (%s) value=%d\n",
+          uref.usage_index,
+          uref.usage_code,
+          usagePageName(uref.usage_code),
+          uref.value);
+
+      }
+    }
+    fprintf(stdout, "\n");
+
+    rinfo.report_id |= HID_REPORT_ID_NEXT;
+    ret = ioctl(fd, HIDIOCGREPORTINFO, &rinfo);
+  }
+}
+#endif
+
@@ -25,15 +25,50 @@
  * @file   jabra_hiddev_demo.c
  *
  * @brief  Demonstration program for basic call control functionality:
- *         mute/offhook/ringer using the Linux hiddev device interface.
+ *         mute/offhook/ringer using the Linux hiddev or hidraw device
+ *         interface.
  *
  *         This program will work with most Jabra devices.
  *
+ *         Every Jabra device found is served from one event loop, the
+ *         keyboard commands apply to the selected device, chosen by
+ *         typing its number from the device list and Enter. Devices
+ *         plugged in or removed while running are picked up at once.
+ *         Input is read on the event loop thread and handed through a
+ *         lock-free ring to a handler thread, which does the call
+ *         control and the output writes. Keyboard commands and control
+ *         requests take the same ring, so the event loop never waits for
+ *         an output transfer or a device lock. Call control messages are
+ *         logged asynchronously, run with -v to see every input event.
+ *
+ *         With -w <file> the input events of every device are captured
+ *         to <file>.<n>. Such a trace is fed back through the same
+ *         pipeline with -r <trace> as fast as possible, or with -R at
+ *         its recorded pace, to measure events/s and latency without a
+ *         headset. -s <spec> adds a simulated headset instead, -n <n>
+ *         of each (see jabra_sim.c for the spec). The program ends when
+ *         the traces and simulation scripts are done and prints the
+ *         events/s and latency over all of them.
+ *
+ *         With -d <socket> the program runs without a terminal and is
+ *         driven through the local control socket of jabra_control.h
+ *         instead, by any number of clients at the same time. With
+ *         -m <file> (e.g. /dev/shm/jabra) the call state of every device
+ *         and the same notifications are published in shared memory,
+ *         see jabra_shm.h.
+ *
  *         The program must have priviledges to read and write the
- *         /dev/usb/hiddev[0-19] device.
+ *         /dev/usb/hiddev* devices, or the /dev/hidraw* devices when
+ *         started with -t hidraw.
  *
- *         To compile:
- *         gcc jabra_hiddev_demo.c -o jabra_hiddev_demo -lpthread
+ *         To compile run make (see the Makefile), or:
+ *         gcc jabra_hiddev_demo.c jabra_callctl.c jabra_capcache.c \
+ *             jabra_control.c jabra_shm.c \
+ *             jabra_device.c jabra_enum.c jabra_hiddev.c jabra_hidraw.c \
+ *             jabra_hotplug.c jabra_latency.c jabra_log.c jabra_rdesc.c \
+ *             jabra_reactor.c jabra_replay.c jabra_ring.c jabra_sim.c \
+ *             jabra_trace.c \
+ *             -o jabra_hiddev_demo -lpthread
  *
  * @author Flemming Mortensen
  */
@@ -42,91 +77,87 @@
 /*                              INCLUDE FILES                               */
 /****************************************************************************/
 #include <asm/types.h>
+#include <dirent.h>
 #include <errno.h>
-#include <fcntl.h>
 #include <linux/hiddev.h>
 #include <pthread.h>
-#include <sys/ioctl.h>
-#include <sys/time.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <termios.h>
 #include <unistd.h>
 
+#include "jabra_callctl.h"
+#include "jabra_capcache.h"
+#include "jabra_control.h"
+#include "jabra_device.h"
+#include "jabra_enum.h"
+#include "jabra_hid.h"
+#include "jabra_hotplug.h"
+#include "jabra_latency.h"
+#include "jabra_log.h"
+#include "jabra_reactor.h"
+#include "jabra_ring.h"
+#include "jabra_shm.h"
+#include "jabra_trace.h"
+
 /****************************************************************************/
 /*                      PRIVATE TYPES and DEFINITIONS                       */
 /****************************************************************************/
-#define HIDDEBUG 0
-
-/* Jabra Vendor Id */
-#define JABRA_VID            ((__u16) 0x0B0E)
-
-/* HID Usage Page definitions */
-#define TelephonyUsagePage   ((__u16) 0x000B)
-#define ConsumerUsagePage    ((__u16) 0x000C)
-#define LEDUsagePage         ((__u16) 0x0008)
-#define ButtonUsagePage      ((__u16) 0x0009)
-
-/* HID Usage Id definitions: LED usage page (0x08) */
-#define Led_Mute             ((__u16) 0x0009)
-#define Led_Off_Hook         ((__u16) 0x0017)
-#define Led_Ring             ((__u16) 0x0018)
-#define Led_Hold             ((__u16) 0x0020)
-#define Led_Microphone       ((__u16) 0x0021)
-#define Led_On_Line          ((__u16) 0x002A)
-#define Led_Off_Line         ((__u16) 0x002B)
-
-/* HID Usage Id definitions:  Telephony usage page (0x0B) */
-#define Tel_Hook_Switch      ((__u16) 0x0020)
-#define Tel_Flash            ((__u16) 0x0021)
-#define Tel_Feature          ((__u16) 0x0022)
-#define Tel_Hold             ((__u16) 0x0023)
-#define Tel_Redial           ((__u16) 0x0024)
-#define Tel_Transfer         ((__u16) 0x0025)
-#define Tel_Drop             ((__u16) 0x0026)
-#define Tel_Park             ((__u16) 0x0027)
-#define Tel_Forward          ((__u16) 0x0028)
-#define Tel_Alternate        ((__u16) 0x0029)
-#define Tel_Line             ((__u16) 0x002A)
-#define Tel_Speaker          ((__u16) 0x002B)
-#define Tel_Conference       ((__u16) 0x002C)
-#define Tel_Ring_Enable      ((__u16) 0x002D)
-#define Tel_Ring_Select      ((__u16) 0x002E)
-#define Tel_Phone_Mute       ((__u16) 0x002F)
-#define Tel_Caller           ((__u16) 0x0030)
-#define Tel_Send             ((__u16) 0x0031)
-#define Tel_VoiceMail        ((__u16) 0x0070)
-#define Tel_Ringer           ((__u16) 0x009E)
-#define Tel_Phone_Key_0      ((__u16) 0x00B0)
-#define Tel_Phone_Key_1      ((__u16) 0x00B1)
-#define Tel_Phone_Key_2      ((__u16) 0x00B2)
-#define Tel_Phone_Key_3      ((__u16) 0x00B3)
-#define Tel_Phone_Key_4      ((__u16) 0x00B4)
-#define Tel_Phone_Key_5      ((__u16) 0x00B5)
-#define Tel_Phone_Key_6      ((__u16) 0x00B6)
-#define Tel_Phone_Key_7      ((__u16) 0x00B7)
-#define Tel_Phone_Key_8      ((__u16) 0x00B8)
-#define Tel_Phone_Key_9      ((__u16) 0x00B9)
-#define Tel_Phone_Key_Star   ((__u16) 0x00BA)
-#define Tel_Phone_Key_Pound  ((__u16) 0x00BB)
-#define Tel_Phone_Key_A      ((__u16) 0x00BC)
-#define Tel_Phone_Key_B      ((__u16) 0x00BD)
-#define Tel_Phone_Key_C      ((__u16) 0x00BE)
-#define Tel_Phone_Key_D      ((__u16) 0x00BF)
-#define Tel_Control          ((__u16) 0xFFFF)
-
-/* HID Usage Id definitions: Consumer usage page (0x0C) */
-#define Con_Volume_Incr      ((__u16) 0x00E9)
-#define Con_Volume_Decr      ((__u16) 0x00EA)
+
+/* Commands queued as RING_COMMAND and run on the handler thread */
+#define CMD_HOOK             0   /* argument 0 or 1, or -1 to toggle */
+#define CMD_MUTE             1
+#define CMD_RING             2
+#define CMD_STATS            3   /* every device, dev is NULL */
+#define CMD_LATENCY          4   /* every device, dev is NULL */
+
+/* tag of a command from a control client, 0 is a key press */
+#define REPLY_TAG(client, seq) (((__u64) (client) << 16) | (seq))
+
+struct call_command {
+  int event;             /* CALL_EV_KEY_* */
+  __u32 flag;            /* state bit it toggles */
+};
 
 /****************************************************************************/
 /*                              PRIVATE DATA                                */
 /****************************************************************************/
-static int fd;
-static int mutestate;
-static int hookstate;
-static int ringerstate;
-static int run = 1;
-static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static const struct call_command call_commands[] = {
+  [CMD_HOOK] = { CALL_EV_KEY_HOOK, CALL_HOOK },
+  [CMD_MUTE] = { CALL_EV_KEY_MUTE, CALL_MUTE },
+  [CMD_RING] = { CALL_EV_KEY_RING, CALL_RING },
+};
+
+static const struct transport_ops *transport = &hiddev_transport;
+static struct device_registry devices;
+static int selected = 0;
+static int typed = -1;           /* device number being typed, -1 if none */
+static struct reactor reactor;
+static struct event_ring events;
+static struct hotplug hotplug = { -1 };
+static struct capcache capabilities;
+static struct termios saved_tio;
+static int tio_saved = 0;
+static const char *capture_path = NULL;
+static int captures = 0;
+static struct trace_writer *recorders[MAX_DEVICES];
+static const char *replays[MAX_DEVICES];
+static int replay_paced[MAX_DEVICES];
+static int n_replays = 0;
+static const char *sim_specs[MAX_DEVICES];
+static int n_sim_specs = 0;
+static int sim_copies = 1;
+static struct latency totals;
+static unsigned long total_events = 0;
+static struct control control = { -1 };
+static const char *control_path = NULL;
+static struct shm_publisher statepage;
+static const char *statepage_path = NULL;
 
 /****************************************************************************/
 /*                              EXPORTED DATA                               */
@@ -137,360 +168,633 @@ static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
 /****************************************************************************/
 /*                            PRIVATE FUNCTIONS                             */
 /****************************************************************************/
-static const char *usagePageName(__u32 usage_code) {
-  __u16 hi = (usage_code >> 16) & 0xFFFF;
+static void printStats(struct jabra_device *dev) {
+  fprintf(stdout, "[%d] Output reports sent=%lu elided=%lu, usage writes=%lu elided=%lu\n",
+    dev->index,
+    dev->ostats.reports_sent, dev->ostats.reports_elided,
+    dev->ostats.usages_written, dev->ostats.usages_elided);
+  fprintf(stdout, "[%d] Input batches=%lu events=%lu (%.1f per batch, max %lu)\n",
+    dev->index,
+    dev->istats.batches, dev->istats.events,
+    dev->istats.batches ? (double) dev->istats.events / dev->istats.batches : 0.0,
+    dev->istats.max_batch);
+  for (int c = 0; c < DEVCALLS; c++) {
+    unsigned long n = __atomic_load_n(&dev->calls.count[c], __ATOMIC_RELAXED);
+    __u64 ns = __atomic_load_n(&dev->calls.ns[c], __ATOMIC_RELAXED);
+    if (n != 0) {
+      fprintf(stdout, "[%d]   %-17s n=%lu errors=%lu total=%.1f us mean=%.1f us\n",
+        dev->index, deviceCallName(c), n,
+        __atomic_load_n(&dev->calls.errors[c], __ATOMIC_RELAXED),
+        ns / 1000.0, (double) ns / n / 1000.0);
+    }
+  }
+}
 
-  switch (hi) {
-    case TelephonyUsagePage:   return "TelephonyUsagePage";
-    case ConsumerUsagePage:    return "ConsumerUsagePage";
-    case LEDUsagePage:         return "LEDUsagePage";
-    case ButtonUsagePage:      return "ButtonUsagePage";
-    default:                   return "not translated";
+static void listDevices(void) {
+  for (int i = 0; i < MAX_DEVICES; i++) {
+    struct jabra_device *dev = registryGet(&devices, i);
+    if (dev != NULL) {
+      __u32 state = callState(dev);
+      fprintf(stdout, "%c[%d] %s \"%s\" hook=%d mute=%d ringer=%d\n",
+        i == selected ? '*' : ' ', i, dev->path, dev->name,
+        callFlag(state, CALL_HOOK), callFlag(state, CALL_MUTE), callFlag(state, CALL_RING));
+    }
   }
 }
 
-#if (HIDDEBUG == 1)
-static void showReports(int fd, __u16 report_type) {
-  struct hiddev_report_info rinfo;
-  struct hiddev_field_info finfo;
-  struct hiddev_usage_ref uref;
-  int ret;
-
-  rinfo.report_type = report_type;
-  rinfo.report_id = HID_REPORT_ID_FIRST;
-  ret = ioctl(fd, HIDIOCGREPORTINFO, &rinfo);
-
-  while (ret >= 0) {
-    printf("HIDIOCGREPORTINFO: report_id=0x%X (%u fields)\n", rinfo.report_id, rinfo.num_fields);
-    for (int i = 0; i < rinfo.num_fields; i++) {
-      finfo.report_type = rinfo.report_type;
-      finfo.report_id   = rinfo.report_id;
-      finfo.field_index = i;
-      ioctl(fd, HIDIOCGFIELDINFO, &finfo);
-
-      fprintf(stdout, "HIDIOCGFIELDINFO: field_index=%u maxusage=%u flags=0x%X\n"
-          "\tphysical=0x%X logical=0x%X application=0x%X reportid=0x%X\n"
-          "\tlogical_minimum=%d,maximum=%d physical_minimum=%d,maximum=%d\n",
-        finfo.field_index,
-        finfo.maxusage,
-        finfo.flags,
-        finfo.physical,
-        finfo.logical,
-        finfo.application,
-        finfo.report_id,
-        finfo.logical_minimum,
-        finfo.logical_maximum,
-        finfo.physical_minimum,
-        finfo.physical_maximum);
-
-      for (int j = 0; j < finfo.maxusage; j++) {
-        uref.report_type = finfo.report_type;
-        uref.report_id   = finfo.report_id;
-        uref.field_index = i;
-        uref.usage_index = j;
-        ioctl(fd, HIDIOCGUCODE, &uref);
-        ioctl(fd, HIDIOCGUSAGE, &uref);
-
-        fprintf(stdout, " >> usage_index=%u usage_code=0x%X (%s) value=%d\n",
-          uref.usage_index,
-          uref.usage_code,
-          usagePageName(uref.usage_code),
-          uref.value);
+static void printDeviceLatency(struct jabra_device *dev) {
+  char prefix[16];
 
-      }
+  snprintf(prefix, sizeof(prefix), "[%d] ", dev->index);
+  (void)pthread_mutex_lock(&dev->lock);
+  for (int s = 0; s < LAT_STAGES; s++) {
+    histPrint(prefix, latencyStageName(s), &dev->latency.stage[s]);
+  }
+  (void)pthread_mutex_unlock(&dev->lock);
+}
+
+/* latency histograms of every device, 's' or SIGUSR1 */
+static void printLatency(void) {
+  for (int i = 0; i < MAX_DEVICES; i++) {
+    struct jabra_device *dev = registryGet(&devices, i);
+    if (dev != NULL) {
+      printDeviceLatency(dev);
     }
-    fprintf(stdout, "\n");
+  }
+}
+
+/* output and system call statistics of every device, 'i' */
+static void printAllStats(void) {
+  for (int i = 0; i < MAX_DEVICES; i++) {
+    struct jabra_device *dev = registryGet(&devices, i);
+    if (dev != NULL) {
+      (void)pthread_mutex_lock(&dev->lock);
+      printStats(dev);
+      (void)pthread_mutex_unlock(&dev->lock);
+    }
+  }
+}
+
+static int isVirtual(const struct jabra_device *dev) {
+  return dev->ops == &replay_transport || dev->ops == &sim_transport;
+}
+
+/* replayed and simulated devices add up to one result for the run */
+static void addTotals(struct jabra_device *dev) {
+  (void)pthread_mutex_lock(&dev->lock);
+  for (int s = 0; s < LAT_STAGES; s++) {
+    histAdd(&totals.stage[s], &dev->latency.stage[s]);
+  }
+  total_events += dev->istats.events;
+  (void)pthread_mutex_unlock(&dev->lock);
+}
+
+/* -w: every device attached is captured to a trace of its own */
+static void startCapture(struct jabra_device *dev) {
+  struct trace_writer *tw;
+  char path[256];
 
-    rinfo.report_id |= HID_REPORT_ID_NEXT;
-    ret = ioctl(fd, HIDIOCGREPORTINFO, &rinfo);
+  if (capture_path == NULL || (tw = malloc(sizeof(*tw))) == NULL) {
+    return;
+  }
+  snprintf(path, sizeof(path), "%s.%d", capture_path, captures++);
+  if (traceCreate(tw, path, dev) < 0) {
+    free(tw);
+    return;
   }
+  fprintf(stdout, "[%d] Capturing to %s\n", dev->index, path);
+  recorders[dev->index] = tw;
 }
+
+static void stopCapture(struct jabra_device *dev) {
+  struct trace_writer *tw = recorders[dev->index];
+
+  if (tw == NULL) {
+    return;
+  }
+  recorders[dev->index] = NULL;
+  if (traceFinish(tw) < 0) {
+    fprintf(stderr, "[%d] Capture incomplete, write failed\n", dev->index);
+  } else {
+    fprintf(stdout, "[%d] Captured %lu events\n", dev->index, tw->events);
+  }
+  free(tw);
+}
+
+_Static_assert(MAX_DEVICES <= CTL_DEVICE_SELECTED, "registry index must fit ctl_msg.device");
+
+/* control socket subscribers and the shared memory observers */
+static void notifyClients(__u8 type, const struct jabra_device *dev, __s32 value) {
+  struct ctl_msg msg;
+
+  msg.type   = type;
+  msg.device = dev->index;
+  msg.seq    = 0;
+  msg.value  = value;
+  controlNotify(&control, &msg);
+  shmPublish(&statepage, &msg, dev);
+}
+
+/* handler thread, for a key press or control request: one call control
+ * event, or only if flag is not yet set to want when want is 0 or 1 */
+static void callKey(struct jabra_device *dev, int event, __u32 flag, int want) {
+  struct output_txn txn;
+  int message = CALL_MSG_NONE;
+  __u32 before;
+
+  (void)pthread_mutex_lock(&dev->lock);
+  before = callState(dev);
+  if (want < 0 || callFlag(before, flag) != want) {
+    txnBegin(&txn, dev);
+    message = callStep(dev, &txn, event);
+    txnCommit(&txn);
+  }
+  if (message != CALL_MSG_NONE)
+    LOG(LOG_INFO, "[%d] %s\n", dev->index, callMessage(message));
+  (void)pthread_mutex_unlock(&dev->lock);
+
+  if ((callState(dev) ^ before) & CALL_FLAGS) {
+    notifyClients(CTL_STATE, dev, callState(dev) & CALL_FLAGS);
+  }
+}
+
+static void device_event(int fd, __u32 mask, void *arg);
+
+static int attachDevice(struct jabra_device *dev) {
+  __u32 state;
+
+  if (registryAdd(&devices, dev) < 0) {
+    fprintf(stderr, "%s: too many devices\n", dev->path);
+    deviceClose(dev);
+    return -1;
+  }
+  fprintf(stdout, "[%d] Using device %s\n", dev->index, dev->path);
+  fprintf(stdout, "[%d] HID device name: \"%s\"\n", dev->index, dev->name);
+#if (HIDDEBUG == 1)
+  if (dev->ops == &hiddev_transport) {
+    fprintf(stdout, "\n*** INPUT:\n"); showReports(dev, HID_REPORT_TYPE_INPUT);
+    fprintf(stdout, "\n*** OUTPUT:\n"); showReports(dev, HID_REPORT_TYPE_OUTPUT);
+    fprintf(stdout, "\n*** FEATURE:\n"); showReports(dev, HID_REPORT_TYPE_FEATURE);
+  }
 #endif
+  state = callState(dev);
+  fprintf(stdout, "[%d] mutestate=%i hookstate=%i ringerstate=%i\n",
+    dev->index, callFlag(state, CALL_MUTE), callFlag(state, CALL_HOOK), callFlag(state, CALL_RING));
 
-static int doListDev(char *path) {
-  int fd;
-  struct hiddev_devinfo devinfo;
-  char name[128];
-  int version;
+  if (reactorAdd(&reactor, dev->fd, device_event, dev) < 0) {
+    registryRemove(&devices, dev);
+    deviceClose(dev);
+    return -1;
+  }
+  if (registryGet(&devices, selected) == NULL) {
+    selected = dev->index;
+  }
+  startCapture(dev);
+  notifyClients(CTL_ATTACH, dev, 0);
+  return 0;
+}
 
-  if ((fd = open(path, O_RDONLY)) != -1) {
-    if (ioctl(fd, HIDIOCGDEVINFO, &devinfo) == -1) {
-      perror("ioctl HIDIOCGDEVINFO");
-      return -1;
+/* the handler thread closes the device once it has seen the last of
+ * its events */
+static void detachDevice(struct jabra_device *dev) {
+  fprintf(stdout, "[%d] Device %s removed\n", dev->index, dev->path);
+  reactorRemove(&reactor, dev->fd);
+  stopCapture(dev);
+  notifyClients(CTL_DETACH, dev, 0);
+  registryRemove(&devices, dev);
+  ringPushControl(&events, dev, RING_DETACH);
+
+  if (devices.count == 0) {
+    if (hotplug.fd < 0) {
+      fprintf(stderr, "No Jabra device left\n");
+      reactorStop(&reactor);
+    } else {
+      fprintf(stdout, "Waiting for a Jabra device\n");
     }
-    if (ioctl(fd, HIDIOCGNAME(sizeof(name)), name) == -1) {
-      perror("ioctl HIDIOCGNAME");
-      return -1;
+  }
+}
+
+/* device nodes found by scanDevices(), opened together */
+struct candidates {
+  int count;
+  char path[MAX_DEVICES][64];
+};
+
+static void enum_device(const char *devnode, __u16 vendor, __u16 product, void *arg) {
+  struct candidates *c = arg;
+
+  /* a longer path would not fit jabra_device.path either */
+  if (c->count < MAX_DEVICES && strlen(devnode) < sizeof(c->path[0]) &&
+      registryFind(&devices, devnode) == NULL) {
+    snprintf(c->path[c->count++], sizeof(c->path[0]), "%.*s",
+      (int) sizeof(c->path[0]) - 1, devnode);
+  }
+}
+
+static void scanDevices(void) {
+  static struct candidates c;
+  const char *paths[MAX_DEVICES];
+  struct jabra_device *dev[MAX_DEVICES];
+  const char *base = strrchr(transport->node_prefix, '/') + 1;
+  char dirname[64];
+  char path[64 + 256];
+  struct dirent *de;
+  DIR *dir;
+
+  c.count = 0;
+  if (enumerateDevices(SYSFS_ROOT, transport->subsystem, transport->node_prefix,
+                       JABRA_VID, enum_device, &c) < 0) {
+    /* no sysfs, let deviceOpen() check the vendor of every node */
+    snprintf(dirname, sizeof(dirname), "%.*s",
+      (int) (base - transport->node_prefix - 1), transport->node_prefix);
+    dir = opendir(dirname);
+    if (dir == NULL) {
+      if (errno != ENOENT)
+        perror(dirname);
+      return;
     }
-    if (ioctl(fd, HIDIOCGVERSION, &version) == -1) {
-      perror("ioctl HIDIOCGVERSION");
-      return -1;
+    while ((de = readdir(dir)) != NULL) {
+      if (strncmp(de->d_name, base, strlen(base)) == 0) {
+        snprintf(path, sizeof(path), "%s/%s", dirname, de->d_name);
+        enum_device(path, 0, 0, &c);
+      }
     }
-    return (devinfo.vendor == JABRA_VID);
+    closedir(dir);
   }
 
-  if (errno == ENOENT) {
-    return 0;
+  for (int i = 0; i < c.count; i++) {
+    paths[i] = c.path[i];
+  }
+  deviceOpenAll(transport, paths, c.count, JABRA_VID, dev);
+  for (int i = 0; i < c.count; i++) {
+    if (dev[i] != NULL) {
+      (void)attachDevice(dev[i]);
+    }
   }
+  (void)capcacheSync(&capabilities);
+}
 
-  perror("ioctl HIDIOCGVERSION");
-  return -1;
+static void openAll(const struct transport_ops *ops, const char *const paths[], int n) {
+  struct jabra_device *dev[MAX_DEVICES];
+
+  deviceOpenAll(ops, paths, n, 0, dev);
+  for (int i = 0; i < n; i++) {
+    if (dev[i] != NULL) {
+      (void)attachDevice(dev[i]);
+    }
+  }
 }
 
-static void writeUsage(int fd, unsigned report_type, unsigned page, unsigned code, __s32 value) {
-  struct hiddev_report_info rinfo;
-  struct hiddev_field_info finfo;
-  struct hiddev_usage_ref uref;
+/* -r/-R and -s: traces and simulated headsets stand in for the nodes */
+static void openVirtual(void) {
+  static char sims[MAX_DEVICES][64];
+  const char *paths[MAX_DEVICES];
+  int n;
 
-  /* find the requested usage code */
-  uref.report_type = report_type;
-  uref.report_id   = HID_REPORT_ID_UNKNOWN;
-  uref.usage_code  = (page << 16) | code;
-  if (ioctl(fd, HIDIOCGUSAGE, &uref) < 0) {
-    perror("HIDIOCGUSAGE");
-    return;
+  /* the pace is taken from replaySetPaced() as each trace is opened */
+  for (int paced = 0; paced <= 1; paced++) {
+    n = 0;
+    for (int i = 0; i < n_replays; i++) {
+      if (replay_paced[i] == paced)
+        paths[n++] = replays[i];
+    }
+    replaySetPaced(paced);
+    openAll(&replay_transport, paths, n);
   }
-#if (HIDDEBUG == 1)
-  fprintf(stdout, " >> usage_index=%u usage_code=0x%X (%s) value=%d\n",
-    uref.usage_index,
-    uref.usage_code,
-    usagePageName(uref.usage_code),
-    uref.value);
-#endif
-  /* retrieve field info */
-  finfo.report_type = uref.report_type;
-  finfo.report_id   = uref.report_id;
-  finfo.field_index = uref.field_index;
-  if (ioctl(fd, HIDIOCGFIELDINFO, &finfo) < 0) {
-    perror("HIDIOCGFIELDINFO");
+  n = 0;
+  for (int i = 0; i < n_sim_specs; i++) {
+    for (int j = 0; j < sim_copies && n < MAX_DEVICES; j++, n++) {
+      snprintf(sims[n], sizeof(sims[n]), "sim%d:%s", n, sim_specs[i]);
+      paths[n] = sims[n];
+    }
+  }
+  openAll(&sim_transport, paths, n);
+}
+
+/* a single device plugged in while running */
+static void probeDevice(const char *path) {
+  const char *name = strrchr(path, '/');
+  struct jabra_device *dev;
+  __u16 vid, pid;
+
+  if (registryFind(&devices, path) != NULL) {
     return;
   }
-#if (HIDDEBUG == 1)
-  fprintf(stdout, "HIDIOCGFIELDINFO: field_index=%u maxusage=%u flags=0x%X\n"
-   "\tphysical=0x%X logical=0x%X application=0x%X reportid=0x%X\n"
-   "\tlogical_minimum=%d,maximum=%d physical_minimum=%d,maximum=%d\n",
-    finfo.field_index,
-    finfo.maxusage,
-    finfo.flags,
-    finfo.physical,
-    finfo.logical,
-    finfo.application,
-    finfo.report_id,
-    finfo.logical_minimum,
-    finfo.logical_maximum,
-    finfo.physical_minimum,
-    finfo.physical_maximum);
-#endif
-  if ((value < finfo.logical_minimum) || (value > finfo.logical_maximum)) {
-    fprintf(stdout, "%s: value %d outside of allowed range (%d-%d)\n",
-      usagePageName(uref.usage_code),
-      value,
-      finfo.logical_minimum,
-      finfo.logical_maximum);
+  if (deviceUsbIds(SYSFS_ROOT, transport->subsystem, name ? name + 1 : path, &vid, &pid) == 0 &&
+      vid != JABRA_VID) {
     return;
   }
+  if ((dev = deviceOpen(transport, path, JABRA_VID)) != NULL) {
+    (void)attachDevice(dev);
+    (void)capcacheSync(&capabilities);
+  }
+}
 
-  /* set value */
-  uref.value = value;
-  if (ioctl(fd, HIDIOCSUSAGE, &uref) < 0) {
-    perror("HIDIOCSUSAGE");
-    return;
+/* a device whose node is gone, or now belongs to another device */
+static int nodeGone(struct jabra_device *dev) {
+  struct stat node, opened;
+
+  return stat(dev->path, &node) < 0 || fstat(dev->fd, &opened) < 0 ||
+         node.st_rdev != opened.st_rdev;
+}
+
+/* uevents were lost: drop the devices unplugged meanwhile and open
+ * those plugged in */
+static void resyncDevices(void) {
+  for (int i = 0; i < MAX_DEVICES; i++) {
+    struct jabra_device *dev = registryGet(&devices, i);
+    if (dev != NULL && !isVirtual(dev) && nodeGone(dev)) {
+      detachDevice(dev);
+    }
   }
+  scanDevices();
+}
+
+static void hotplug_device(int action, const char *devnode, void *arg) {
+  struct jabra_device *dev;
 
-  rinfo.report_type = uref.report_type;
-  rinfo.report_id   = uref.report_id;
-  if (ioctl(fd, HIDIOCSREPORT, &rinfo) < 0) {
-    perror("HIDIOCSREPORT");
+  if (action == HOTPLUG_ADD) {
+    probeDevice(devnode);
+  } else if (action == HOTPLUG_RESCAN) {
+    resyncDevices();
+  } else if ((dev = registryFind(&devices, devnode)) != NULL) {
+    detachDevice(dev);
   }
 }
 
-static void readUsage(int fd, unsigned report_type, unsigned page, unsigned code, __s32* value) {
-  struct hiddev_report_info rinfo;
-  struct hiddev_field_info finfo;
-  struct hiddev_usage_ref uref;
+static void hotplug_event(int fd, __u32 events, void *arg) {
+  hotplugDispatch(arg);
+}
+
+/* event loop thread: only read and queue */
+static void device_event(int fd, __u32 mask, void *arg) {
+  struct jabra_device *dev = arg;
+  struct hiddev_event ev[64];
+  int n = deviceReadEvents(dev, ev, sizeof(ev) / sizeof(ev[0]));
+  __u64 read_ns = latencyNow();
 
-  /* find the requested usage code */
-  uref.report_type = report_type;
-  uref.report_id   = HID_REPORT_ID_UNKNOWN;
-  uref.usage_code  = (page << 16) | code;
-  if (ioctl(fd, HIDIOCGUSAGE, &uref) < 0) {
-    perror("HIDIOCGUSAGE");
+  if (n < 0) {
+    detachDevice(dev);
     return;
   }
-#if (HIDDEBUG == 1)
-  fprintf(stdout, " >> usage_index=%u usage_code=0x%X (%s) value=%d\n",
-    uref.usage_index,
-    uref.usage_code,
-    usagePageName(uref.usage_code),
-    uref.value);
-#endif
-  /* retrieve field info */
-  finfo.report_type = uref.report_type;
-  finfo.report_id   = uref.report_id;
-  finfo.field_index = uref.field_index;
-  if (ioctl(fd, HIDIOCGFIELDINFO, &finfo) < 0) {
-    perror("HIDIOCGFIELDINFO");
-    return;
+  if (recorders[dev->index] != NULL) {
+    traceAppend(recorders[dev->index], read_ns, ev, n);
   }
-#if (HIDDEBUG == 1)
-  fprintf(stdout, "HIDIOCGFIELDINFO: field_index=%u maxusage=%u flags=0x%X\n"
-   "\tphysical=0x%X logical=0x%X application=0x%X reportid=0x%X\n"
-   "\tlogical_minimum=%d,maximum=%d physical_minimum=%d,maximum=%d\n",
-    finfo.field_index,
-    finfo.maxusage,
-    finfo.flags,
-    finfo.physical,
-    finfo.logical,
-    finfo.application,
-    finfo.report_id,
-    finfo.logical_minimum,
-    finfo.logical_maximum,
-    finfo.physical_minimum,
-    finfo.physical_maximum);
-#endif
-#if 0
-  if ((value < finfo.logical_minimum) || (value > finfo.logical_maximum)) {
-    fprintf(stdout, "%s: value %d outside of allowed range (%d-%d)\n",
-      usagePageName(uref.usage_code),
-      value,
-      finfo.logical_minimum,
-      finfo.logical_maximum);
-    return;
+  /* a trace can wait for the handler, so the benchmark loses nothing */
+  if (dev->ops == &replay_transport) {
+    ringReserve(&events, n);
   }
-#endif
-  /* get value */
-  //  uref.value = value;
-  if (ioctl(fd, HIDIOCGUSAGE, &uref) < 0) {
-    perror("HIDIOCGUSAGE");
-    return;
+  for (int i = 0; i < n; i++) {
+    (void)ringPush(&events, dev, RING_EVENT, &ev[i], reactor.wake_ns, read_ns);
   }
-  *value = uref.value;
+  ringWake(&events);
+}
+
+/* handler thread: call control for a run of events from one device */
+static void dispatchEvents(struct jabra_device *dev, const struct ring_record *rec, int n) {
+  struct latency *lat = &dev->latency;
+  int i, event, message;
+  struct output_txn txn;
+  __u8 call[64];
+  __s8 volume[64];       /* steps to notify once the lock is released */
+  int n_volume = 0;
+  __u64 dispatch_ns, sent_ns;
+  __u32 before;
+  int acked;
 
-  rinfo.report_type = uref.report_type;
-  rinfo.report_id   = uref.report_id;
-  if (ioctl(fd, HIDIOCSREPORT, &rinfo) < 0) {
-    perror("HIDIOCSREPORT");
+  if (n == 0) {
+    return;
   }
-}
+  dispatch_ns = latencyNow();
 
-static void* event_loop(void *ptr) {
-  int i;
-  int debug = 0;
-  struct timeval tv;
-  fd_set fdset;
-  FD_ZERO(&fdset);
-
-  while (run == 1) {
-    struct hiddev_event ev[64];
-    FD_SET(fd, &fdset);
-    tv.tv_sec = 1;
-    tv.tv_usec = 0;
-    int rd = select(fd + 1, &fdset, NULL, NULL, &tv);
-
-    if (rd > 0) {
-      rd = read(fd, ev, sizeof(ev));
-      if (rd < (int) sizeof(ev[0])) {
-        if (rd < 0)
-          perror("error reading");
-        else
-          fprintf(stderr, "got too short read from device\n");
-        run = 0;
-        return (void*) -1;
-      }
+  /* the whole batch is applied under one lock and its output writes go
+   * out as one transaction */
+  (void)pthread_mutex_lock(&dev->lock);
+  before = callState(dev);
+  dev->istats.batches++;
+  dev->istats.events += n;
+  if (n > dev->istats.max_batch)
+    dev->istats.max_batch = n;
+  txnBegin(&txn, dev);
+
+  for (i = 0; i < n; i++) {
+    LOG(LOG_DEBUG, "[%d] Event: %x = %d\n", dev->index, rec[i].ev.hid, rec[i].ev.value);
+
+    event = callEvent(rec[i].ev.hid, rec[i].ev.value);
+    call[i] = (event >= 0);
+    if (event >= 0) {
+      message = callStep(dev, &txn, event);
+      if (message != CALL_MSG_NONE)
+        LOG(LOG_INFO, "[%d] %s\n", dev->index, callMessage(message));
+      continue;
+    }
 
-      for (i = 0; i < rd / sizeof(ev[0]); i++) {
-        if (debug)
-          fprintf(stdout, "Event: %x = %d\n", ev[i].hid, ev[i].value);
-
-        (void)pthread_mutex_lock(&lock);
-
-        switch (ev[i].hid >> 16) {
-          case TelephonyUsagePage:
-            //fprintf(stdout, "Event: %x = %d\n", ev[i].hid, ev[i].value);
-            switch (ev[i].hid & 0xFFFF) {
-              case Tel_Hook_Switch:
-                if (hookstate != ev[i].value) {
-                  if (hookstate == 0) {
-                    writeUsage(fd, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Ring, 0);
-                    writeUsage(fd, HID_REPORT_TYPE_OUTPUT, TelephonyUsagePage, Tel_Ringer, 0);
-                  }
-                  writeUsage(fd, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Off_Hook, ev[i].value);
-                  hookstate = ev[i].value;
-                  hookstate == 0 ? fprintf(stdout, "--> Hook in place\n") : fprintf(stdout, "--> Hook lifted\n");
-                }
-                break;
-              case Tel_Phone_Mute:
-                //fprintf(stdout, "Event: %x = %d\n", ev[i].hid, ev[i].value);
-                if (ev[i].value == 1) {
-                  mutestate = !mutestate;
-                  writeUsage(fd, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Mute, mutestate);
-                  mutestate == 0 ? fprintf(stdout, "--> Unmuted\n") : fprintf(stdout, "--> Muted\n");
-                }
-                break;
-              default:
-                break;
-            }
+    switch (rec[i].ev.hid >> 16) {
+      case ConsumerUsagePage:
+        //fprintf(stdout, "Event: %x = %d\n", rec[i].ev.hid, rec[i].ev.value);
+        switch (rec[i].ev.hid & 0xFFFF) {
+          case Con_Volume_Decr:
+            if (rec[i].ev.value) LOG(LOG_INFO, "[%d] Volume decrement = 0x%x\n", dev->index, rec[i].ev.value);
+            if (rec[i].ev.value) volume[n_volume++] = -1;
             break;
-          case ConsumerUsagePage:
-            //fprintf(stdout, "Event: %x = %d\n", ev[i].hid, ev[i].value);
-            switch (ev[i].hid & 0xFFFF) {
-              case Con_Volume_Decr:
-                if (ev[i].value) fprintf(stdout, "Volume decrement = 0x%x\n", ev[i].value);
-                break;
-              case Con_Volume_Incr:
-                if (ev[i].value) fprintf(stdout, "Volume increment = 0x%x\n", ev[i].value);
-                break;
-              default:
-                break;
-            }
+          case Con_Volume_Incr:
+            if (rec[i].ev.value) LOG(LOG_INFO, "[%d] Volume increment = 0x%x\n", dev->index, rec[i].ev.value);
+            if (rec[i].ev.value) volume[n_volume++] = 1;
             break;
           default:
             break;
         }
-        (void)pthread_mutex_unlock(&lock);
+        break;
+      default:
+        break;
+    }
+  }
+  acked = (txn.count > 0);
+  txnCommit(&txn);
+  sent_ns = latencyNow();
+
+  for (i = 0; i < n; i++) {
+    histRecord(&lat->stage[LAT_WAKE_TO_READ], rec[i].read_ns - rec[i].wake_ns);
+    histRecord(&lat->stage[LAT_READ_TO_DISPATCH], dispatch_ns - rec[i].read_ns);
+    /* only call control events that led to a report being sent */
+    if (call[i] && acked) {
+      histRecord(&lat->stage[LAT_DISPATCH_TO_SENT], sent_ns - dispatch_ns);
+      histRecord(&lat->stage[LAT_END_TO_END], sent_ns - rec[i].wake_ns);
+    }
+  }
+  (void)pthread_mutex_unlock(&dev->lock);
+
+  /* notifications are system calls, they are kept out of the lock */
+  for (i = 0; i < n_volume; i++) {
+    notifyClients(CTL_VOLUME, dev, volume[i]);
+  }
+  /* the batch as a whole, clients see the state it ended in */
+  if ((callState(dev) ^ before) & CALL_FLAGS) {
+    notifyClients(CTL_STATE, dev, callState(dev) & CALL_FLAGS);
+  }
+}
+
+/* handler thread: a command queued by the event loop. A device the
+ * command is for is still open, its RING_DETACH comes after it */
+static void runCommand(const struct ring_record *rec) {
+  struct jabra_device *dev = rec->dev;
+  int code = rec->ev.hid;
+
+  struct ctl_msg reply;
+
+  switch (code) {
+    case CMD_HOOK:
+    case CMD_MUTE:
+    case CMD_RING:
+      callKey(dev, call_commands[code].event, call_commands[code].flag, rec->ev.value);
+      if (rec->tag != 0) {
+        reply.type   = CTL_REPLY;
+        reply.device = dev->index;
+        reply.seq    = rec->tag & 0xFFFF;
+        reply.value  = 0;
+        controlReply(&control, rec->tag >> 16, &reply);
+      }
+      break;
+    case CMD_STATS:
+      printAllStats();
+      break;
+    case CMD_LATENCY:
+      printLatency();
+      break;
+    default:
+      break;
+  }
+}
+
+/* event loop thread: leave the work to the handler thread */
+static void queueCommand(struct jabra_device *dev, int code, int arg) {
+  if (ringPushCommand(&events, dev, code, arg, 0) < 0) {
+    fprintf(stderr, "Busy, command dropped\n");
+  }
+}
+
+static void* event_loop(void *ptr) {
+  reactorRun(&reactor);
+  return (void*)0;
+}
+
+static void* handler_loop(void *ptr) {
+  struct ring_record rec[64];
+  int n, i, j;
+
+  for (;;) {
+    n = ringPop(&events, rec, sizeof(rec) / sizeof(rec[0]));
+    if (n == 0) {
+      ringWait(&events);
+      continue;
+    }
+    for (i = 0; i < n; i = j) {
+      struct jabra_device *dev = rec[i].dev;
+
+      switch (rec[i].kind) {
+        case RING_EVENT:
+          for (j = i; j < n && rec[j].kind == RING_EVENT && rec[j].dev == dev; j++);
+          dispatchEvents(dev, &rec[i], j - i);
+          break;
+        case RING_DETACH:
+          printStats(dev);
+          if (dev->ops == &replay_transport)
+            printDeviceLatency(dev);
+          if (isVirtual(dev))
+            addTotals(dev);
+          deviceClose(dev);
+          j = i + 1;
+          break;
+        case RING_COMMAND:
+          runCommand(&rec[i]);
+          j = i + 1;
+          break;
+        default:
+          return (void*)0;
       }
     }
+  }
+}
+
+/* digits add to the device number being typed, Enter selects it */
+static void selectDigit(char key) {
+  if (key >= '0' && key <= '9') {
+    if (typed < 0) {
+      typed = 0;
+    }
+    /* past any device number, stop growing so it cannot overflow */
+    if (typed < MAX_DEVICES) {
+      typed = typed * 10 + (key - '0');
+    }
+    fputc(key, stdout);
     fflush(stdout);
+    return;
   }
-  return (void*)0;
+
+  if (key == '\n' || key == '\r') {
+    fputc('\n', stdout);
+    if (registryGet(&devices, typed) != NULL) {
+      selected = typed;
+      fprintf(stdout, "Selected device %d\n", selected);
+    } else if (typed < MAX_DEVICES) {
+      fprintf(stdout, "No device %d\n", typed);
+    } else {
+      fprintf(stdout, "Devices are numbered 0 to %d\n", MAX_DEVICES - 1);
+    }
+  } else {
+    /* another command drops the number */
+    fputc('\n', stdout);
+  }
+  typed = -1;
 }
 
 static void hit_key(char key) {
+  struct jabra_device *dev;
+
+  if ((key >= '0' && key <= '9') || typed >= 0) {
+    selectDigit(key);
+    if ((key >= '0' && key <= '9') || key == '\n' || key == '\r') {
+      return;
+    }
+  }
+
+  dev = registryGet(&devices, selected);
+  if (dev == NULL && (key == 'o' || key == 'm' || key == 'r')) {
+    fprintf(stdout, "No device selected\n");
+    return;
+  }
 
   switch (key) {
     case 'o':
-      (void)pthread_mutex_lock(&lock);
-      hookstate = !hookstate;
-      if (hookstate == 1) {
-        writeUsage(fd, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Ring, 0);
-        writeUsage(fd, HID_REPORT_TYPE_OUTPUT, TelephonyUsagePage, Tel_Ringer, 0);
-      }
-      writeUsage(fd, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Off_Hook, hookstate);
-      hookstate == 0 ? fprintf(stdout, "<-- Put back Hook\n") : fprintf(stdout, "<-- Lift Hook\n");
-      (void)pthread_mutex_unlock(&lock);
+      queueCommand(dev, CMD_HOOK, -1);
       break;
     case 'm':
-      (void)pthread_mutex_lock(&lock);
-      mutestate = !mutestate;
-      writeUsage(fd, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Mute, mutestate);
-      mutestate == 0 ? fprintf(stdout, "<-- Unmute\n") : fprintf(stdout, "<-- Mute\n");
-      (void)pthread_mutex_unlock(&lock);
+      queueCommand(dev, CMD_MUTE, -1);
       break;
     case 'r':
-      (void)pthread_mutex_lock(&lock);
-      ringerstate = !ringerstate;
-      writeUsage(fd, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Ring, ringerstate);
-      writeUsage(fd, HID_REPORT_TYPE_OUTPUT, TelephonyUsagePage, Tel_Ringer, ringerstate);
-      (void)pthread_mutex_unlock(&lock);
+      queueCommand(dev, CMD_RING, -1);
+      break;
+    case 'l':
+      listDevices();
+      break;
+    case 's':
+      queueCommand(NULL, CMD_LATENCY, 0);
+      break;
+    case 'i':
+      queueCommand(NULL, CMD_STATS, 0);
       break;
     case 'q':
-      run = 0;
+      reactorStop(&reactor);
       break;
     case '?':
       fprintf(stdout, "Usage:\n");
       fprintf(stdout, " o = offhook tooggle\n");
       fprintf(stdout, " m = mute tooggle\n");
       fprintf(stdout, " r = ringer tooggle\n");
+      fprintf(stdout, " l = list devices\n");
+      fprintf(stdout, " s = latency statistics\n");
+      fprintf(stdout, " i = output and system call statistics\n");
+      fprintf(stdout, " <n> Enter = select device n of the list\n");
       fprintf(stdout, " q = quit\n");
       fprintf(stdout, " ? = this help\n");
       break;
@@ -499,86 +803,286 @@ static void hit_key(char key) {
   }
 }
 
+/* control socket requests, on the event loop thread like the keys. The
+ * hook, mute and ringer are set on the handler thread, which replies */
+static int control_request(const struct ctl_msg *req, struct ctl_msg *reply,
+                           __u32 client, void *arg) {
+  struct jabra_device *dev;
+  int code;
+
+  dev = registryGet(&devices, req->device == CTL_DEVICE_SELECTED ? selected : req->device);
+  if (dev == NULL) {
+    reply->value = -ENODEV;
+    return 0;
+  }
+  reply->device = dev->index;
+  switch (req->type) {
+    case CTL_HOOK:
+      code = CMD_HOOK;
+      break;
+    case CTL_MUTE:
+      code = CMD_MUTE;
+      break;
+    case CTL_RING:
+      code = CMD_RING;
+      break;
+    case CTL_GET_STATE:
+      reply->type  = CTL_STATE;
+      reply->value = callState(dev) & CALL_FLAGS;
+      return 0;
+    default:
+      reply->value = -EINVAL;
+      return 0;
+  }
+  if (ringPushCommand(&events, dev, code, req->value != 0, REPLY_TAG(client, req->seq)) < 0) {
+    reply->value = -EBUSY;
+    return 0;
+  }
+  return CTL_PENDING;
+}
+
+static void stats_signal(int fd, __u32 events, void *arg) {
+  struct signalfd_siginfo si;
+
+  if (read(fd, &si, sizeof(si)) == sizeof(si)) {
+    queueCommand(NULL, CMD_LATENCY, 0);
+  }
+}
+
+static void stdin_event(int fd, __u32 events, void *arg) {
+  char buf[32];
+  int rd = read(fd, buf, sizeof(buf));
+
+  if (rd <= 0) {
+    /* stdin closed, keep serving the device */
+    reactorRemove(&reactor, fd);
+    return;
+  }
+  for (int i = 0; i < rd; i++) {
+    hit_key(buf[i]);
+  }
+}
+
+/* deliver key presses one at a time and without echo, Ctrl-C still works */
+static void setRawTerminal(int fd) {
+  struct termios tio;
+
+  if (!isatty(fd) || tcgetattr(fd, &saved_tio) < 0) {
+    return;
+  }
+  tio_saved = 1;
+  tio = saved_tio;
+  tio.c_lflag &= ~(ICANON | ECHO);
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+  (void)tcsetattr(fd, TCSANOW, &tio);
+}
+
+static void restoreTerminal(int fd) {
+  if (tio_saved) {
+    (void)tcsetattr(fd, TCSANOW, &saved_tio);
+    tio_saved = 0;
+  }
+}
+
 /****************************************************************************/
 /*                           EXPORTED FUNCTIONS                             */
 /****************************************************************************/
 int main(int argc, char**argv) {
-  int i;
-  char name[128];
   int retval = 0;
   pthread_t event_thread;
+  pthread_t handler_thread;
+  sigset_t mask;
+  char path[256];
+  int statsfd;
+  int level = LOG_INFO;
+  struct log_stats lstats;
+  __u64 run_ns;
+  int opt;
 
-  for (i = 0; i < 19; i++) {
-    sprintf(name, "/dev/usb/hiddev%d", i);
-    if (doListDev(name) == 1) {
-      break;
+  while ((opt = getopt(argc, argv, "t:vw:r:R:s:n:d:m:")) != -1) {
+    switch (opt) {
+      case 't':
+        if ((transport = transportByName(optarg)) != NULL) {
+          break;
+        }
+        /* fall through */
+      default:
+        fprintf(stderr, "usage: %s [-t hiddev|hidraw] [-v] [-d socket] [-m statepage] [-w capture] [-r|-R trace]..."
+          " [-n count] [-s layout[,option...]]...\n", argv[0]);
+        return -1;
+      case 'v':
+        level = LOG_DEBUG;
+        break;
+      case 'w':
+        capture_path = optarg;
+        break;
+      case 'd':
+        control_path = optarg;
+        break;
+      case 'm':
+        statepage_path = optarg;
+        break;
+      case 'r':
+      case 'R':
+        if (n_replays < MAX_DEVICES) {
+          replay_paced[n_replays] = (opt == 'R');
+          replays[n_replays++] = optarg;
+        }
+        break;
+      case 's':
+        if (n_sim_specs < MAX_DEVICES)
+          sim_specs[n_sim_specs++] = optarg;
+        break;
+      case 'n':
+        if ((sim_copies = atoi(optarg)) < 1)
+          sim_copies = 1;
+        break;
     }
   }
 
-  if (i == 19) {
-    fprintf(stderr, "No Jabra device found\n");
+  /* what is not logged asynchronously still shows up line by line */
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  /* SIGINT/SIGTERM are delivered through the reactor's signalfd */
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  sigaddset(&mask, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+  registryInit(&devices);
+  if (logInit(level) < 0) {
     return -1;
   }
-
-  sprintf(name, "/dev/usb/hiddev%d", i);
-  fprintf(stdout, "Using device %s\n", name);
-
-  if ((fd = open(name, O_RDONLY)) < 0) {
-    if (errno == EACCES) {
-      fprintf(stderr, "No permission, try this as root.\n");
-      return -1;
-    }
+  if (capcacheDefaultPath(path, sizeof(path)) < 0) {
+    fprintf(stderr, "No cache directory, device layouts are not cached\n");
+  }
+  capcacheOpen(&capabilities, path);
+  if (path[0] != '\0') {
+    deviceUseCapCache(&capabilities);
+  }
+  if (ringInit(&events) < 0 || reactorInit(&reactor) < 0) {
+    reactorClose(&reactor);
+    ringClose(&events);
+    capcacheClose(&capabilities);
+    logClose();
+    return -1;
   }
 
-  ioctl(fd, HIDIOCINITREPORT, 0);
-  ioctl(fd, HIDIOCGNAME(sizeof(name)), name);
-  printf("HID device name: \"%s\"\n", name);
-#if (HIDDEBUG == 1)
-  fprintf(stdout, "\n*** INPUT:\n"); showReports(fd, HID_REPORT_TYPE_INPUT);
-  fprintf(stdout, "\n*** OUTPUT:\n"); showReports(fd, HID_REPORT_TYPE_OUTPUT);
-  fprintf(stdout, "\n*** FEATURE:\n"); showReports(fd, HID_REPORT_TYPE_FEATURE);
-#endif
+  /* SIGUSR1 dumps the latency histograms */
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGUSR1);
+  if ((statsfd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK)) < 0 ||
+      reactorAdd(&reactor, statsfd, stats_signal, NULL) < 0) {
+    perror("signalfd SIGUSR1");
+  }
 
-  /* set initial values */
-  mutestate = 0;
-  hookstate = 0;
-  ringerstate = 0;
-  printf("Reading\n");
-  readUsage(fd, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Mute, &mutestate);
-  printf("mutestate=%i\n", mutestate);
-  readUsage(fd, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Off_Hook, &hookstate);
-  printf("hookstate=%i\n", hookstate);
-  readUsage(fd, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Ring, &ringerstate);
-  printf("ringerstate=%i\n", ringerstate);
-#if 0
-  writeUsage(fd, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Mute, 0);
-  writeUsage(fd, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Ring, 0);
-  writeUsage(fd, HID_REPORT_TYPE_OUTPUT, TelephonyUsagePage, Tel_Ringer, 0);
-  writeUsage(fd, HID_REPORT_TYPE_OUTPUT, LEDUsagePage, Led_Off_Hook, 0);
-#endif
-  if (pthread_create(&event_thread, NULL, event_loop, &retval)) {
-    fprintf(stderr, "Error creating thread\n");
-    close(fd);
+  if ((control_path != NULL &&
+       controlOpen(&control, control_path, &reactor, control_request, NULL) < 0) ||
+      (statepage_path != NULL && shmOpen(&statepage, statepage_path) < 0)) {
+    controlClose(&control);
+    reactorClose(&reactor);
+    if (statsfd >= 0)
+      close(statsfd);
+    ringClose(&events);
+    capcacheClose(&capabilities);
+    logClose();
     return -1;
   }
 
-  hit_key('?');
+  if (n_replays > 0 || n_sim_specs > 0) {
+    openVirtual();
+  } else {
+    /* listen before scanning so that no device slips through */
+    if (hotplugOpen(&hotplug, transport->subsystem, transport->node_prefix,
+                    hotplug_device, NULL) == 0 &&
+        reactorAdd(&reactor, hotplug.fd, hotplug_event, &hotplug) < 0) {
+      hotplugClose(&hotplug);
+    }
+    scanDevices();
+  }
 
-  fcntl(0, F_SETFL, O_NONBLOCK);
+  if (devices.count == 0) {
+    if (hotplug.fd < 0) {
+      fprintf(stderr, "No Jabra device found\n");
+      controlClose(&control);
+      shmClose(&statepage);
+      reactorClose(&reactor);
+      if (statsfd >= 0)
+        close(statsfd);
+      ringClose(&events);
+      capcacheClose(&capabilities);
+      logClose();
+      return -1;
+    }
+    fprintf(stdout, "Waiting for a Jabra device\n");
+  }
+
+  if (control_path != NULL) {
+    fprintf(stdout, "Serving %s\n", control_path);
+  } else {
+    hit_key('?');
 
-  while(run == 1) {
-    char c;
-    if (read(0, &c, 1) == 1) {
-      hit_key(c);
+    setRawTerminal(0);
+    if (reactorAdd(&reactor, 0, stdin_event, NULL) < 0) {
+      fprintf(stderr, "stdin not watched, use Ctrl-C to quit\n");
     }
-    usleep(1000*100);
   }
 
-  if (pthread_join(event_thread, NULL)) {
-    fprintf(stderr, "Error joining thread\n");
+  run_ns = latencyNow();
+  if (pthread_create(&handler_thread, NULL, handler_loop, NULL)) {
+    fprintf(stderr, "Error creating thread\n");
     retval = -1;
+  } else {
+    if (pthread_create(&event_thread, NULL, event_loop, &retval)) {
+      fprintf(stderr, "Error creating thread\n");
+      retval = -1;
+    } else if (pthread_join(event_thread, NULL)) {
+      fprintf(stderr, "Error joining thread\n");
+      retval = -1;
+    }
+    ringPushControl(&events, NULL, RING_STOP);
+    if (pthread_join(handler_thread, NULL)) {
+      fprintf(stderr, "Error joining thread\n");
+      retval = -1;
+    }
   }
+  run_ns = latencyNow() - run_ns;
+  restoreTerminal(0);
+  logClose();
+  logGetStats(&lstats);
+  fprintf(stdout, "Log: records=%lu dropped=%lu\n", lstats.written, lstats.dropped);
+  fprintf(stdout, "Event ring: events=%lu dropped=%lu high water=%u of %u\n",
+    events.pushed, events.dropped, events.high_water, EVENT_RING_SIZE);
 
-  close(fd);
+  for (int i = 0; i < MAX_DEVICES; i++) {
+    struct jabra_device *dev = registryGet(&devices, i);
+    if (dev != NULL) {
+      stopCapture(dev);
+      printStats(dev);
+      if (isVirtual(dev))
+        addTotals(dev);
+      registryRemove(&devices, dev);
+      deviceClose(dev);
+    }
+  }
+  if (n_replays > 0 || n_sim_specs > 0) {
+    fprintf(stdout, "All devices: %lu events in %.3f s (%.0f events/s)\n",
+      total_events, run_ns / 1e9, run_ns ? total_events / (run_ns / 1e9) : 0.0);
+    for (int s = 0; s < LAT_STAGES; s++) {
+      histPrint("[all] ", latencyStageName(s), &totals.stage[s]);
+    }
+  }
+  if (control.fd >= 0) {
+    fprintf(stdout, "Control: notifications sent=%lu missed=%lu\n", control.notified, control.missed);
+    controlClose(&control);
+  }
+  shmClose(&statepage);
+  hotplugClose(&hotplug);
+  reactorClose(&reactor);
+  if (statsfd >= 0)
+    close(statsfd);
+  ringClose(&events);
+  capcacheClose(&capabilities);
   return retval;
 }
@@ -0,0 +1,340 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_hidraw.c
+ *
+ * @brief  hidraw transport. The report descriptor is parsed in user
+ *         space, output and feature reports are kept in local buffers
+ *         that usages are packed into and sent with one write() or
+ *         HIDIOCSFEATURE, and input reports are decoded into the same
+ *         struct hiddev_event the hiddev transport delivers by the
+ *         extractors compiled from the descriptor at open.
+ *
+ *         Unlike hiddev, only input values that changed since the
+ *         previous report are turned into events.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/hidraw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "jabra_device.h"
+#include "jabra_enum.h"
+#include "jabra_rdesc.h"
+#include "jabra_transport.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+struct hidraw_priv {
+  struct rdesc rd;
+  struct rdesc_decoder decoder;
+  struct rdesc_state input;             /* last decoded input values */
+  __u8 report[RDESC_MAX_REPORTS][RDESC_MAX_REPORT + 1];  /* id + data */
+  __u8 inbuf[RDESC_MAX_REPORT + 1 + RDESC_DECODE_PAD];
+};
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static const struct rdesc_field *findField(const struct rdesc *rd, __u32 report_type,
+                                           __u32 report_id, __u32 field_index) {
+  for (int i = 0; i < rd->n_fields; i++) {
+    const struct rdesc_field *f = &rd->field[i];
+    if (f->report_type == report_type && f->report_id == report_id &&
+        f->field_index == field_index) {
+      return f;
+    }
+  }
+  return NULL;
+}
+
+static __s32 fieldValue(const struct rdesc_field *f, const __u8 *data, int k) {
+  __u32 v = rdescExtract(data, f->bit_offset + k * f->bit_size, f->bit_size);
+
+  if (f->logical_minimum < 0 && f->bit_size < 32 && (v & (1u << (f->bit_size - 1)))) {
+    v |= ~0u << f->bit_size;
+  }
+  return (__s32) v;
+}
+
+static int hasTelephonyUsages(const struct rdesc *rd) {
+  for (int i = 0; i < rd->n_usages; i++) {
+    if ((rd->usage[i] >> 16) == TelephonyUsagePage) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* seed the output and feature buffers with what the device holds now */
+static void readReports(struct jabra_device *dev) {
+  struct hidraw_priv *p = dev->priv;
+
+  for (int i = 0; i < p->rd.n_reports; i++) {
+    const struct rdesc_report *r = &p->rd.report[i];
+    int len = rdescReportBytes(r) + 1;
+
+    p->report[i][0] = r->report_id;
+    if (r->report_type == HID_REPORT_TYPE_FEATURE) {
+      deviceIoctl(dev, DEVCALL_GFEATURE, HIDIOCGFEATURE(len), p->report[i]);
+    }
+#ifdef HIDIOCGOUTPUT
+    else if (r->report_type == HID_REPORT_TYPE_OUTPUT) {
+      deviceIoctl(dev, DEVCALL_GOUTPUT, HIDIOCGOUTPUT(len), p->report[i]);
+    }
+#endif
+    p->report[i][0] = r->report_id;
+  }
+}
+
+/* the descriptor from the driver, or from sysfs where the ioctl fails */
+static int readDescriptor(struct jabra_device *dev, struct hidraw_report_descriptor *desc) {
+  const char *name = strrchr(dev->path, '/');
+  int size;
+
+  if (deviceIoctl(dev, DEVCALL_GRDESC, HIDIOCGRDESCSIZE, &size) == 0) {
+    desc->size = size;
+    if (deviceIoctl(dev, DEVCALL_GRDESC, HIDIOCGRDESC, desc) == 0) {
+      return 0;
+    }
+  }
+  size = deviceReportDescriptor(SYSFS_ROOT, hidraw_transport.subsystem,
+                                name ? name + 1 : dev->path, desc->value, sizeof(desc->value));
+  if (size <= 0) {
+    perror("ioctl HIDIOCGRDESC");
+    return -1;
+  }
+  desc->size = size;
+  return 0;
+}
+
+static int hidrawOpen(struct jabra_device *dev) {
+  struct hidraw_report_descriptor desc;
+  struct hidraw_devinfo info;
+  struct hidraw_priv *p;
+
+  if ((dev->fd = open(dev->path, O_RDWR | O_CLOEXEC)) < 0) {
+    if (errno == EACCES) {
+      fprintf(stderr, "%s: No permission, try this as root.\n", dev->path);
+    } else {
+      perror(dev->path);
+    }
+    return -1;
+  }
+  if (deviceIoctl(dev, DEVCALL_GRAWINFO, HIDIOCGRAWINFO, &info) < 0) {
+    perror("ioctl HIDIOCGRAWINFO");
+    close(dev->fd);
+    return -1;
+  }
+  dev->devinfo.bustype = info.bustype;
+  dev->devinfo.vendor  = (__u16) info.vendor;
+  dev->devinfo.product = (__u16) info.product;
+  dev->devinfo.version = 0;
+  deviceIoctl(dev, DEVCALL_GRAWNAME, HIDIOCGRAWNAME(sizeof(dev->name)), dev->name);
+
+  if (readDescriptor(dev, &desc) < 0) {
+    close(dev->fd);
+    return -1;
+  }
+
+  p = calloc(1, sizeof(*p));
+  if (p == NULL) {
+    perror("calloc");
+    close(dev->fd);
+    return -1;
+  }
+  if (rdescParse(&p->rd, desc.value, desc.size) < 0) {
+    fprintf(stderr, "%s: unsupported report descriptor\n", dev->path);
+    free(p);
+    close(dev->fd);
+    return -1;
+  }
+  /* a headset exposes several interfaces, only one does call control */
+  if (!hasTelephonyUsages(&p->rd)) {
+#if (HIDDEBUG == 1)
+    fprintf(stderr, "%s: no telephony usages, skipped\n", dev->path);
+#endif
+    free(p);
+    close(dev->fd);
+    return -1;
+  }
+  rdescCompile(&p->rd, &p->decoder);
+  dev->priv = p;
+  readReports(dev);
+  return 0;
+}
+
+static void hidrawClose(struct jabra_device *dev) {
+  close(dev->fd);
+  free(dev->priv);
+  dev->priv = NULL;
+}
+
+static void hidrawBuildUsages(struct jabra_device *dev) {
+  /* the written usages first, should the cache run out */
+  static const __u32 report_types[] = {
+    HID_REPORT_TYPE_OUTPUT, HID_REPORT_TYPE_FEATURE, HID_REPORT_TYPE_INPUT
+  };
+  struct hidraw_priv *p = dev->priv;
+  struct hiddev_field_info finfo;
+
+  dev->usages.count = 0;
+  dev->usages.skipped = 0;
+  for (int t = 0; t < sizeof(report_types) / sizeof(report_types[0]); t++) {
+    for (int i = 0; i < p->rd.n_fields; i++) {
+      const struct rdesc_field *f = &p->rd.field[i];
+
+      if (f->report_type != report_types[t] || !usagesFit(&dev->usages, f->n_usages)) {
+        continue;
+      }
+      memset(&finfo, 0, sizeof(finfo));
+      finfo.report_type     = f->report_type;
+      finfo.report_id       = f->report_id;
+      finfo.field_index     = f->field_index;
+      finfo.maxusage        = f->n_usages;
+      finfo.flags           = f->flags;
+      finfo.logical_minimum = f->logical_minimum;
+      finfo.logical_maximum = f->logical_maximum;
+      for (int j = 0; j < f->n_usages; j++) {
+        (void)addUsage(&dev->usages, &finfo, j, p->rd.usage[f->first_usage + j]);
+      }
+    }
+  }
+}
+
+static int hidrawGetUsage(struct jabra_device *dev, const struct usage_entry *u, __s32 *value) {
+  struct hidraw_priv *p = dev->priv;
+  const struct rdesc_field *f;
+  int ri;
+
+  f = findField(&p->rd, u->report_type, u->report_id, u->field_index);
+  if (f == NULL || !(f->flags & RDESC_VARIABLE) || u->usage_index >= f->count) {
+    fprintf(stderr, "get usage 0x%X: not a variable field\n", u->usage_code);
+    return -1;
+  }
+  if (u->report_type == HID_REPORT_TYPE_INPUT) {
+    *value = p->input.value[f->first_value + u->usage_index];
+    return 0;
+  }
+  ri = rdescFindReport(&p->rd, u->report_type, u->report_id);
+  *value = fieldValue(f, p->report[ri] + 1, u->usage_index);
+  return 0;
+}
+
+static int hidrawSetUsages(struct jabra_device *dev, const struct usage_entry *u,
+                           const __s32 *values, int n) {
+  struct hidraw_priv *p = dev->priv;
+  const struct rdesc_field *f;
+  int ri;
+
+  f = findField(&p->rd, u->report_type, u->report_id, u->field_index);
+  if (f == NULL || !(f->flags & RDESC_VARIABLE) || u->usage_index + n > f->count ||
+      u->report_type == HID_REPORT_TYPE_INPUT) {
+    fprintf(stderr, "set usage 0x%X: not a variable output or feature field\n", u->usage_code);
+    return -1;
+  }
+  ri = rdescFindReport(&p->rd, u->report_type, u->report_id);
+  for (int k = 0; k < n; k++) {
+    rdescInsert(p->report[ri] + 1, f->bit_offset + (u->usage_index + k) * f->bit_size,
+                f->bit_size, (__u32) values[k]);
+  }
+  return 0;
+}
+
+static int hidrawSendReport(struct jabra_device *dev, __u32 report_type, __u32 report_id) {
+  struct hidraw_priv *p = dev->priv;
+  __u8 *buf;
+  int ri, len;
+
+  ri = rdescFindReport(&p->rd, report_type, report_id);
+  if (ri < 0 || report_type == HID_REPORT_TYPE_INPUT) {
+    fprintf(stderr, "send report %u/%u: no such report\n", report_type, report_id);
+    return -1;
+  }
+  /* unnumbered reports go out without the id byte */
+  buf = p->report[ri] + (p->rd.numbered ? 0 : 1);
+  len = rdescReportBytes(&p->rd.report[ri]) + (p->rd.numbered ? 1 : 0);
+
+  if (report_type == HID_REPORT_TYPE_FEATURE) {
+    if (deviceIoctl(dev, DEVCALL_SFEATURE, HIDIOCSFEATURE(len), buf) < 0) {
+      perror("HIDIOCSFEATURE");
+      return -1;
+    }
+  } else {
+    __u64 start = latencyNow();
+    int wr = write(dev->fd, buf, len);
+
+    deviceAccount(dev, DEVCALL_WRITE, start, wr != len);
+    if (wr != len) {
+      perror("write report");
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int hidrawReadEvents(struct jabra_device *dev, struct hiddev_event *ev, int max) {
+  struct hidraw_priv *p = dev->priv;
+  __u64 start;
+  int rd, n;
+
+  start = latencyNow();
+  rd = read(dev->fd, p->inbuf, RDESC_MAX_REPORT + 1);
+  deviceAccount(dev, DEVCALL_READ, start, rd < 0);
+  if (rd <= 0) {
+    if (rd < 0)
+      perror("error reading");
+    return -1;
+  }
+  /* reports the descriptor does not describe are ignored */
+  n = rdescDecode(&p->decoder, &p->input, p->inbuf, rd, ev, max);
+  return n < 0 ? 0 : n;
+}
+
+/****************************************************************************/
+/*                              EXPORTED DATA                               */
+/****************************************************************************/
+const struct transport_ops hidraw_transport = {
+  .name          = "hidraw",
+  .subsystem     = "hidraw",
+  .node_prefix   = "/dev/hidraw",
+  .open          = hidrawOpen,
+  .close         = hidrawClose,
+  .build_usages  = hidrawBuildUsages,
+  .check_usages  = NULL,
+  .resolve_usage = NULL,
+  .get_usage     = hidrawGetUsage,
+  .set_usages    = hidrawSetUsages,
+  .send_report   = hidrawSendReport,
+  .read_events   = hidrawReadEvents,
+};
@@ -0,0 +1,169 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_hotplug.c
+ *
+ * @brief  HID node hotplug monitor, see jabra_hotplug.h.
+ *
+ *         A kernel uevent is a datagram of NUL separated strings:
+ *         "add@/devices/.../usbmisc/hiddev0" followed by KEY=value
+ *         pairs such as ACTION=add, SUBSYSTEM=usbmisc and
+ *         DEVNAME=usb/hiddev0.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <errno.h>
+#include <linux/netlink.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "jabra_hotplug.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+
+/* Multicast group of uevents sent by the kernel itself */
+#define UEVENT_GROUP_KERNEL  1
+
+#define UEVENT_BUFFER_SIZE   4096
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static void handleUevent(struct hotplug *hp, const char *buf, int len) {
+  const char *action = NULL;
+  const char *subsystem = NULL;
+  const char *devname = NULL;
+  char devnode[128];
+
+  for (int i = 0; i < len; i += strlen(&buf[i]) + 1) {
+    const char *kv = &buf[i];
+    if (strncmp(kv, "ACTION=", 7) == 0)
+      action = kv + 7;
+    else if (strncmp(kv, "SUBSYSTEM=", 10) == 0)
+      subsystem = kv + 10;
+    else if (strncmp(kv, "DEVNAME=", 8) == 0)
+      devname = kv + 8;
+  }
+
+  if (action == NULL || subsystem == NULL || devname == NULL ||
+      strcmp(subsystem, hp->subsystem) != 0) {
+    return;
+  }
+
+  snprintf(devnode, sizeof(devnode), "/dev/%s", devname);
+  if (strncmp(devnode, hp->node_prefix, strlen(hp->node_prefix)) != 0) {
+    return;
+  }
+  if (strcmp(action, "add") == 0) {
+    hp->handler(HOTPLUG_ADD, devnode, hp->arg);
+  } else if (strcmp(action, "remove") == 0) {
+    hp->handler(HOTPLUG_REMOVE, devnode, hp->arg);
+  }
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int hotplugOpen(struct hotplug *hp, const char *subsystem, const char *node_prefix,
+                hotplug_handler handler, void *arg) {
+  struct sockaddr_nl addr;
+  int rcvbuf = 256 * 1024;
+
+  hp->subsystem = subsystem;
+  hp->node_prefix = node_prefix;
+  hp->handler = handler;
+  hp->arg = arg;
+  hp->fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+  if (hp->fd < 0) {
+    perror("socket NETLINK_KOBJECT_UEVENT");
+    return -1;
+  }
+
+  /* uevents come in bursts when a hub or dock is plugged in */
+  (void)setsockopt(hp->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = UEVENT_GROUP_KERNEL;
+  if (bind(hp->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("bind NETLINK_KOBJECT_UEVENT");
+    close(hp->fd);
+    hp->fd = -1;
+    return -1;
+  }
+  return 0;
+}
+
+void hotplugClose(struct hotplug *hp) {
+  if (hp->fd >= 0) {
+    close(hp->fd);
+    hp->fd = -1;
+  }
+}
+
+void hotplugDispatch(struct hotplug *hp) {
+  char buf[UEVENT_BUFFER_SIZE];
+  struct sockaddr_nl addr;
+  struct iovec iov = { buf, sizeof(buf) - 1 };
+  struct msghdr msg;
+  int lost = 0;
+
+  for (;;) {
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &addr;
+    msg.msg_namelen = sizeof(addr);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    int len = recvmsg(hp->fd, &msg, 0);
+    if (len < 0) {
+      if (errno == ENOBUFS) {
+        fprintf(stderr, "hotplug: uevents lost, rescanning\n");
+        lost = 1;
+        continue;
+      }
+      if (errno != EAGAIN && errno != EINTR)
+        perror("hotplug recvmsg");
+      break;
+    }
+
+    /* only trust messages sent by the kernel */
+    if (addr.nl_pid != 0 || (msg.msg_flags & MSG_TRUNC)) {
+      continue;
+    }
+    buf[len] = '\0';
+    handleUevent(hp, buf, len);
+  }
+
+  /* what was plugged in or out is only known from the nodes now */
+  if (lost) {
+    hp->handler(HOTPLUG_RESCAN, NULL, hp->arg);
+  }
+}
@@ -0,0 +1,66 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_hotplug.h
+ *
+ * @brief  HID node hotplug monitor. Listens to kernel uevents on a
+ *         NETLINK_KOBJECT_UEVENT socket and reports hiddev or hidraw
+ *         nodes being added or removed. No libudev needed.
+ */
+
+#ifndef JABRA_HOTPLUG_H
+#define JABRA_HOTPLUG_H
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+#define HOTPLUG_ADD          1
+#define HOTPLUG_REMOVE       2
+#define HOTPLUG_RESCAN       3   /* uevents were lost, devnode is NULL */
+
+/* devnode is the full /dev path of the node */
+typedef void (*hotplug_handler)(int action, const char *devnode, void *arg);
+
+struct hotplug {
+  int fd;                /* uevent socket, watch it for EPOLLIN */
+  const char *subsystem;   /* uevent SUBSYSTEM to watch */
+  const char *node_prefix; /* only nodes below this /dev path */
+  hotplug_handler handler;
+  void *arg;
+};
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int hotplugOpen(struct hotplug *hp, const char *subsystem, const char *node_prefix,
+                hotplug_handler handler, void *arg);
+void hotplugClose(struct hotplug *hp);
+
+/* read all pending uevents and call the handler for matching nodes. If
+ * the kernel dropped uevents because the socket buffer was full, the
+ * handler is called once more with HOTPLUG_RESCAN after the rest, the
+ * nodes present must then be compared with those in use */
+void hotplugDispatch(struct hotplug *hp);
+
+#endif /* JABRA_HOTPLUG_H */
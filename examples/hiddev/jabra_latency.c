@@ -0,0 +1,126 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_latency.c
+ *
+ * @brief  Latency histograms, see jabra_latency.h.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+
+#include "jabra_latency.h"
+
+/****************************************************************************/
+/*                              PRIVATE DATA                                */
+/****************************************************************************/
+static const char *const stage_names[LAT_STAGES] = {
+  [LAT_WAKE_TO_READ]     = "wake->read",
+  [LAT_READ_TO_DISPATCH] = "read->dispatch",
+  [LAT_DISPATCH_TO_SENT] = "dispatch->sent",
+  [LAT_END_TO_END]       = "wake->sent",
+  [LAT_OUTPUT_CALL]      = "output call",
+};
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+
+/* highest value that lands in bucket i */
+static __u64 bucketTop(int i) {
+  int e, sub;
+
+  if (i < HIST_SUB_BUCKETS) {
+    return i;
+  }
+  e = i / HIST_SUB_BUCKETS + HIST_SUB_BITS - 1;
+  sub = i % HIST_SUB_BUCKETS;
+  return ((__u64) (HIST_SUB_BUCKETS + sub + 1) << (e - HIST_SUB_BITS)) - 1;
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+void histReset(struct histogram *h) {
+  memset(h, 0, sizeof(*h));
+}
+
+void histAdd(struct histogram *dst, const struct histogram *src) {
+  if (src->count == 0) {
+    return;
+  }
+  if (dst->count == 0 || src->min < dst->min)
+    dst->min = src->min;
+  if (src->max > dst->max)
+    dst->max = src->max;
+  dst->count += src->count;
+  dst->sum += src->sum;
+  for (int i = 0; i < HIST_BUCKETS; i++) {
+    dst->bucket[i] += src->bucket[i];
+  }
+}
+
+__u64 histPercentile(const struct histogram *h, double percentile) {
+  __u64 target, seen = 0;
+
+  if (h->count == 0) {
+    return 0;
+  }
+  target = (__u64) (h->count * percentile / 100.0 + 0.5);
+  if (target == 0)
+    target = 1;
+  for (int i = 0; i < HIST_BUCKETS; i++) {
+    seen += h->bucket[i];
+    if (seen >= target) {
+      __u64 top = bucketTop(i);
+      return top < h->max ? top : h->max;
+    }
+  }
+  return h->max;
+}
+
+void histPrint(const char *prefix, const char *name, const struct histogram *h) {
+  if (h->count == 0) {
+    fprintf(stdout, "%s%-15s n=0\n", prefix, name);
+    return;
+  }
+  fprintf(stdout, "%s%-15s n=%llu min=%.1f p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f"
+    " max=%.1f mean=%.1f us\n",
+    prefix, name,
+    (unsigned long long) h->count,
+    h->min / 1000.0,
+    histPercentile(h, 50.0) / 1000.0,
+    histPercentile(h, 90.0) / 1000.0,
+    histPercentile(h, 99.0) / 1000.0,
+    histPercentile(h, 99.9) / 1000.0,
+    h->max / 1000.0,
+    (double) h->sum / h->count / 1000.0);
+}
+
+const char *latencyStageName(int stage) {
+  return stage_names[stage];
+}
@@ -0,0 +1,117 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_latency.h
+ *
+ * @brief  Latency histograms in the style of HdrHistogram: 16 linear
+ *         sub-buckets per power of two, so every recorded value is kept
+ *         within about 6% from 1 ns up to a minute in a fixed 2 KB of
+ *         counters, and recording is a count-leading-zeros and an add.
+ */
+
+#ifndef JABRA_LATENCY_H
+#define JABRA_LATENCY_H
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+#include <time.h>
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+#define HIST_SUB_BITS        4
+#define HIST_SUB_BUCKETS     (1 << HIST_SUB_BITS)
+#define HIST_MAX_EXPONENT    35    /* 2^36 ns, about 68 s */
+#define HIST_BUCKETS         ((HIST_MAX_EXPONENT - HIST_SUB_BITS + 2) * HIST_SUB_BUCKETS)
+
+struct histogram {
+  __u64 count;
+  __u64 sum;
+  __u64 min;
+  __u64 max;
+  __u32 bucket[HIST_BUCKETS];
+};
+
+/* Stages of one input event on its way to the output report */
+#define LAT_WAKE_TO_READ     0   /* epoll wakeup to read() returning */
+#define LAT_READ_TO_DISPATCH 1   /* queued in the event ring */
+#define LAT_DISPATCH_TO_SENT 2   /* call control and output reports */
+#define LAT_END_TO_END       3   /* epoll wakeup to the report sent */
+#define LAT_OUTPUT_CALL      4   /* each set_usages or send_report */
+#define LAT_STAGES           5
+
+struct latency {
+  struct histogram stage[LAT_STAGES];
+};
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+static inline __u64 latencyNow(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (__u64) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline int histIndex(__u64 v) {
+  int e;
+
+  if (v < HIST_SUB_BUCKETS) {
+    return v;
+  }
+  e = 63 - __builtin_clzll(v);
+  if (e > HIST_MAX_EXPONENT) {
+    return HIST_BUCKETS - 1;
+  }
+  return (e - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS +
+         ((v >> (e - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1));
+}
+
+static inline void histRecord(struct histogram *h, __u64 v) {
+  if (h->count == 0 || v < h->min)
+    h->min = v;
+  if (v > h->max)
+    h->max = v;
+  h->count++;
+  h->sum += v;
+  h->bucket[histIndex(v)]++;
+}
+
+void histReset(struct histogram *h);
+
+/* add the values recorded in src to dst */
+void histAdd(struct histogram *dst, const struct histogram *src);
+
+/* highest value equivalent to the given percentile, 0 if empty */
+__u64 histPercentile(const struct histogram *h, double percentile);
+
+/* one line: count, min, p50, p90, p99, p99.9, max and mean in us */
+void histPrint(const char *prefix, const char *name, const struct histogram *h);
+
+const char *latencyStageName(int stage);
+
+#endif /* JABRA_LATENCY_H */
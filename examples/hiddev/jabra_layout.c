@@ -0,0 +1,70 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_layout.c
+ *
+ * @brief  On-disk usage layout, see jabra_layout.h.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <string.h>
+
+#include "jabra_layout.h"
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+void layoutPack(struct layout_usage *lu, const struct usage_cache *usages) {
+  memset(lu, 0, usages->count * sizeof(*lu));
+  for (int i = 0; i < usages->count; i++) {
+    const struct usage_entry *u = &usages->entry[i];
+    lu[i].report_type     = u->report_type;
+    lu[i].report_id       = u->report_id;
+    lu[i].field_index     = u->field_index;
+    lu[i].usage_index     = u->usage_index;
+    lu[i].usage_code      = u->usage_code;
+    lu[i].logical_minimum = u->logical_minimum;
+    lu[i].logical_maximum = u->logical_maximum;
+  }
+}
+
+void layoutUnpack(struct usage_cache *usages, const struct layout_usage *lu, int count) {
+  usages->count = count;
+  usages->skipped = 0;
+  for (int i = 0; i < count; i++) {
+    struct usage_entry *u = &usages->entry[i];
+    u->report_type     = lu[i].report_type;
+    u->report_id       = lu[i].report_id;
+    u->field_index     = lu[i].field_index;
+    u->usage_index     = lu[i].usage_index;
+    u->usage_code      = lu[i].usage_code;
+    u->logical_minimum = lu[i].logical_minimum;
+    u->logical_maximum = lu[i].logical_maximum;
+    u->shadow_valid    = 0;
+    u->shadow          = 0;
+  }
+}
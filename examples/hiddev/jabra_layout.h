@@ -0,0 +1,70 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_layout.h
+ *
+ * @brief  On-disk form of a device's usage layout, shared by the
+ *         capability cache and the event traces: one fixed-size record
+ *         per usage_entry, in host byte order, without the output shadow.
+ */
+
+#ifndef JABRA_LAYOUT_H
+#define JABRA_LAYOUT_H
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+
+#include "jabra_device.h"
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+
+/* Compact usage_entry, HID limits report ids and field indexes to 8 bits */
+struct layout_usage {
+  __u8  report_type;
+  __u8  report_id;
+  __u8  field_index;
+  __u8  reserved;
+  __u16 usage_index;
+  __u16 reserved2;
+  __u32 usage_code;
+  __s32 logical_minimum;
+  __s32 logical_maximum;
+};
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+
+/* pack the usages->count entries of usages into lu */
+void layoutPack(struct layout_usage *lu, const struct usage_cache *usages);
+
+/* fill usages from count records, count is at most MAX_CACHED_USAGES */
+void layoutUnpack(struct usage_cache *usages, const struct layout_usage *lu, int count);
+
+#endif /* JABRA_LAYOUT_H */
@@ -0,0 +1,366 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_log.c
+ *
+ * @brief  Asynchronous logging, see jabra_log.h.
+ *
+ *         Every thread that logs gets its own single producer, single
+ *         consumer ring on first use, so producers never contend. The
+ *         writer sleeps on an eventfd and is only woken by a producer
+ *         that sees it asleep, with the same handshake as jabra_ring.c.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jabra_log.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+#define LOG_BATCH_SIZE       8192  /* bytes formatted before a write() */
+
+struct log_ring {
+  unsigned head __attribute__((aligned(64)));
+  unsigned long dropped;
+  unsigned tail __attribute__((aligned(64)));
+  struct log_record rec[LOG_RING_SIZE];
+};
+
+struct log_output {
+  int fd;
+  int len;
+  char buf[LOG_BATCH_SIZE];
+};
+
+/****************************************************************************/
+/*                              PRIVATE DATA                                */
+/****************************************************************************/
+static struct log_ring rings[LOG_MAX_THREADS];
+static int n_rings;
+static __thread struct log_ring *my_ring;
+static unsigned long orphan_dropped;   /* threads beyond LOG_MAX_THREADS */
+
+static pthread_t writer;
+static int running;
+static int sleeping;
+static int wakefd = -1;
+static unsigned long written;
+static unsigned long dropped_reported;
+
+static struct log_output out_stdout = { STDOUT_FILENO };
+static struct log_output out_stderr = { STDERR_FILENO };
+
+/****************************************************************************/
+/*                              EXPORTED DATA                               */
+/****************************************************************************/
+int logLevel = LOG_INFO;
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static __u64 nowNs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (__u64) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static struct log_ring *claimRing(void) {
+  int i = __atomic_fetch_add(&n_rings, 1, __ATOMIC_ACQ_REL);
+
+  if (i >= LOG_MAX_THREADS) {
+    return NULL;
+  }
+  return &rings[i];
+}
+
+static void outputFlush(struct log_output *out) {
+  int done = 0;
+
+  while (done < out->len) {
+    int n = write(out->fd, out->buf + done, out->len - done);
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  out->len = 0;
+}
+
+/* format one record, one conversion at a time so every argument is
+ * passed with the type its conversion expects */
+static void formatRecord(struct log_output *out, const struct log_record *r) {
+  char piece[256];
+  char spec[16];
+  const char *f = r->fmt;
+  int a = 0;
+
+  while (*f != '\0') {
+    const char *start = f;
+    int n = 0, len, is_long = 0;
+
+    if (*f != '%' || f[1] == '%') {
+      piece[0] = *f;
+      n = 1;
+      f += (*f == '%') ? 2 : 1;
+    } else {
+      f++;
+      while (*f != '\0' && strchr("-+ #0123456789.", *f) != NULL)
+        f++;
+      if (*f == 'l') {
+        is_long = 1;
+        f++;
+      }
+      len = f - start + 1;
+      if (*f == '\0' || len >= (int) sizeof(spec) || a >= r->nargs) {
+        break;
+      }
+      memcpy(spec, start, len);
+      spec[len] = '\0';
+      switch (*f) {
+        case 's':
+          n = snprintf(piece, sizeof(piece), spec,
+                r->str[a] != 0xFFFF ? r->text + r->str[a] : "(?)");
+          break;
+        case 'd': case 'i': case 'c':
+          n = is_long ? snprintf(piece, sizeof(piece), spec, r->arg[a]) :
+                        snprintf(piece, sizeof(piece), spec, (int) r->arg[a]);
+          break;
+        case 'u': case 'x': case 'X':
+          n = is_long ? snprintf(piece, sizeof(piece), spec, (unsigned long) r->arg[a]) :
+                        snprintf(piece, sizeof(piece), spec, (unsigned) r->arg[a]);
+          break;
+        default:
+          n = 0;
+          break;
+      }
+      a++;
+      f++;
+      if (n >= (int) sizeof(piece))
+        n = sizeof(piece) - 1;
+    }
+    if (out->len + n > LOG_BATCH_SIZE) {
+      outputFlush(out);
+    }
+    memcpy(out->buf + out->len, piece, n);
+    out->len += n;
+  }
+}
+
+/* oldest record among all ring heads, NULL when all are empty */
+static struct log_ring *oldest(int count) {
+  struct log_ring *best = NULL;
+  __u64 best_time = 0;
+
+  for (int i = 0; i < count; i++) {
+    struct log_ring *ring = &rings[i];
+    unsigned tail = ring->tail;
+
+    if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+      continue;
+    }
+    if (best == NULL || ring->rec[tail & (LOG_RING_SIZE - 1)].time_ns < best_time) {
+      best = ring;
+      best_time = ring->rec[tail & (LOG_RING_SIZE - 1)].time_ns;
+    }
+  }
+  return best;
+}
+
+static unsigned long totalDropped(int count) {
+  unsigned long total = __atomic_load_n(&orphan_dropped, __ATOMIC_RELAXED);
+
+  for (int i = 0; i < count; i++) {
+    total += __atomic_load_n(&rings[i].dropped, __ATOMIC_RELAXED);
+  }
+  return total;
+}
+
+/* write out everything queued, returns the number of records */
+static int drain(void) {
+  int count = __atomic_load_n(&n_rings, __ATOMIC_ACQUIRE);
+  struct log_ring *ring;
+  unsigned long dropped;
+  int n = 0;
+
+  if (count > LOG_MAX_THREADS)
+    count = LOG_MAX_THREADS;
+
+  while ((ring = oldest(count)) != NULL) {
+    const struct log_record *r = &ring->rec[ring->tail & (LOG_RING_SIZE - 1)];
+    formatRecord(r->level <= LOG_WARN ? &out_stderr : &out_stdout, r);
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+    n++;
+  }
+  __atomic_store_n(&written, written + n, __ATOMIC_RELAXED);
+
+  dropped = totalDropped(count);
+  if (dropped != dropped_reported) {
+    char line[64];
+    int len = snprintf(line, sizeof(line), "log: %lu records dropped\n",
+                       dropped - dropped_reported);
+    outputFlush(&out_stderr);
+    memcpy(out_stderr.buf, line, len);
+    out_stderr.len = len;
+    dropped_reported = dropped;
+  }
+  outputFlush(&out_stderr);
+  outputFlush(&out_stdout);
+  return n;
+}
+
+static int pending(void) {
+  int count = __atomic_load_n(&n_rings, __ATOMIC_ACQUIRE);
+
+  if (count > LOG_MAX_THREADS)
+    count = LOG_MAX_THREADS;
+  for (int i = 0; i < count; i++) {
+    if (__atomic_load_n(&rings[i].head, __ATOMIC_RELAXED) != rings[i].tail)
+      return 1;
+  }
+  return 0;
+}
+
+static void *writerLoop(void *arg) {
+  uint64_t count;
+
+  while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+    if (drain() > 0) {
+      continue;
+    }
+    __atomic_store_n(&sleeping, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (pending() || !__atomic_load_n(&running, __ATOMIC_RELAXED)) {
+      __atomic_store_n(&sleeping, 0, __ATOMIC_RELAXED);
+      continue;
+    }
+    (void)read(wakefd, &count, sizeof(count));
+  }
+  drain();
+  return NULL;
+}
+
+static void wakeWriter(void) {
+  uint64_t one = 1;
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&sleeping, __ATOMIC_RELAXED)) {
+    __atomic_store_n(&sleeping, 0, __ATOMIC_RELAXED);
+    (void)write(wakefd, &one, sizeof(one));
+  }
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int logInit(int level) {
+  logLevel = level;
+  wakefd = eventfd(0, EFD_CLOEXEC);
+  if (wakefd < 0) {
+    perror("eventfd");
+    return -1;
+  }
+  running = 1;
+  if (pthread_create(&writer, NULL, writerLoop, NULL)) {
+    fprintf(stderr, "Error creating log thread\n");
+    running = 0;
+    close(wakefd);
+    wakefd = -1;
+    return -1;
+  }
+  return 0;
+}
+
+void logClose(void) {
+  if (wakefd < 0) {
+    return;
+  }
+  __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+  __atomic_store_n(&sleeping, 1, __ATOMIC_RELAXED);
+  wakeWriter();
+  pthread_join(writer, NULL);
+  close(wakefd);
+  wakefd = -1;
+}
+
+void logWrite(int level, const char *fmt, const struct log_arg *args, int nargs) {
+  struct log_ring *ring = my_ring;
+  struct log_record *r;
+  unsigned head;
+  int text = 0;
+
+  if (ring == NULL) {
+    if ((ring = my_ring = claimRing()) == NULL) {
+      __atomic_fetch_add(&orphan_dropped, 1, __ATOMIC_RELAXED);
+      return;
+    }
+  }
+  head = ring->head;
+  if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= LOG_RING_SIZE) {
+    __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  r = &ring->rec[head & (LOG_RING_SIZE - 1)];
+  r->time_ns = nowNs();
+  r->fmt = fmt;
+  r->level = level;
+  r->nargs = nargs < LOG_MAX_ARGS ? nargs : LOG_MAX_ARGS;
+  for (int i = 0; i < r->nargs; i++) {
+    if (args[i].type == LOG_ARG_STR) {
+      int len = args[i].s ? strlen(args[i].s) : 0;
+      if (text + len + 1 > LOG_TEXT_SIZE)
+        len = LOG_TEXT_SIZE - text - 1;
+      if (len < 0) {
+        r->str[i] = 0xFFFF;
+        continue;
+      }
+      memcpy(r->text + text, args[i].s ? args[i].s : "", len);
+      r->text[text + len] = '\0';
+      r->str[i] = text;
+      text += len + 1;
+    } else {
+      r->arg[i] = args[i].i;
+      r->str[i] = 0xFFFF;
+    }
+  }
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  wakeWriter();
+}
+
+void logGetStats(struct log_stats *stats) {
+  int count = __atomic_load_n(&n_rings, __ATOMIC_ACQUIRE);
+
+  stats->written = __atomic_load_n(&written, __ATOMIC_RELAXED);
+  stats->dropped = totalDropped(count > LOG_MAX_THREADS ? LOG_MAX_THREADS : count);
+}
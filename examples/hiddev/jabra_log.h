@@ -0,0 +1,133 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_log.h
+ *
+ * @brief  Asynchronous logging. LOG() stores a fixed-size binary record
+ *         (format, arguments, time) in a ring owned by the calling
+ *         thread and returns; a background thread merges the rings in
+ *         time order, formats the records and writes them out in
+ *         batches. Records that do not fit are dropped and counted.
+ *
+ *         Formats support %d %i %u %x %X %c %s and %% with flags, width
+ *         and an l modifier, and take at most LOG_MAX_ARGS arguments.
+ *         String arguments are copied, so they need not outlive the call.
+ */
+
+#ifndef JABRA_LOG_H
+#define JABRA_LOG_H
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+
+/* Levels, errors and warnings go to stderr, the rest to stdout */
+#define LOG_ERROR            0
+#define LOG_WARN             1
+#define LOG_INFO             2
+#define LOG_DEBUG            3
+
+#define LOG_MAX_ARGS         4
+#define LOG_TEXT_SIZE        64    /* room for copied string arguments */
+#define LOG_RING_SIZE        512   /* records per thread, a power of two */
+#define LOG_MAX_THREADS      16
+
+#define LOG_ARG_INT          0
+#define LOG_ARG_STR          1
+
+struct log_arg {
+  int type;
+  union {
+    long i;
+    const char *s;
+  };
+};
+
+struct log_record {
+  __u64 time_ns;
+  const char *fmt;
+  __u8 level;
+  __u8 nargs;
+  __u16 str[LOG_MAX_ARGS];  /* offset in text of each string argument */
+  long arg[LOG_MAX_ARGS];
+  char text[LOG_TEXT_SIZE];
+};
+
+struct log_stats {
+  unsigned long written;
+  unsigned long dropped;    /* ring full, or too many threads */
+};
+
+extern int logLevel;
+
+static inline struct log_arg logInt(long i) {
+  struct log_arg a = { LOG_ARG_INT, { .i = i } };
+  return a;
+}
+
+static inline struct log_arg logStr(const char *s) {
+  struct log_arg a = { LOG_ARG_STR, { .s = s } };
+  return a;
+}
+
+#define LOG_ARG(x) _Generic((x), char *: logStr, const char *: logStr, default: logInt)(x)
+
+#define LOG_NARGS(...)       LOG_NARGS_(__VA_ARGS__, 4, 3, 2, 1, 0)
+#define LOG_NARGS_(a, b, c, d, n, ...) n
+#define LOG_ARGS_1(a)        LOG_ARG(a)
+#define LOG_ARGS_2(a, b)     LOG_ARG(a), LOG_ARG(b)
+#define LOG_ARGS_3(a, b, c)  LOG_ARG(a), LOG_ARG(b), LOG_ARG(c)
+#define LOG_ARGS_4(a, b, c, d) LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d)
+#define LOG_ARGS_(n, ...)    LOG_ARGS_##n(__VA_ARGS__)
+#define LOG_ARGS(n, ...)     LOG_ARGS_(n, __VA_ARGS__)
+
+/* at least one argument, use LOG(level, "%s", "text") for plain text */
+#define LOG(level, fmt, ...) \
+  do { \
+    if ((level) <= logLevel) { \
+      struct log_arg log_args_[] = { LOG_ARGS(LOG_NARGS(__VA_ARGS__), __VA_ARGS__) }; \
+      logWrite(level, fmt, log_args_, LOG_NARGS(__VA_ARGS__)); \
+    } \
+  } while (0)
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+
+/* start the writer thread, records below level are not even queued */
+int logInit(int level);
+
+/* write out everything queued and stop the writer thread */
+void logClose(void);
+
+void logWrite(int level, const char *fmt, const struct log_arg *args, int nargs);
+
+void logGetStats(struct log_stats *stats);
+
+#endif /* JABRA_LOG_H */
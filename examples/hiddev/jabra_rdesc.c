@@ -0,0 +1,501 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_rdesc.c
+ *
+ * @brief  HID report descriptor parser, see jabra_rdesc.h.
+ *
+ *         Follows the rules of the kernel HID parser where they matter
+ *         for hiddev compatibility: constant fields without usages are
+ *         padding and get no field index, a variable field repeats its
+ *         last usage when it has fewer usages than report count, and the
+ *         logical maximum is unsigned unless the minimum is negative.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <endian.h>
+#include <linux/hiddev.h>
+#include <string.h>
+
+#include "jabra_rdesc.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+#define ITEM_MAIN            0
+#define ITEM_GLOBAL          1
+#define ITEM_LOCAL           2
+#define ITEM_LONG            0xFE
+
+#define MAIN_INPUT           0x8
+#define MAIN_OUTPUT          0x9
+#define MAIN_COLLECTION      0xA
+#define MAIN_FEATURE         0xB
+#define MAIN_END_COLLECTION  0xC
+
+#define GLOBAL_USAGE_PAGE    0x0
+#define GLOBAL_LOGICAL_MIN   0x1
+#define GLOBAL_LOGICAL_MAX   0x2
+#define GLOBAL_REPORT_SIZE   0x7
+#define GLOBAL_REPORT_ID     0x8
+#define GLOBAL_REPORT_COUNT  0x9
+#define GLOBAL_PUSH          0xA
+#define GLOBAL_POP           0xB
+
+#define LOCAL_USAGE          0x0
+#define LOCAL_USAGE_MIN      0x1
+#define LOCAL_USAGE_MAX      0x2
+
+#define MAX_LOCAL_USAGES     256
+#define MAX_GLOBAL_STACK     4
+
+struct global_state {
+  __u32 usage_page;
+  __u32 logical_minimum_raw;
+  __u32 logical_maximum_raw;
+  int logical_minimum_size;
+  int logical_maximum_size;
+  __u32 report_size;
+  __u32 report_id;
+  __u32 report_count;
+};
+
+struct parser {
+  struct global_state global;
+  struct global_state stack[MAX_GLOBAL_STACK];
+  int sp;
+  /* local usages, the page is added at the main item when size < 4 */
+  __u32 usage[MAX_LOCAL_USAGES];
+  __u8 usage_size[MAX_LOCAL_USAGES];
+  int n_usages;
+  __u32 usage_min;
+  int usage_min_size;
+};
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static __s32 signExtend(__u32 value, int size) {
+  switch (size) {
+    case 1:  return (__s8) value;
+    case 2:  return (__s16) value;
+    default: return (__s32) value;
+  }
+}
+
+static void addLocalUsage(struct parser *p, __u32 usage, int size) {
+  if (p->n_usages < MAX_LOCAL_USAGES) {
+    p->usage[p->n_usages] = usage;
+    p->usage_size[p->n_usages] = size;
+    p->n_usages++;
+  }
+}
+
+static int addField(struct rdesc *rd, struct parser *p, int report_type, __u32 flags) {
+  struct global_state *g = &p->global;
+  struct rdesc_report *r;
+  struct rdesc_field *f;
+  int ri;
+  __u32 bits = g->report_size * g->report_count;
+
+  if (g->report_size > 32 || g->report_id > 255) {
+    return -1;
+  }
+  if (g->report_id != 0) {
+    rd->numbered = 1;
+  }
+
+  ri = rdescFindReport(rd, report_type, g->report_id);
+  if (ri < 0) {
+    if (rd->n_reports >= RDESC_MAX_REPORTS) {
+      return -1;
+    }
+    ri = rd->n_reports++;
+    r = &rd->report[ri];
+    r->report_type = report_type;
+    r->report_id   = g->report_id;
+    r->n_fields    = 0;
+    r->size_bits   = 0;
+  }
+  r = &rd->report[ri];
+
+  if (p->n_usages == 0) {
+    /* padding */
+    r->size_bits += bits;
+    return r->size_bits > RDESC_MAX_REPORT * 8 ? -1 : 0;
+  }
+  /* a value of no bits cannot be read or written */
+  if (g->report_size == 0 || rd->n_fields >= RDESC_MAX_FIELDS) {
+    return -1;
+  }
+
+  f = &rd->field[rd->n_fields];
+  f->report_type     = report_type;
+  f->report_id       = g->report_id;
+  f->field_index     = r->n_fields;
+  f->flags           = flags;
+  f->bit_offset      = r->size_bits;
+  f->bit_size        = g->report_size;
+  f->count           = g->report_count;
+  f->logical_minimum = signExtend(g->logical_minimum_raw, g->logical_minimum_size);
+  if (f->logical_minimum < 0)
+    f->logical_maximum = signExtend(g->logical_maximum_raw, g->logical_maximum_size);
+  else
+    f->logical_maximum = g->logical_maximum_raw;
+
+  f->n_usages = p->n_usages;
+  if ((flags & RDESC_VARIABLE) && f->count > f->n_usages) {
+    f->n_usages = f->count;
+  }
+  if (rd->n_usages + f->n_usages > RDESC_MAX_USAGES ||
+      rd->n_values + f->count > RDESC_MAX_VALUES) {
+    return -1;
+  }
+  f->first_usage = rd->n_usages;
+  for (int i = 0; i < f->n_usages; i++) {
+    int j = i < p->n_usages ? i : p->n_usages - 1;
+    __u32 usage = p->usage[j];
+    if (p->usage_size[j] < 4) {
+      usage = (g->usage_page << 16) | (usage & 0xFFFF);
+    }
+    rd->usage[rd->n_usages++] = usage;
+  }
+  f->first_value = rd->n_values;
+  rd->n_values += f->count;
+
+  r->size_bits += bits;
+  r->n_fields++;
+  rd->n_fields++;
+  return r->size_bits > RDESC_MAX_REPORT * 8 ? -1 : 0;
+}
+
+static inline __s32 extractValue(const struct rdesc_extractor *x, const __u8 *data) {
+  __u64 w;
+  __u32 v;
+
+  memcpy(&w, data + x->byte, sizeof(w));
+  v = (__u32) (le64toh(w) >> x->shift) & x->mask;
+  if (x->flags & RDESC_EX_SIGNED) {
+    v = (v ^ x->sign) - x->sign;
+  }
+  return (__s32) v;
+}
+
+static inline __u32 arrayUsage(const struct rdesc_decoder *dec, const struct rdesc_extractor *x,
+                               __s32 value) {
+  __s32 idx = value - x->logical_minimum;
+
+  if (idx < 0 || idx >= x->n_usages) {
+    return 0;
+  }
+  return dec->usage[x->usage + idx];
+}
+
+/* array field: released usages first, then pressed ones */
+static int decodeArray(const struct rdesc_decoder *dec, const struct rdesc_extractor *x,
+                       __s32 *prev, int seen, const __u8 *data,
+                       struct hiddev_event *ev, int n, int max) {
+  __s32 now[RDESC_MAX_VALUES];
+  int count = x->group;
+  int k, m;
+
+  for (k = 0; k < count; k++) {
+    now[k] = extractValue(&x[k], data);
+  }
+  for (k = 0; seen && k < count; k++) {
+    __u32 usage = arrayUsage(dec, x, prev[k]);
+    for (m = 0; m < count && now[m] != prev[k]; m++);
+    if (usage != 0 && m == count && n < max) {
+      ev[n].hid = usage;
+      ev[n].value = 0;
+      n++;
+    }
+  }
+  for (k = 0; k < count; k++) {
+    __u32 usage = arrayUsage(dec, x, now[k]);
+    for (m = 0; seen && m < count && prev[m] != now[k]; m++);
+    if (usage != 0 && (!seen || m == count) && n < max) {
+      ev[n].hid = usage;
+      ev[n].value = 1;
+      n++;
+    }
+  }
+  memcpy(prev, now, count * sizeof(now[0]));
+  return n;
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int rdescParse(struct rdesc *rd, const __u8 *data, int len) {
+  struct parser p;
+  int i = 0;
+
+  memset(rd, 0, sizeof(*rd));
+  memset(&p, 0, sizeof(p));
+
+  while (i < len) {
+    __u8 prefix = data[i++];
+    int size, type, tag;
+    __u32 value = 0;
+
+    if (prefix == ITEM_LONG) {
+      if (i + 2 > len)
+        return -1;
+      i += 2 + data[i];
+      continue;
+    }
+    size = prefix & 3;
+    if (size == 3)
+      size = 4;
+    type = (prefix >> 2) & 3;
+    tag  = (prefix >> 4) & 0xF;
+    if (i + size > len) {
+      return -1;
+    }
+    for (int b = 0; b < size; b++) {
+      value |= (__u32) data[i + b] << (8 * b);
+    }
+    i += size;
+
+    switch (type) {
+      case ITEM_MAIN:
+        switch (tag) {
+          case MAIN_INPUT:
+            if (addField(rd, &p, HID_REPORT_TYPE_INPUT, value) < 0)
+              return -1;
+            break;
+          case MAIN_OUTPUT:
+            if (addField(rd, &p, HID_REPORT_TYPE_OUTPUT, value) < 0)
+              return -1;
+            break;
+          case MAIN_FEATURE:
+            if (addField(rd, &p, HID_REPORT_TYPE_FEATURE, value) < 0)
+              return -1;
+            break;
+          default:
+            break;
+        }
+        /* locals only live until the next main item */
+        p.n_usages = 0;
+        break;
+
+      case ITEM_GLOBAL:
+        switch (tag) {
+          case GLOBAL_USAGE_PAGE:
+            p.global.usage_page = value & 0xFFFF;
+            break;
+          case GLOBAL_LOGICAL_MIN:
+            p.global.logical_minimum_raw = value;
+            p.global.logical_minimum_size = size;
+            break;
+          case GLOBAL_LOGICAL_MAX:
+            p.global.logical_maximum_raw = value;
+            p.global.logical_maximum_size = size;
+            break;
+          case GLOBAL_REPORT_SIZE:
+            p.global.report_size = value;
+            break;
+          case GLOBAL_REPORT_ID:
+            if (value == 0)
+              return -1;
+            p.global.report_id = value;
+            break;
+          case GLOBAL_REPORT_COUNT:
+            p.global.report_count = value;
+            break;
+          case GLOBAL_PUSH:
+            if (p.sp >= MAX_GLOBAL_STACK)
+              return -1;
+            p.stack[p.sp++] = p.global;
+            break;
+          case GLOBAL_POP:
+            if (p.sp == 0)
+              return -1;
+            p.global = p.stack[--p.sp];
+            break;
+          default:
+            break;
+        }
+        break;
+
+      case ITEM_LOCAL:
+        switch (tag) {
+          case LOCAL_USAGE:
+            addLocalUsage(&p, value, size);
+            break;
+          case LOCAL_USAGE_MIN:
+            p.usage_min = value;
+            p.usage_min_size = size;
+            break;
+          case LOCAL_USAGE_MAX: {
+            /* extended usages carry their page in the upper 16 bits */
+            int usize = (size == 4 || p.usage_min_size == 4) ? 4 : size;
+            for (__u32 u = p.usage_min; u <= value && p.n_usages < MAX_LOCAL_USAGES; u++)
+              addLocalUsage(&p, u, usize);
+            break;
+          }
+          default:
+            break;
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+  return 0;
+}
+
+int rdescFindReport(const struct rdesc *rd, int report_type, int report_id) {
+  for (int i = 0; i < rd->n_reports; i++) {
+    if (rd->report[i].report_type == report_type && rd->report[i].report_id == report_id) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+__u32 rdescExtract(const __u8 *data, __u32 bit_offset, int bit_size) {
+  __u64 v = 0;
+  int first = bit_offset / 8;
+  int last = (bit_offset + bit_size - 1) / 8;
+
+  for (int b = last; b >= first; b--) {
+    v = (v << 8) | data[b];
+  }
+  v >>= bit_offset % 8;
+  return bit_size == 32 ? (__u32) v : (__u32) (v & ((1u << bit_size) - 1));
+}
+
+void rdescInsert(__u8 *data, __u32 bit_offset, int bit_size, __u32 value) {
+  for (int i = 0; i < bit_size; i++) {
+    __u32 bit = bit_offset + i;
+    if (value & (1u << i))
+      data[bit / 8] |= (__u8) (1u << (bit % 8));
+    else
+      data[bit / 8] &= (__u8) ~(1u << (bit % 8));
+  }
+}
+
+void rdescCompile(const struct rdesc *rd, struct rdesc_decoder *dec) {
+  dec->numbered = rd->numbered;
+  dec->usage = rd->usage;
+  dec->n_extractors = 0;
+  for (int i = 0; i < 256; i++) {
+    dec->input[i] = -1;
+  }
+
+  for (int r = 0; r < rd->n_reports; r++) {
+    const struct rdesc_report *rep = &rd->report[r];
+
+    if (rep->report_type != HID_REPORT_TYPE_INPUT) {
+      continue;
+    }
+    dec->input[rep->report_id] = r;
+    dec->report[r].first = dec->n_extractors;
+    dec->report[r].size  = rdescReportBytes(rep);
+
+    for (int i = 0; i < rd->n_fields; i++) {
+      const struct rdesc_field *f = &rd->field[i];
+
+      if (f->report_type != HID_REPORT_TYPE_INPUT || f->report_id != rep->report_id) {
+        continue;
+      }
+      for (int k = 0; k < f->count; k++) {
+        struct rdesc_extractor *x = &dec->ex[dec->n_extractors++];
+        __u32 bit = f->bit_offset + k * f->bit_size;
+
+        x->byte  = bit / 8;
+        x->shift = bit % 8;
+        x->flags = 0;
+        x->mask  = f->bit_size == 32 ? 0xFFFFFFFF : (1u << f->bit_size) - 1;
+        x->sign  = 1u << (f->bit_size - 1);
+        x->slot  = f->first_value + k;
+        x->group = 0;
+        x->logical_minimum = f->logical_minimum;
+        x->n_usages = f->n_usages;
+        if (f->logical_minimum < 0 && f->bit_size < 32) {
+          x->flags |= RDESC_EX_SIGNED;
+        }
+        if (f->flags & RDESC_VARIABLE) {
+          x->usage = rd->usage[f->first_usage + k];
+        } else {
+          x->flags |= RDESC_EX_ARRAY;
+          x->usage = f->first_usage;
+          x->group = (k == 0) ? f->count : 0;
+        }
+      }
+    }
+    dec->report[r].count = dec->n_extractors - dec->report[r].first;
+  }
+}
+
+int rdescDecode(const struct rdesc_decoder *dec, struct rdesc_state *st,
+                __u8 *buf, int len, struct hiddev_event *ev, int max) {
+  const struct rdesc_extractor *x, *end;
+  const __u8 *data = buf;
+  int report_id = 0;
+  int seen, r, size;
+  int n = 0;
+
+  if (dec->numbered) {
+    if (len < 1)
+      return -1;
+    report_id = buf[0];
+    data++;
+    len--;
+  }
+  if ((r = dec->input[report_id]) < 0) {
+    return -1;
+  }
+  /* short reports read as zero */
+  size = dec->report[r].size;
+  if (len < size) {
+    memset((__u8 *) data + len, 0, size - len);
+  }
+
+  seen = st->seen[report_id];
+  x = &dec->ex[dec->report[r].first];
+  end = x + dec->report[r].count;
+  while (x < end) {
+    if (x->flags & RDESC_EX_ARRAY) {
+      n = decodeArray(dec, x, &st->value[x->slot], seen, data, ev, n, max);
+      x += x->group;
+      continue;
+    }
+    __s32 v = extractValue(x, data);
+    if ((!seen || v != st->value[x->slot]) && n < max) {
+      ev[n].hid = x->usage;
+      ev[n].value = v;
+      n++;
+    }
+    st->value[x->slot] = v;
+    x++;
+  }
+  st->seen[report_id] = 1;
+  return n;
+}
@@ -0,0 +1,163 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_rdesc.h
+ *
+ * @brief  HID report descriptor parser. Turns a raw descriptor into the
+ *         list of fields of every input, output and feature report with
+ *         their bit position, logical range and usages, numbered the way
+ *         hiddev numbers them.
+ *
+ *         Input reports are compiled once into a flat table of
+ *         extractors, one per report value, so decoding a report is a
+ *         load, a shift and a mask per value without any allocation.
+ */
+
+#ifndef JABRA_RDESC_H
+#define JABRA_RDESC_H
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+#include <linux/hiddev.h>
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+#define RDESC_MAX_FIELDS     128
+#define RDESC_MAX_USAGES     1024
+#define RDESC_MAX_VALUES     1024  /* report count summed over all fields */
+#define RDESC_MAX_REPORTS    64
+#define RDESC_MAX_REPORT     256   /* report size in bytes without the id */
+
+/* Main item data bits */
+#define RDESC_CONSTANT       0x001
+#define RDESC_VARIABLE       0x002
+#define RDESC_RELATIVE       0x004
+
+struct rdesc_field {
+  __u8  report_type;     /* HID_REPORT_TYPE_INPUT, _OUTPUT or _FEATURE */
+  __u8  report_id;
+  __u16 field_index;     /* padding fields are not counted, like hiddev */
+  __u32 flags;           /* main item data */
+  __u32 bit_offset;      /* from the first byte after the report id */
+  __u16 bit_size;
+  __u16 count;           /* report count */
+  __s32 logical_minimum;
+  __s32 logical_maximum;
+  __u16 first_usage;     /* index into rdesc.usage */
+  __u16 n_usages;        /* maxusage in hiddev terms */
+  __u16 first_value;     /* index of the first of count values */
+};
+
+struct rdesc_report {
+  __u8  report_type;
+  __u8  report_id;
+  __u16 n_fields;
+  __u32 size_bits;
+};
+
+/* Extractor flags */
+#define RDESC_EX_SIGNED      0x01
+#define RDESC_EX_ARRAY       0x02
+
+/* Decoded input reports are read from buffers this much longer than the
+ * largest report, so an extractor can always load 8 bytes */
+#define RDESC_DECODE_PAD     8
+
+struct rdesc {
+  int numbered;          /* reports start with a report id byte */
+  int n_fields;
+  struct rdesc_field field[RDESC_MAX_FIELDS];
+  int n_usages;
+  __u32 usage[RDESC_MAX_USAGES];
+  int n_values;
+  int n_reports;
+  struct rdesc_report report[RDESC_MAX_REPORTS];
+};
+
+/* one input value: (load64(data + byte) >> shift) & mask */
+struct rdesc_extractor {
+  __u16 byte;
+  __u8  shift;
+  __u8  flags;
+  __u32 mask;
+  __u32 sign;            /* top bit of the value when RDESC_EX_SIGNED */
+  __u16 slot;            /* index in rdesc_state.value, the rdesc value index */
+  __u16 group;           /* array: values in the field, set on the first only */
+  __u32 usage;           /* variable: the usage, array: first usage index */
+  __s32 logical_minimum; /* array: value of the first usage */
+  __u16 n_usages;        /* array: usages selectable */
+};
+
+struct rdesc_decoder {
+  int numbered;
+  __s16 input[256];      /* report id -> index in report, -1 if none */
+  struct {
+    __u16 first;         /* extractors of the report */
+    __u16 count;
+    __u16 size;          /* report bytes without the id */
+  } report[RDESC_MAX_REPORTS];
+  int n_extractors;
+  struct rdesc_extractor ex[RDESC_MAX_VALUES];
+  const __u32 *usage;    /* usage table of the parsed descriptor */
+};
+
+/* previous input values, so that only changes become events */
+struct rdesc_state {
+  __u8  seen[256];       /* report id received at least once */
+  __s32 value[RDESC_MAX_VALUES];
+};
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+
+/* -1 if the descriptor is malformed or exceeds the limits above */
+int rdescParse(struct rdesc *rd, const __u8 *data, int len);
+
+/* report index in rd->report, -1 if the report does not exist */
+int rdescFindReport(const struct rdesc *rd, int report_type, int report_id);
+
+/* report size in bytes, without the report id byte */
+static inline int rdescReportBytes(const struct rdesc_report *r) {
+  return (r->size_bits + 7) / 8;
+}
+
+/* compile the input reports of rd, which must outlive dec */
+void rdescCompile(const struct rdesc *rd, struct rdesc_decoder *dec);
+
+/* decode one input report as read from hidraw (with the id byte when the
+ * reports are numbered) into events for the values that changed. buf must
+ * hold RDESC_DECODE_PAD bytes beyond len. Returns the number of events,
+ * -1 for a report the descriptor does not describe */
+int rdescDecode(const struct rdesc_decoder *dec, struct rdesc_state *st,
+                __u8 *buf, int len, struct hiddev_event *ev, int max);
+
+/* little endian bit field access, bit_size is at most 32 */
+__u32 rdescExtract(const __u8 *data, __u32 bit_offset, int bit_size);
+void rdescInsert(__u8 *data, __u32 bit_offset, int bit_size, __u32 value);
+
+#endif /* JABRA_RDESC_H */
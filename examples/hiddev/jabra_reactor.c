@@ -0,0 +1,176 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_reactor.c
+ *
+ * @brief  epoll based event dispatcher, see jabra_reactor.h.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jabra_reactor.h"
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static void reactorWakeup(int fd, __u32 events, void *arg) {
+  struct reactor *r = arg;
+  uint64_t count;
+
+  if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+    perror("eventfd read");
+  }
+  r->running = 0;
+}
+
+static void reactorSignal(int fd, __u32 events, void *arg) {
+  struct reactor *r = arg;
+  struct signalfd_siginfo si;
+
+  if (read(fd, &si, sizeof(si)) == sizeof(si)) {
+    fprintf(stdout, "Got signal %u, exiting\n", si.ssi_signo);
+  }
+  r->running = 0;
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int reactorInit(struct reactor *r) {
+  sigset_t mask;
+
+  for (int i = 0; i < MAX_REACTOR_SOURCES; i++) {
+    r->source[i].fd = -1;
+  }
+  r->epfd = -1;
+  r->wakefd = -1;
+  r->sigfd = -1;
+  r->running = 1;
+
+  if ((r->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+    perror("epoll_create1");
+    return -1;
+  }
+  if ((r->wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0) {
+    perror("eventfd");
+    return -1;
+  }
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  if ((r->sigfd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK)) < 0) {
+    perror("signalfd");
+    return -1;
+  }
+  if (reactorAdd(r, r->wakefd, reactorWakeup, r) < 0 ||
+      reactorAdd(r, r->sigfd, reactorSignal, r) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+void reactorClose(struct reactor *r) {
+  if (r->sigfd >= 0)
+    close(r->sigfd);
+  if (r->wakefd >= 0)
+    close(r->wakefd);
+  if (r->epfd >= 0)
+    close(r->epfd);
+  r->sigfd = r->wakefd = r->epfd = -1;
+}
+
+int reactorAdd(struct reactor *r, int fd, reactor_handler handler, void *arg) {
+  struct epoll_event ev;
+
+  for (int i = 0; i < MAX_REACTOR_SOURCES; i++) {
+    struct reactor_source *src = &r->source[i];
+    if (src->fd == -1) {
+      src->fd      = fd;
+      src->handler = handler;
+      src->arg     = arg;
+      ev.events    = EPOLLIN;
+      ev.data.ptr  = src;
+      if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("EPOLL_CTL_ADD");
+        src->fd = -1;
+        return -1;
+      }
+      return 0;
+    }
+  }
+  fprintf(stderr, "reactor: no free slot for fd %d\n", fd);
+  return -1;
+}
+
+void reactorRemove(struct reactor *r, int fd) {
+  for (int i = 0; i < MAX_REACTOR_SOURCES; i++) {
+    if (r->source[i].fd == fd) {
+      (void)epoll_ctl(r->epfd, EPOLL_CTL_DEL, fd, NULL);
+      r->source[i].fd = -1;
+    }
+  }
+}
+
+void reactorRun(struct reactor *r) {
+  struct epoll_event ev[16];
+  struct timespec now;
+
+  while (r->running) {
+    int n = epoll_wait(r->epfd, ev, sizeof(ev) / sizeof(ev[0]), -1);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("epoll_wait");
+      r->running = 0;
+      break;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    r->wake_ns = (__u64) now.tv_sec * 1000000000ull + now.tv_nsec;
+    for (int i = 0; i < n; i++) {
+      struct reactor_source *src = ev[i].data.ptr;
+      if (src->fd != -1) {
+        src->handler(src->fd, ev[i].events, src->arg);
+      }
+    }
+  }
+}
+
+void reactorStop(struct reactor *r) {
+  uint64_t one = 1;
+
+  if (write(r->wakefd, &one, sizeof(one)) < 0) {
+    perror("eventfd write");
+  }
+}
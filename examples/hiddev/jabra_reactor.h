@@ -0,0 +1,85 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_reactor.h
+ *
+ * @brief  epoll based event dispatcher. Watches any number of file
+ *         descriptors and calls a handler when one becomes readable.
+ *         SIGINT/SIGTERM and reactorStop() end reactorRun() immediately.
+ */
+
+#ifndef JABRA_REACTOR_H
+#define JABRA_REACTOR_H
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+
+/* Maximum number of file descriptors watched by the reactor, room for
+ * MAX_DEVICES devices, the control socket clients and the program's own
+ * descriptors */
+#define MAX_REACTOR_SOURCES  384
+
+typedef void (*reactor_handler)(int fd, __u32 events, void *arg);
+
+/* File descriptor watched by the reactor, fd is -1 for a free slot */
+struct reactor_source {
+  int fd;
+  reactor_handler handler;
+  void *arg;
+};
+
+/* epoll based event dispatcher */
+struct reactor {
+  int epfd;
+  int wakefd;            /* eventfd written to stop reactorRun() */
+  int sigfd;             /* signalfd for SIGINT and SIGTERM */
+  int running;
+  __u64 wake_ns;         /* CLOCK_MONOTONIC when epoll_wait() last returned */
+  struct reactor_source source[MAX_REACTOR_SOURCES];
+};
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+
+/* SIGINT and SIGTERM must already be blocked in every thread */
+int reactorInit(struct reactor *r);
+void reactorClose(struct reactor *r);
+
+int reactorAdd(struct reactor *r, int fd, reactor_handler handler, void *arg);
+void reactorRemove(struct reactor *r, int fd);
+
+/* dispatch events until reactorStop() or a signal */
+void reactorRun(struct reactor *r);
+
+/* may be called from any thread */
+void reactorStop(struct reactor *r);
+
+#endif /* JABRA_REACTOR_H */
@@ -0,0 +1,219 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_replay.c
+ *
+ * @brief  Replay transport. dev->path names a trace from jabra_trace.h
+ *         whose events are read back through the same reactor, ring and
+ *         handler thread as those of a real device, so the dispatch
+ *         pipeline can be benchmarked without any hardware.
+ *
+ *         By default the batches are delivered as fast as the event loop
+ *         asks for them, the fd is an eventfd that stays readable until
+ *         the trace is exhausted. With replaySetPaced(1) the fd is a
+ *         timerfd armed for the recorded time of the next batch. Output
+ *         reports are accepted and dropped, so what is measured is the
+ *         user space part of the pipeline. The trace ends like an unplug.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "jabra_device.h"
+#include "jabra_trace.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+struct replay_priv {
+  struct trace tr;
+  unsigned long next;    /* next event to deliver */
+  __u64 start_ns;        /* first read, 0 before */
+  int paced;             /* replaySetPaced() when opened */
+};
+
+/****************************************************************************/
+/*                              PRIVATE DATA                                */
+/****************************************************************************/
+static int paced = 0;
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+
+/* paced replay: wake up when the event at p->next is due */
+static void armTimer(struct jabra_device *dev) {
+  struct replay_priv *p = dev->priv;
+  struct itimerspec its;
+  __u64 due;
+
+  memset(&its, 0, sizeof(its));
+  if (p->next < p->tr.n_events) {
+    due = p->start_ns + p->tr.event[p->next].time_ns - p->tr.event[0].time_ns;
+    its.it_value.tv_sec  = due / 1000000000ull;
+    its.it_value.tv_nsec = due % 1000000000ull;
+  } else {
+    /* already expired, the next read reports the end */
+    its.it_value.tv_nsec = 1;
+  }
+  (void)timerfd_settime(dev->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static int replayOpen(struct jabra_device *dev) {
+  struct replay_priv *p;
+
+  if ((p = calloc(1, sizeof(*p))) == NULL) {
+    perror("calloc");
+    return -1;
+  }
+  if (traceLoad(&p->tr, dev->path) < 0) {
+    free(p);
+    return -1;
+  }
+  p->paced = paced;
+  if (p->paced) {
+    dev->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  } else {
+    dev->fd = eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+  }
+  if (dev->fd < 0) {
+    perror(dev->path);
+    traceUnload(&p->tr);
+    free(p);
+    return -1;
+  }
+  dev->priv = p;
+  if (p->paced) {
+    p->start_ns = latencyNow();
+    armTimer(dev);
+  }
+
+  memset(&dev->devinfo, 0, sizeof(dev->devinfo));
+  dev->devinfo.vendor  = p->tr.hdr->vendor;
+  dev->devinfo.product = p->tr.hdr->product;
+  dev->devinfo.version = p->tr.hdr->version;
+  snprintf(dev->name, sizeof(dev->name), "%.*s",
+    (int) sizeof(p->tr.hdr->name), p->tr.hdr->name);
+  return 0;
+}
+
+static void replayClose(struct jabra_device *dev) {
+  struct replay_priv *p = dev->priv;
+  double s = p->start_ns ? (latencyNow() - p->start_ns) / 1e9 : 0.0;
+
+  fprintf(stdout, "[%d] Replayed %lu of %lu events, %lu dispatched in %.3f s (%.0f events/s)\n",
+    dev->index, p->next, p->tr.n_events, dev->istats.events, s,
+    s > 0 ? dev->istats.events / s : 0.0);
+  close(dev->fd);
+  traceUnload(&p->tr);
+  free(p);
+}
+
+static void replayBuildUsages(struct jabra_device *dev) {
+  struct replay_priv *p = dev->priv;
+
+  traceUsages(&p->tr, &dev->usages);
+}
+
+static int replayGetUsage(struct jabra_device *dev, const struct usage_entry *u, __s32 *value) {
+  *value = 0;
+  return 0;
+}
+
+static int replaySetUsages(struct jabra_device *dev, const struct usage_entry *u,
+                           const __s32 *values, int n) {
+  return 0;
+}
+
+static int replaySendReport(struct jabra_device *dev, __u32 report_type, __u32 report_id) {
+  return 0;
+}
+
+/* one recorded batch, or every batch that is due when paced */
+static int replayReadEvents(struct jabra_device *dev, struct hiddev_event *ev, int max) {
+  struct replay_priv *p = dev->priv;
+  const struct trace_event *te = p->tr.event;
+  __u64 expirations, due;
+  int n = 0;
+
+  if (p->next >= p->tr.n_events) {
+    return -1;
+  }
+  if (p->paced) {
+    if (read(dev->fd, &expirations, sizeof(expirations)) < 0 && errno == EAGAIN) {
+      return 0;
+    }
+    due = latencyNow() - p->start_ns + te[0].time_ns;
+    while (n < max && p->next < p->tr.n_events && te[p->next].time_ns <= due) {
+      ev[n].hid   = te[p->next].hid;
+      ev[n].value = te[p->next].value;
+      n++;
+      p->next++;
+    }
+    armTimer(dev);
+    return n;
+  }
+
+  if (p->start_ns == 0) {
+    p->start_ns = latencyNow();
+  }
+  do {
+    ev[n].hid   = te[p->next].hid;
+    ev[n].value = te[p->next].value;
+    n++;
+    p->next++;
+  } while (n < max && p->next < p->tr.n_events && te[p->next].time_ns == te[p->next - 1].time_ns);
+  return n;
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+const struct transport_ops replay_transport = {
+  .name          = "replay",
+  .subsystem     = NULL,
+  .node_prefix   = NULL,
+  .open          = replayOpen,
+  .close         = replayClose,
+  .build_usages  = replayBuildUsages,
+  .check_usages  = NULL,
+  .resolve_usage = NULL,
+  .get_usage     = replayGetUsage,
+  .set_usages    = replaySetUsages,
+  .send_report   = replaySendReport,
+  .read_events   = replayReadEvents,
+};
+
+void replaySetPaced(int on) {
+  paced = on;
+}
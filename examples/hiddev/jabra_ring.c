@@ -0,0 +1,116 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_ring.c
+ *
+ * @brief  Event ring between the reader and the handler thread, see
+ *         jabra_ring.h.
+ *
+ *         The consumer announces that it is going to sleep before it
+ *         checks the ring a last time, and the producer checks that flag
+ *         after publishing a record, with a full barrier on both sides.
+ *         Either the consumer sees the record or the producer sees the
+ *         flag, so a wakeup is never lost and a running consumer costs
+ *         the producer no system call.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "jabra_ring.h"
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int ringInit(struct event_ring *ring) {
+  memset(ring, 0, sizeof(*ring));
+  ring->wakefd = eventfd(0, EFD_CLOEXEC);
+  if (ring->wakefd < 0) {
+    perror("eventfd");
+    return -1;
+  }
+  return 0;
+}
+
+void ringClose(struct event_ring *ring) {
+  if (ring->wakefd >= 0) {
+    close(ring->wakefd);
+    ring->wakefd = -1;
+  }
+}
+
+void ringReserve(struct event_ring *ring, unsigned n) {
+  while (ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) > EVENT_RING_SIZE - n) {
+    ringWake(ring);
+    sched_yield();
+  }
+}
+
+void ringPushControl(struct event_ring *ring, void *dev, int kind) {
+  ringReserve(ring, 1);
+  (void)ringPush(ring, dev, kind, NULL, 0, 0);
+  ringWake(ring);
+}
+
+int ringPushCommand(struct event_ring *ring, void *dev, __u32 code, __s32 arg, __u64 tag) {
+  struct hiddev_event ev;
+
+  if (ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= EVENT_RING_SIZE) {
+    return -1;
+  }
+  ev.hid = code;
+  ev.value = arg;
+  (void)ringPush(ring, dev, RING_COMMAND, &ev, tag, 0);
+  ringWake(ring);
+  return 0;
+}
+
+void ringWake(struct event_ring *ring) {
+  uint64_t one = 1;
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&ring->sleeping, __ATOMIC_RELAXED)) {
+    __atomic_store_n(&ring->sleeping, 0, __ATOMIC_RELAXED);
+    (void)write(ring->wakefd, &one, sizeof(one));
+  }
+}
+
+void ringWait(struct event_ring *ring) {
+  uint64_t count;
+
+  __atomic_store_n(&ring->sleeping, 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&ring->head, __ATOMIC_RELAXED) != ring->tail) {
+    __atomic_store_n(&ring->sleeping, 0, __ATOMIC_RELAXED);
+    return;
+  }
+  (void)read(ring->wakefd, &count, sizeof(count));
+}
@@ -0,0 +1,155 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_ring.h
+ *
+ * @brief  Lock-free single producer, single consumer ring of decoded HID
+ *         events. The reader thread pushes what it reads from the devices
+ *         and never waits for the consumer; when the ring is full the
+ *         event is dropped and counted. The consumer pops in batches and
+ *         sleeps on an eventfd when the ring is empty.
+ */
+
+#ifndef JABRA_RING_H
+#define JABRA_RING_H
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+#include <linux/hiddev.h>
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+
+/* Number of slots, a power of two */
+#define EVENT_RING_SIZE      4096
+
+/* Record kinds */
+#define RING_EVENT           0   /* ev from dev */
+#define RING_DETACH          1   /* dev is gone, no more records for it */
+#define RING_STOP            2   /* consumer should return */
+#define RING_COMMAND         3   /* work for the consumer, code in ev.hid and
+                                  * its argument in ev.value */
+
+struct ring_record {
+  void *dev;
+  int kind;
+  struct hiddev_event ev;
+  union {
+    __u64 wake_ns;        /* reactor wakeup that led to the read */
+    __u64 tag;            /* RING_COMMAND: whom to answer, 0 for nobody */
+  };
+  __u64 read_ns;          /* read() returned */
+};
+
+struct event_ring {
+  /* producer side */
+  unsigned head __attribute__((aligned(64)));
+  unsigned tail_cache;
+  unsigned long pushed;   /* events queued */
+  unsigned long dropped;  /* events lost to a full ring */
+  unsigned high_water;    /* most records ever waiting */
+  /* consumer side */
+  unsigned tail __attribute__((aligned(64)));
+  unsigned head_cache;
+  int sleeping;           /* consumer waits on wakefd */
+  int wakefd;
+  struct ring_record slot[EVENT_RING_SIZE] __attribute__((aligned(64)));
+};
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int ringInit(struct event_ring *ring);
+void ringClose(struct event_ring *ring);
+
+/* producer: queue one record, -1 and counted as dropped if full */
+static inline int ringPush(struct event_ring *ring, void *dev, int kind,
+                           const struct hiddev_event *ev, __u64 wake_ns, __u64 read_ns) {
+  unsigned head = ring->head;
+  unsigned used = head - ring->tail_cache;
+
+  if (used >= EVENT_RING_SIZE) {
+    ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    used = head - ring->tail_cache;
+    if (used >= EVENT_RING_SIZE) {
+      __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+      return -1;
+    }
+  }
+  ring->slot[head & (EVENT_RING_SIZE - 1)].dev = dev;
+  ring->slot[head & (EVENT_RING_SIZE - 1)].kind = kind;
+  if (ev != NULL)
+    ring->slot[head & (EVENT_RING_SIZE - 1)].ev = *ev;
+  ring->slot[head & (EVENT_RING_SIZE - 1)].wake_ns = wake_ns;
+  ring->slot[head & (EVENT_RING_SIZE - 1)].read_ns = read_ns;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  if (kind == RING_EVENT)
+    __atomic_store_n(&ring->pushed, ring->pushed + 1, __ATOMIC_RELAXED);
+  if (used + 1 > ring->high_water) {
+    /* used is only an upper bound while tail_cache is old */
+    ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    used = head - ring->tail_cache;
+    if (used + 1 > ring->high_water)
+      __atomic_store_n(&ring->high_water, used + 1, __ATOMIC_RELAXED);
+  }
+  return 0;
+}
+
+/* producer: wait until n more records fit, for sources that can be held
+ * back instead of losing events, like a replayed trace */
+void ringReserve(struct event_ring *ring, unsigned n);
+
+/* producer: queue a record that must not be lost, waits for room */
+void ringPushControl(struct event_ring *ring, void *dev, int kind);
+
+/* producer: queue a command and wake the consumer, -1 if the ring is
+ * full. Never waits, so the reader stays free of the consumer's work */
+int ringPushCommand(struct event_ring *ring, void *dev, __u32 code, __s32 arg, __u64 tag);
+
+/* producer: wake the consumer after pushing, cheap if it is running */
+void ringWake(struct event_ring *ring);
+
+/* consumer: take up to max records, 0 if the ring is empty */
+static inline int ringPop(struct event_ring *ring, struct ring_record *rec, int max) {
+  unsigned tail = ring->tail;
+  int n = 0;
+
+  if (tail == ring->head_cache) {
+    ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  }
+  while (n < max && tail != ring->head_cache) {
+    rec[n++] = ring->slot[tail & (EVENT_RING_SIZE - 1)];
+    tail++;
+  }
+  __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+  return n;
+}
+
+/* consumer: block until records are waiting */
+void ringWait(struct event_ring *ring);
+
+#endif /* JABRA_RING_H */
@@ -0,0 +1,249 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_ring_test.c
+ *
+ * @brief  Test of the event ring of jabra_ring.h under load. A producer
+ *         pushes events of several sources with plain ringPush(), each
+ *         with its own sequence number as value, to a consumer thread
+ *         that pops in batches and sleeps in ringWait(). The test checks:
+ *           - that every event pushed is received or counted as dropped,
+ *             and the sequence of each source arrives in order;
+ *           - that nothing is dropped while the consumer keeps up, with
+ *             the producer going on as soon as the ring has drained;
+ *           - that a ring overfilled without a consumer drops exactly
+ *             the events that did not fit and reports a full high water;
+ *           - the same counts at full rate, where the producer never
+ *             waits and events are lost whenever the consumer is behind.
+ *
+ *         Usage: jabra_ring_test [-n events], run by make check.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jabra_ring.h"
+#include "jabra_test.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+#define SOURCES              16
+#define BURST                (EVENT_RING_SIZE / 4)
+
+/* what the consumer thread saw */
+struct consumer {
+  struct event_ring *ring;
+  unsigned long received;
+  unsigned long reordered;   /* a value not above the last of its source */
+  unsigned long gaps;        /* a value that skipped some of its source */
+  __s32 last[SOURCES];
+};
+
+/****************************************************************************/
+/*                              PRIVATE DATA                                */
+/****************************************************************************/
+static struct event_ring ring;
+static unsigned long events = 2000000;
+
+/* the sources, only their addresses are used */
+static char source[SOURCES];
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static void consume(struct consumer *c, const struct ring_record *rec) {
+  int s = (const char *) rec->dev - source;
+
+  if (rec->ev.value <= c->last[s]) {
+    c->reordered++;
+  } else if (rec->ev.value != c->last[s] + 1) {
+    c->gaps++;
+  }
+  c->last[s] = rec->ev.value;
+  c->received++;
+}
+
+static void* consumer_thread(void *ptr) {
+  struct consumer *c = ptr;
+  struct ring_record rec[64];
+
+  for (;;) {
+    int n = ringPop(c->ring, rec, sizeof(rec) / sizeof(rec[0]));
+    if (n == 0) {
+      ringWait(c->ring);
+      continue;
+    }
+    for (int i = 0; i < n; i++) {
+      if (rec[i].kind == RING_STOP) {
+        return NULL;
+      }
+      consume(c, &rec[i]);
+    }
+  }
+}
+
+static void startConsumer(struct consumer *c, pthread_t *thread) {
+  memset(c, 0, sizeof(*c));
+  memset(c->last, 0xFF, sizeof(c->last));  /* -1, the first value is 0 */
+  c->ring = &ring;
+  if (ringInit(&ring) < 0 || pthread_create(thread, NULL, consumer_thread, c)) {
+    fprintf(stderr, "Error starting the consumer\n");
+    exit(1);
+  }
+}
+
+static void stopConsumer(pthread_t thread) {
+  ringPushControl(&ring, NULL, RING_STOP);
+  (void)pthread_join(thread, NULL);
+  ringClose(&ring);
+}
+
+static void pushEvent(unsigned long i, __s32 *seq) {
+  struct hiddev_event ev;
+  int s = i % SOURCES;
+
+  ev.hid = s;
+  ev.value = seq[s]++;
+  (void)ringPush(&ring, &source[s], RING_EVENT, &ev, 0, 0);
+  if ((i & 63) == 63) {
+    ringWake(&ring);
+  }
+}
+
+/* the counts that hold whether or not events were dropped */
+static void checkCounts(const char *name, const struct consumer *c) {
+  fprintf(stdout, "jabra_ring_test: %s: %lu events, %lu dropped, high water %u\n",
+    name, events, ring.dropped, ring.high_water);
+  CHECK_EQ(events, c->received + ring.dropped);
+  CHECK_EQ(ring.pushed, c->received);
+  CHECK_EQ(c->reordered, 0);
+  CHECK(c->gaps <= ring.dropped);
+  CHECK(ring.high_water <= EVENT_RING_SIZE);
+}
+
+/* bursts the consumer takes before the next one starts */
+static void testKeepingUp(void) {
+  struct consumer c;
+  pthread_t thread;
+  __s32 seq[SOURCES] = { 0 };
+
+  startConsumer(&c, &thread);
+  for (unsigned long i = 0; i < events; i++) {
+    pushEvent(i, seq);
+    if (i % BURST == BURST - 1) {
+      ringWake(&ring);
+      while (__atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) != ring.head) {
+        sched_yield();
+      }
+    }
+  }
+  stopConsumer(thread);
+  checkCounts("keeping up", &c);
+  CHECK_EQ(ring.dropped, 0);
+  CHECK_EQ(c.gaps, 0);
+  CHECK(ring.high_water <= BURST);
+}
+
+/* more than fits before the consumer runs */
+static void testOverflow(void) {
+  struct consumer c;
+  __s32 seq[SOURCES] = { 0 };
+  unsigned long saved = events;
+
+  if (ringInit(&ring) < 0) {
+    exit(1);
+  }
+  events = EVENT_RING_SIZE + 100;
+  for (unsigned long i = 0; i < events; i++) {
+    pushEvent(i, seq);
+  }
+  CHECK_EQ(ring.dropped, 100);
+  CHECK_EQ(ring.pushed, EVENT_RING_SIZE);
+  CHECK_EQ(ring.high_water, EVENT_RING_SIZE);
+
+  /* drain it, the events that fitted come out in order */
+  memset(&c, 0, sizeof(c));
+  memset(c.last, 0xFF, sizeof(c.last));
+  c.ring = &ring;
+  for (;;) {
+    struct ring_record rec[64];
+    int n = ringPop(&ring, rec, sizeof(rec) / sizeof(rec[0]));
+    if (n == 0) {
+      break;
+    }
+    for (int i = 0; i < n; i++) {
+      consume(&c, &rec[i]);
+    }
+  }
+  checkCounts("overflow", &c);
+  CHECK_EQ(c.gaps, 0);
+  ringClose(&ring);
+  events = saved;
+}
+
+/* the producer never waits */
+static void testFullRate(void) {
+  struct consumer c;
+  pthread_t thread;
+  __s32 seq[SOURCES] = { 0 };
+
+  startConsumer(&c, &thread);
+  for (unsigned long i = 0; i < events; i++) {
+    pushEvent(i, seq);
+  }
+  stopConsumer(thread);
+  checkCounts("full rate", &c);
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int main(int argc, char **argv) {
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:")) != -1) {
+    switch (opt) {
+      case 'n':
+        events = strtoul(optarg, NULL, 0);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-n events]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  testKeepingUp();
+  testOverflow();
+  testFullRate();
+  return testResult("jabra_ring_test");
+}
@@ -0,0 +1,263 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_shm.c
+ *
+ * @brief  Shared memory state page, see jabra_shm.h.
+ *
+ *         Both the slots and the ring records are written like a seqlock:
+ *         the sequence word is invalidated, a release fence orders that
+ *         before the data, and the final sequence is stored with release
+ *         semantics. Writers are serialized by the publisher lock, since
+ *         events come from the event loop and the handler thread.
+ *
+ *         The writer bumps change and then reads waiters, a sleeping
+ *         observer bumps waiters and then reads change, with a full
+ *         barrier on both sides: either the writer sees the observer and
+ *         wakes it, or FUTEX_WAIT sees the new change and returns.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jabra_latency.h"
+#include "jabra_shm.h"
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static long futex(const __u32 *uaddr, int op, __u32 val, const struct timespec *timeout) {
+  return syscall(SYS_futex, uaddr, op, val, timeout, NULL, 0);
+}
+
+static void writeSlot(struct shm_device *d, __u32 present, __u32 state,
+                      const struct jabra_device *dev) {
+  __u32 seq = __atomic_load_n(&d->seq, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&d->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&d->present, present, __ATOMIC_RELAXED);
+  __atomic_store_n(&d->state, state, __ATOMIC_RELAXED);
+  if (dev != NULL) {
+    __atomic_store_n(&d->vendor, dev->devinfo.vendor, __ATOMIC_RELAXED);
+    __atomic_store_n(&d->product, dev->devinfo.product, __ATOMIC_RELAXED);
+    snprintf(d->name, sizeof(d->name), "%.*s", (int) sizeof(d->name) - 1, dev->name);
+  }
+  __atomic_store_n(&d->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void writeRecord(struct shm_page *page, const struct ctl_msg *msg) {
+  __u32 pos = __atomic_load_n(&page->head, __ATOMIC_RELAXED);
+  struct shm_record *r = &page->ring[pos & (SHM_RING_SIZE - 1)];
+
+  __atomic_store_n(&r->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&r->time_ns, latencyNow(), __ATOMIC_RELAXED);
+  __atomic_store_n(&r->value, msg->value, __ATOMIC_RELAXED);
+  __atomic_store_n(&r->type, msg->type, __ATOMIC_RELAXED);
+  __atomic_store_n(&r->device, msg->device, __ATOMIC_RELAXED);
+  __atomic_store_n(&r->seq, pos + 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&page->head, pos + 1, __ATOMIC_RELEASE);
+}
+
+/* 0 if path does not exist or is a state page that may be replaced */
+static int replaceable(const char *path) {
+  struct stat st;
+  __u32 magic = 0;
+  int fd, n;
+
+  if (lstat(path, &st) < 0) {
+    return errno == ENOENT ? 0 : -1;
+  }
+  if (!S_ISREG(st.st_mode) || (fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC)) < 0) {
+    return -1;
+  }
+  n = read(fd, &magic, sizeof(magic));
+  close(fd);
+  return (n == sizeof(magic) && magic == SHM_MAGIC) ? 0 : -1;
+}
+
+/* bump the futex word and wake whoever sleeps on it, no system call
+ * when nobody does */
+static void announce(struct shm_page *page) {
+  __atomic_fetch_add(&page->change, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&page->waiters, __ATOMIC_SEQ_CST) != 0) {
+    (void)futex(&page->change, FUTEX_WAKE, INT_MAX, NULL);
+  }
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int shmOpen(struct shm_publisher *pub, const char *path) {
+  void *map;
+  int fd;
+
+  pub->page = NULL;
+  snprintf(pub->path, sizeof(pub->path), "%s", path);
+  pthread_mutex_init(&pub->lock, NULL);
+
+  /* a new file, observers of a previous run keep their old mapping */
+  if (replaceable(path) < 0) {
+    fprintf(stderr, "%s: exists and is not a state page, not replaced\n", path);
+    return -1;
+  }
+  (void)unlink(path);
+  if ((fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0644)) < 0) {
+    perror(path);
+    return -1;
+  }
+  if (ftruncate(fd, sizeof(struct shm_page)) < 0) {
+    perror(path);
+    close(fd);
+    (void)unlink(path);
+    return -1;
+  }
+  map = mmap(NULL, sizeof(struct shm_page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror(path);
+    (void)unlink(path);
+    return -1;
+  }
+
+  pub->page = map;
+  pub->page->format    = SHM_FORMAT;
+  pub->page->n_devices = MAX_DEVICES;
+  pub->page->ring_size = SHM_RING_SIZE;
+  pub->page->alive     = 1;
+  /* observers check the magic last */
+  __atomic_store_n(&pub->page->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+  return 0;
+}
+
+void shmClose(struct shm_publisher *pub) {
+  if (pub->page == NULL) {
+    return;
+  }
+  __atomic_store_n(&pub->page->alive, 0, __ATOMIC_RELEASE);
+  announce(pub->page);
+  munmap(pub->page, sizeof(struct shm_page));
+  pub->page = NULL;
+  (void)unlink(pub->path);
+  pthread_mutex_destroy(&pub->lock);
+}
+
+void shmPublish(struct shm_publisher *pub, const struct ctl_msg *msg,
+                const struct jabra_device *dev) {
+  struct shm_page *page = pub->page;
+
+  /* CTL_DEVICE_SELECTED or a bad index has no slot, and observers
+   * could not tell which device the event was about */
+  if (page == NULL || msg->device >= MAX_DEVICES) {
+    return;
+  }
+  (void)pthread_mutex_lock(&pub->lock);
+  switch (msg->type) {
+    case CTL_STATE:
+      writeSlot(&page->device[msg->device], 1, msg->value, NULL);
+      break;
+    case CTL_ATTACH:
+      writeSlot(&page->device[msg->device], 1, dev ? callState(dev) & CALL_FLAGS : 0, dev);
+      break;
+    case CTL_DETACH:
+      writeSlot(&page->device[msg->device], 0, 0, NULL);
+      break;
+    default:
+      break;
+  }
+  writeRecord(page, msg);
+  announce(page);
+  (void)pthread_mutex_unlock(&pub->lock);
+}
+
+int shmAttach(struct shm_observer *obs, const char *path) {
+  const struct shm_page *page;
+  void *map;
+  int fd;
+
+  obs->page = NULL;
+  obs->writable = 1;
+  if ((fd = open(path, O_RDWR | O_CLOEXEC)) < 0 && errno == EACCES) {
+    obs->writable = 0;
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+  }
+  if (fd < 0) {
+    perror(path);
+    return -1;
+  }
+  map = mmap(NULL, sizeof(struct shm_page),
+    obs->writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror(path);
+    return -1;
+  }
+  page = map;
+  if (__atomic_load_n(&page->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC ||
+      page->format != SHM_FORMAT || page->n_devices != MAX_DEVICES ||
+      page->ring_size != SHM_RING_SIZE) {
+    fprintf(stderr, "%s: not a state page of this version\n", path);
+    munmap(map, sizeof(struct shm_page));
+    return -1;
+  }
+  obs->page = page;
+  return 0;
+}
+
+void shmDetach(struct shm_observer *obs) {
+  munmap((void *)obs->page, sizeof(struct shm_page));
+  obs->page = NULL;
+}
+
+void shmWait(struct shm_observer *obs, __u32 seen) {
+  static const struct timespec poll = { 0, SHM_POLL_MS * 1000000L };
+  struct shm_page *page = (struct shm_page *)obs->page;
+
+  if (!__atomic_load_n(&page->alive, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+  if (!obs->writable) {
+    (void)futex(&page->change, FUTEX_WAIT, seen, &poll);
+    return;
+  }
+  __atomic_fetch_add(&page->waiters, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&page->change, __ATOMIC_SEQ_CST) == seen) {
+    (void)futex(&page->change, FUTEX_WAIT, seen, NULL);
+  }
+  __atomic_fetch_sub(&page->waiters, 1, __ATOMIC_SEQ_CST);
+}
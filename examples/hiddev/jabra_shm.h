@@ -0,0 +1,213 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_shm.h
+ *
+ * @brief  Shared memory state page for observers that must not pay a
+ *         system call per query. The program publishes into one file,
+ *         normally below /dev/shm, that observers map read-only:
+ *
+ *         - one slot per registry index with the call state, ids and
+ *           name of the device, each behind its own seqlock;
+ *         - a broadcast ring of the same events the control socket
+ *           notifies (CTL_STATE, CTL_VOLUME, CTL_ATTACH, CTL_DETACH),
+ *           each observer reads it at its own pace with its own cursor
+ *           and the writer never waits, so a slow observer is lapped
+ *           and told how many events it lost;
+ *         - a change counter that is bumped after every update, an
+ *           observer that has nothing to do sleeps on it with
+ *           shmWait(), a futex wait.
+ *
+ *         Reading a slot or the ring is done with the inline functions
+ *         below and makes no system call. An observer that may write
+ *         the file counts itself in waiters while it sleeps, and the
+ *         writer only calls FUTEX_WAKE when someone does. An observer
+ *         without write access maps the page read-only and wakes up on
+ *         its own every SHM_POLL_MS instead.
+ */
+
+#ifndef JABRA_SHM_H
+#define JABRA_SHM_H
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "jabra_control.h"
+#include "jabra_device.h"
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+#define SHM_MAGIC            0x4D48534A  /* "JSHM" */
+#define SHM_FORMAT           2
+#define SHM_RING_SIZE        1024        /* a power of two */
+#define SHM_POLL_MS          10          /* sleep of read-only observers */
+#define SHM_READ_TRIES       100000      /* before a slot counts as broken */
+
+/* State of one registry index, 64 bytes so no two share a cache line */
+struct shm_device {
+  __u32 seq;             /* odd while the slot is written */
+  __u32 present;
+  __u32 state;           /* CALL_HOOK, CALL_MUTE, CALL_RING */
+  __u16 vendor;
+  __u16 product;
+  char  name[48];
+} __attribute__((aligned(64)));
+
+/* One event, valid when seq is its position in the ring plus one */
+struct shm_record {
+  __u64 time_ns;         /* CLOCK_MONOTONIC */
+  __u32 seq;
+  __s32 value;
+  __u8  type;            /* CTL_STATE, CTL_VOLUME, CTL_ATTACH, CTL_DETACH */
+  __u8  device;
+  __u16 reserved;
+  __u32 reserved2;
+};
+
+struct shm_page {
+  __u32 magic;
+  __u16 format;
+  __u16 n_devices;
+  __u32 ring_size;
+  __u32 alive;           /* cleared when the program exits */
+  __u32 change __attribute__((aligned(64)));  /* futex word */
+  __u32 waiters;         /* observers sleeping on change */
+  __u32 head __attribute__((aligned(64)));    /* events ever published */
+  struct shm_device device[MAX_DEVICES];
+  struct shm_record ring[SHM_RING_SIZE];
+};
+
+/* Observer side, process local */
+struct shm_observer {
+  const struct shm_page *page;
+  int writable;          /* can count itself in page->waiters */
+};
+
+/* Writer side, process local */
+struct shm_publisher {
+  struct shm_page *page; /* NULL if not publishing */
+  char path[256];
+  pthread_mutex_t lock;  /* one writer at a time */
+};
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+
+/* create and map the page at path, -1 on failure. An existing file is
+ * only replaced if it is a state page, anything else is left alone */
+int shmOpen(struct shm_publisher *pub, const char *path);
+/* clear alive, wake the observers and remove the file */
+void shmClose(struct shm_publisher *pub);
+
+/* update the slot of msg->device for CTL_STATE, CTL_ATTACH and CTL_DETACH
+ * and add msg to the ring, any thread. name and the ids of dev are used
+ * for CTL_ATTACH */
+void shmPublish(struct shm_publisher *pub, const struct ctl_msg *msg,
+                const struct jabra_device *dev);
+
+/* observer: map the page at path, writable if the file allows it so
+ * that shmWait() can be woken, -1 on failure */
+int shmAttach(struct shm_observer *obs, const char *path);
+void shmDetach(struct shm_observer *obs);
+
+/* observer: sleep until page->change differs from seen, or at most
+ * SHM_POLL_MS if the page is read-only */
+void shmWait(struct shm_observer *obs, __u32 seen);
+
+/* observer: consistent copy of slot index, 0 if a device is present.
+ * -1 with present cleared as well if no consistent copy was had within
+ * SHM_READ_TRIES, as when the writer died in the middle of an update */
+static inline int shmReadDevice(const struct shm_page *page, int index, struct shm_device *out) {
+  const struct shm_device *d = &page->device[index];
+  int tries = 0;
+  __u32 s1, s2;
+
+  do {
+    while ((s1 = __atomic_load_n(&d->seq, __ATOMIC_ACQUIRE)) & 1) {
+      if (++tries >= SHM_READ_TRIES) {
+        out->present = 0;
+        return -1;
+      }
+    }
+    out->present = __atomic_load_n(&d->present, __ATOMIC_RELAXED);
+    out->state   = __atomic_load_n(&d->state, __ATOMIC_RELAXED);
+    out->vendor  = __atomic_load_n(&d->vendor, __ATOMIC_RELAXED);
+    out->product = __atomic_load_n(&d->product, __ATOMIC_RELAXED);
+    memcpy(out->name, d->name, sizeof(out->name));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    s2 = __atomic_load_n(&d->seq, __ATOMIC_RELAXED);
+  } while (s1 != s2 && ++tries < SHM_READ_TRIES);
+  if (s1 != s2) {
+    out->present = 0;
+    return -1;
+  }
+  out->seq = s1;
+  out->name[sizeof(out->name) - 1] = '\0';
+  return out->present ? 0 : -1;
+}
+
+/* observer: next event after *cursor (start with page->head). Returns 1
+ * with rec filled, 0 if there is none yet, or the number of events lost
+ * as a negative value when the writer lapped the cursor, which is then
+ * moved to the oldest event still in the ring */
+static inline int shmReadEvent(const struct shm_page *page, __u32 *cursor, struct shm_record *rec) {
+  __u32 head = __atomic_load_n(&page->head, __ATOMIC_ACQUIRE);
+  const struct shm_record *r;
+  __u32 lost;
+
+  if (head == *cursor) {
+    return 0;
+  }
+  if (head - *cursor > SHM_RING_SIZE) {
+    lost = head - *cursor - SHM_RING_SIZE;
+    *cursor = head - SHM_RING_SIZE;
+    return -(int) lost;
+  }
+  r = &page->ring[*cursor & (SHM_RING_SIZE - 1)];
+  rec->seq = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+  rec->time_ns = __atomic_load_n(&r->time_ns, __ATOMIC_RELAXED);
+  rec->value   = __atomic_load_n(&r->value, __ATOMIC_RELAXED);
+  rec->type    = __atomic_load_n(&r->type, __ATOMIC_RELAXED);
+  rec->device  = __atomic_load_n(&r->device, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (rec->seq != *cursor + 1 || __atomic_load_n(&r->seq, __ATOMIC_RELAXED) != rec->seq) {
+    /* overwritten while being read */
+    head = __atomic_load_n(&page->head, __ATOMIC_ACQUIRE);
+    lost = head - *cursor - SHM_RING_SIZE + 1;
+    *cursor = head - SHM_RING_SIZE + 1;
+    return -(int) lost;
+  }
+  (*cursor)++;
+  return 1;
+}
+
+#endif /* JABRA_SHM_H */
@@ -0,0 +1,286 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_shm_test.c
+ *
+ * @brief  Test of the shared memory state page of jabra_shm.h, with an
+ *         observer that maps the page with shmAttach() like another
+ *         process would. The test checks:
+ *           - that events are read in order with their fields, and that
+ *             events of no registry index are not published;
+ *           - that an observer lapped by the writer is told how many
+ *             events it lost and then reads on in order;
+ *           - that no slot is ever seen half written while a writer
+ *             thread keeps rewriting it;
+ *           - that a slot left half written by a writer that died is
+ *             given up on rather than waited for;
+ *           - that shmOpen() replaces the page of an earlier run but
+ *             neither another file nor a symbolic link;
+ *           - that shmWait() counts itself in waiters while it sleeps,
+ *             returns on a publish from another thread, and once the
+ *             page is closed.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "jabra_shm.h"
+#include "jabra_test.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+#define SLOT                 3
+#define SLOT_WRITES          200000
+
+/****************************************************************************/
+/*                              PRIVATE DATA                                */
+/****************************************************************************/
+static struct shm_publisher pub;
+static int writing;
+static __u32 slept;      /* waiters seen by late_publisher() */
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static void publish(__u8 type, __u8 device, __s32 value, const struct jabra_device *dev) {
+  struct ctl_msg msg;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.type   = type;
+  msg.device = device;
+  msg.value  = value;
+  shmPublish(&pub, &msg, dev);
+}
+
+static void testEvents(const struct shm_page *page) {
+  __u32 cursor = __atomic_load_n(&page->head, __ATOMIC_ACQUIRE);
+  struct shm_device slot;
+  struct shm_record rec;
+
+  CHECK_EQ(shmReadEvent(page, &cursor, &rec), 0);
+  publish(CTL_STATE, 1, 0x5, NULL);
+  publish(CTL_STATE, CTL_DEVICE_SELECTED, 1, NULL);
+  publish(CTL_VOLUME, 2, -7, NULL);
+  publish(CTL_DETACH, 1, 0, NULL);
+
+  CHECK_EQ(shmReadEvent(page, &cursor, &rec), 1);
+  CHECK_EQ(rec.type, CTL_STATE);
+  CHECK_EQ(rec.device, 1);
+  CHECK_EQ(rec.value, 0x5);
+  CHECK_EQ(shmReadEvent(page, &cursor, &rec), 1);
+  CHECK_EQ(rec.type, CTL_VOLUME);
+  CHECK_EQ(rec.device, 2);
+  CHECK_EQ(rec.value, -7);
+  CHECK_EQ(shmReadEvent(page, &cursor, &rec), 1);
+  CHECK_EQ(rec.type, CTL_DETACH);
+  CHECK_EQ(shmReadEvent(page, &cursor, &rec), 0);
+  CHECK(shmReadDevice(page, 1, &slot) < 0);
+}
+
+static void testLapped(const struct shm_page *page) {
+  __u32 cursor = __atomic_load_n(&page->head, __ATOMIC_ACQUIRE);
+  struct shm_record rec;
+  int n = SHM_RING_SIZE + 100;
+
+  for (int i = 0; i < n; i++) {
+    publish(CTL_VOLUME, 0, i, NULL);
+  }
+  CHECK_EQ(shmReadEvent(page, &cursor, &rec), -100);
+  for (int i = 100; i < n; i++) {
+    if (shmReadEvent(page, &cursor, &rec) != 1 || rec.value != i) {
+      CHECK_EQ(rec.value, i);
+      return;
+    }
+  }
+  CHECK_EQ(shmReadEvent(page, &cursor, &rec), 0);
+}
+
+/* rewrites SLOT with fields that belong together */
+static void *slot_writer(void *arg) {
+  struct jabra_device dev;
+
+  memset(&dev, 0, sizeof(dev));
+  for (__u32 i = 1; i <= SLOT_WRITES; i++) {
+    dev.devinfo.vendor  = i & 0xFFFF;
+    dev.devinfo.product = i & 0xFFFF;
+    dev.callstate = i & CALL_FLAGS;
+    snprintf(dev.name, sizeof(dev.name), "headset %u", i & 0xFFFF);
+    publish(CTL_ATTACH, SLOT, 0, &dev);
+  }
+  __atomic_store_n(&writing, 0, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+static void testSeqlock(const struct shm_page *page) {
+  struct shm_device slot;
+  pthread_t thread;
+  char name[sizeof(slot.name)];
+  unsigned long reads = 0, torn = 0;
+
+  writing = 1;
+  if (pthread_create(&thread, NULL, slot_writer, NULL)) {
+    fprintf(stderr, "Error creating thread\n");
+    test_failures++;
+    return;
+  }
+  while (__atomic_load_n(&writing, __ATOMIC_ACQUIRE)) {
+    if (shmReadDevice(page, SLOT, &slot) < 0) {
+      continue;
+    }
+    snprintf(name, sizeof(name), "headset %u", slot.vendor);
+    if (slot.product != slot.vendor || slot.state != (slot.vendor & CALL_FLAGS) ||
+        strcmp(slot.name, name) != 0) {
+      torn++;
+    }
+    reads++;
+  }
+  pthread_join(thread, NULL);
+  fprintf(stdout, "jabra_shm_test: %lu slot reads during %d writes\n", reads, SLOT_WRITES);
+  CHECK_EQ(torn, 0);
+  CHECK(shmReadDevice(page, SLOT, &slot) == 0);
+  CHECK_EQ(slot.vendor, SLOT_WRITES & 0xFFFF);
+}
+
+/* the writer stopped between the two stores of the slot sequence */
+static void testDeadWriter(const struct shm_page *page) {
+  struct shm_device slot;
+  __u32 seq = pub.page->device[SLOT + 1].seq;
+
+  __atomic_store_n(&pub.page->device[SLOT + 1].seq, seq | 1, __ATOMIC_RELEASE);
+  CHECK(shmReadDevice(page, SLOT + 1, &slot) < 0);
+  CHECK_EQ(slot.present, 0);
+  __atomic_store_n(&pub.page->device[SLOT + 1].seq, seq, __ATOMIC_RELEASE);
+}
+
+/* only a page of an earlier run is replaced */
+static void testReplace(const char *dir) {
+  struct shm_publisher other;
+  char page[256], file[256], link[256];
+  struct stat st;
+  FILE *f;
+
+  snprintf(page, sizeof(page), "%s/jabra_shm_test.%d.page", dir, (int) getpid());
+  snprintf(file, sizeof(file), "%s/jabra_shm_test.%d.file", dir, (int) getpid());
+  snprintf(link, sizeof(link), "%s/jabra_shm_test.%d.link", dir, (int) getpid());
+
+  /* the page of an earlier run */
+  if (shmOpen(&other, page) == 0) {
+    munmap(other.page, sizeof(*other.page));
+    pthread_mutex_destroy(&other.lock);
+  }
+  CHECK_EQ(shmOpen(&other, page), 0);
+  shmClose(&other);
+
+  if ((f = fopen(file, "we")) != NULL) {
+    fprintf(f, "not a state page\n");
+    fclose(f);
+  }
+  CHECK(shmOpen(&other, file) < 0);
+  CHECK(stat(file, &st) == 0 && st.st_size == 17);
+
+  CHECK_EQ(symlink(file, link), 0);
+  CHECK(shmOpen(&other, link) < 0);
+  CHECK(lstat(link, &st) == 0 && S_ISLNK(st.st_mode));
+  CHECK(stat(file, &st) == 0 && st.st_size == 17);
+
+  unlink(link);
+  unlink(file);
+}
+
+/* publishes once the observer sleeps, or after a second */
+static void *late_publisher(void *arg) {
+  const struct shm_page *page = arg;
+
+  for (int i = 0; i < 1000 && __atomic_load_n(&page->waiters, __ATOMIC_ACQUIRE) == 0; i++) {
+    usleep(1000);
+  }
+  __atomic_store_n(&slept, __atomic_load_n(&page->waiters, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+  publish(CTL_STATE, 0, 1, NULL);
+  return NULL;
+}
+
+static void testWait(struct shm_observer *obs) {
+  const struct shm_page *page = obs->page;
+  __u32 seen = __atomic_load_n(&page->change, __ATOMIC_ACQUIRE);
+  pthread_t thread;
+
+  CHECK(obs->writable);
+  if (pthread_create(&thread, NULL, late_publisher, (void *)page)) {
+    fprintf(stderr, "Error creating thread\n");
+    test_failures++;
+    return;
+  }
+  while (__atomic_load_n(&page->change, __ATOMIC_ACQUIRE) == seen) {
+    shmWait(obs, seen);
+  }
+  pthread_join(thread, NULL);
+  CHECK_EQ(slept, 1);
+  CHECK_EQ(page->waiters, 0);
+
+  /* the observer's mapping outlives the file */
+  seen = __atomic_load_n(&page->change, __ATOMIC_ACQUIRE);
+  shmClose(&pub);
+  CHECK_EQ(__atomic_load_n(&page->alive, __ATOMIC_ACQUIRE), 0);
+  CHECK(__atomic_load_n(&page->change, __ATOMIC_ACQUIRE) != seen);
+  shmWait(obs, seen);
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int main(int argc, char **argv) {
+  struct shm_observer obs;
+  const char *dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+  char path[256];
+
+  snprintf(path, sizeof(path), "%s/jabra_shm_test.%d", dir, (int) getpid());
+  if (shmOpen(&pub, path) < 0) {
+    return 1;
+  }
+  if (shmAttach(&obs, path) < 0) {
+    shmClose(&pub);
+    return 1;
+  }
+
+  testEvents(obs.page);
+  testLapped(obs.page);
+  testSeqlock(obs.page);
+  testDeadWriter(obs.page);
+  testReplace(dir);
+  testWait(&obs);
+
+  shmDetach(&obs);
+  CHECK(access(path, F_OK) < 0);
+  return testResult("jabra_shm_test");
+}
@@ -0,0 +1,398 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_sim.c
+ *
+ * @brief  Simulated transport, an in-process headset for load tests on
+ *         machines without USB hardware. It answers the same operations
+ *         as a hiddev device: the usage layout comes from one of the
+ *         report layouts below instead of HIDIOCGFIELDINFO, usage values
+ *         are kept like HIDIOCGUSAGE/HIDIOCSUSAGE would, an output report
+ *         takes the configured transfer time like HIDIOCSREPORT, and
+ *         button presses are read as struct hiddev_event.
+ *
+ *         The device path is "sim<n>:<layout>[,<option>...]", <n> only
+ *         tells the devices apart. Options:
+ *           latency=<us>   time each output report takes, default 0
+ *           period=<us>    time between script steps, default 10000
+ *           repeat=<n>     script rounds before the device goes away,
+ *                          0 runs until stopped, default 1
+ *           script=<steps> h toggles the hook switch, m presses mute,
+ *                          + and - press volume up and down, . waits,
+ *                          default "hmmh"
+ *         Every system call the device stands in for is counted in the
+ *         device's call statistics.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jabra_device.h"
+#include "jabra_hid.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+#define SIM_MAX_USAGES       4
+#define SIM_SCRIPT           32
+
+#define TEL(code)            ((TelephonyUsagePage << 16) | (code))
+#define LED(code)            ((LEDUsagePage << 16) | (code))
+#define CON(code)            ((ConsumerUsagePage << 16) | (code))
+
+struct sim_field {
+  __u32 report_type;
+  __u32 report_id;
+  __s32 logical_minimum;
+  __s32 logical_maximum;
+  int n_usages;
+  __u32 usage[SIM_MAX_USAGES];
+};
+
+struct sim_layout {
+  const char *name;
+  __u16 product;
+  int n_fields;
+  const struct sim_field *field;
+};
+
+/* Value of one usage as the simulated device sees it */
+struct sim_value {
+  __u32 report_type;
+  __u32 report_id;
+  __u32 field_index;
+  __u32 usage_index;
+  __s32 pending;         /* set, not yet sent */
+  __s32 current;         /* last sent with its report */
+};
+
+struct sim_priv {
+  const struct sim_layout *layout;
+  int n_values;
+  struct sim_value value[MAX_CACHED_USAGES];
+  __u64 latency_ns;
+  __u64 period_ns;
+  unsigned long repeat;
+  char script[SIM_SCRIPT];
+  int step;              /* next script step */
+  unsigned long rounds;  /* script rounds completed */
+  int hook;
+  unsigned long steps;
+  unsigned long events;
+  unsigned long reports;
+  __u64 start_ns;
+};
+
+/****************************************************************************/
+/*                              PRIVATE DATA                                */
+/****************************************************************************/
+
+/* all LEDs and the ringer in one output report */
+static const struct sim_field basic_fields[] = {
+  { HID_REPORT_TYPE_INPUT,  1, 0, 1, 2, { TEL(Tel_Hook_Switch), TEL(Tel_Phone_Mute) } },
+  { HID_REPORT_TYPE_INPUT,  1, 0, 1, 2, { CON(Con_Volume_Incr), CON(Con_Volume_Decr) } },
+  { HID_REPORT_TYPE_OUTPUT, 2, 0, 1, 3, { LED(Led_Mute), LED(Led_Off_Hook), LED(Led_Ring) } },
+  { HID_REPORT_TYPE_OUTPUT, 2, 0, 1, 1, { TEL(Tel_Ringer) } },
+};
+
+/* one output report per LED, a call state change costs several transfers */
+static const struct sim_field split_fields[] = {
+  { HID_REPORT_TYPE_INPUT,  1, 0, 1, 2, { TEL(Tel_Hook_Switch), TEL(Tel_Phone_Mute) } },
+  { HID_REPORT_TYPE_INPUT,  1, 0, 1, 2, { CON(Con_Volume_Incr), CON(Con_Volume_Decr) } },
+  { HID_REPORT_TYPE_OUTPUT, 2, 0, 1, 1, { LED(Led_Off_Hook) } },
+  { HID_REPORT_TYPE_OUTPUT, 3, 0, 1, 1, { LED(Led_Mute) } },
+  { HID_REPORT_TYPE_OUTPUT, 4, 0, 1, 1, { LED(Led_Ring) } },
+  { HID_REPORT_TYPE_OUTPUT, 4, 0, 1, 1, { TEL(Tel_Ringer) } },
+};
+
+static const struct sim_layout layouts[] = {
+  { "basic", 0x0001, sizeof(basic_fields) / sizeof(basic_fields[0]), basic_fields },
+  { "split", 0x0002, sizeof(split_fields) / sizeof(split_fields[0]), split_fields },
+};
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static int parseSpec(struct sim_priv *p, const char *path) {
+  char spec[64];
+  char *opt, *save = NULL;
+  const char *colon = strchr(path, ':');
+
+  snprintf(spec, sizeof(spec), "%s", colon ? colon + 1 : "");
+  p->period_ns = 10000000ull;
+  p->repeat = 1;
+  snprintf(p->script, sizeof(p->script), "hmmh");
+
+  for (opt = strtok_r(spec, ",", &save); opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+    if (p->layout == NULL) {
+      for (int i = 0; i < (int) (sizeof(layouts) / sizeof(layouts[0])); i++) {
+        if (strcmp(opt, layouts[i].name) == 0)
+          p->layout = &layouts[i];
+      }
+      if (p->layout == NULL) {
+        fprintf(stderr, "%s: unknown layout \"%s\"\n", path, opt);
+        return -1;
+      }
+    } else if (strncmp(opt, "latency=", 8) == 0) {
+      p->latency_ns = strtoull(opt + 8, NULL, 10) * 1000ull;
+    } else if (strncmp(opt, "period=", 7) == 0) {
+      p->period_ns = strtoull(opt + 7, NULL, 10) * 1000ull;
+    } else if (strncmp(opt, "repeat=", 7) == 0) {
+      p->repeat = strtoul(opt + 7, NULL, 10);
+    } else if (strncmp(opt, "script=", 7) == 0 && opt[7] != '\0') {
+      snprintf(p->script, sizeof(p->script), "%s", opt + 7);
+    } else {
+      fprintf(stderr, "%s: unknown option \"%s\"\n", path, opt);
+      return -1;
+    }
+  }
+  if (p->layout == NULL || p->period_ns == 0) {
+    fprintf(stderr, "%s: expected sim<n>:<layout>[,<option>...]\n", path);
+    return -1;
+  }
+  return 0;
+}
+
+static struct sim_value *findValue(struct sim_priv *p, const struct usage_entry *u) {
+  for (int i = 0; i < p->n_values; i++) {
+    struct sim_value *v = &p->value[i];
+    if (v->report_type == u->report_type && v->report_id == u->report_id &&
+        v->field_index == u->field_index && v->usage_index == u->usage_index) {
+      return v;
+    }
+  }
+  return NULL;
+}
+
+/* run one script step, returns the number of events stored (at most 2) */
+static int scriptStep(struct sim_priv *p, struct hiddev_event *ev) {
+  int n = 0;
+
+  switch (p->script[p->step]) {
+    case 'h':
+      p->hook = !p->hook;
+      ev[n].hid = TEL(Tel_Hook_Switch); ev[n++].value = p->hook;
+      break;
+    case 'm':
+      ev[n].hid = TEL(Tel_Phone_Mute); ev[n++].value = 1;
+      ev[n].hid = TEL(Tel_Phone_Mute); ev[n++].value = 0;
+      break;
+    case '+':
+    case '-': {
+      __u32 hid = p->script[p->step] == '+' ? CON(Con_Volume_Incr) : CON(Con_Volume_Decr);
+      ev[n].hid = hid; ev[n++].value = 1;
+      ev[n].hid = hid; ev[n++].value = 0;
+      break;
+    }
+    default:
+      break;
+  }
+  p->steps++;
+  if (p->script[++p->step] == '\0') {
+    p->step = 0;
+    p->rounds++;
+  }
+  return n;
+}
+
+static int simOpen(struct jabra_device *dev) {
+  struct sim_priv *p;
+  struct itimerspec its;
+
+  if ((p = calloc(1, sizeof(*p))) == NULL) {
+    perror("calloc");
+    return -1;
+  }
+  if (parseSpec(p, dev->path) < 0) {
+    free(p);
+    return -1;
+  }
+  if ((dev->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+    perror(dev->path);
+    free(p);
+    return -1;
+  }
+  its.it_interval.tv_sec  = p->period_ns / 1000000000ull;
+  its.it_interval.tv_nsec = p->period_ns % 1000000000ull;
+  its.it_value = its.it_interval;
+  (void)timerfd_settime(dev->fd, 0, &its, NULL);
+  p->start_ns = latencyNow();
+  dev->priv = p;
+
+  memset(&dev->devinfo, 0, sizeof(dev->devinfo));
+  dev->devinfo.vendor  = JABRA_VID;
+  dev->devinfo.product = p->layout->product;
+  dev->devinfo.version = 0x0100;
+  snprintf(dev->name, sizeof(dev->name), "Simulated %s headset", p->layout->name);
+  return 0;
+}
+
+static void simClose(struct jabra_device *dev) {
+  struct sim_priv *p = dev->priv;
+
+  /* a device that was never attached, as in the benchmarks, is quiet */
+  if (dev->index >= 0)
+    fprintf(stdout, "[%d] Simulated %lu steps, %lu events, %lu output reports in %.3f s\n",
+      dev->index, p->steps, p->events, p->reports, (latencyNow() - p->start_ns) / 1e9);
+  close(dev->fd);
+  free(p);
+}
+
+/* stands in for the HIDIOCGFIELDINFO and HIDIOCGUCODE walk */
+static void simBuildUsages(struct jabra_device *dev) {
+  struct sim_priv *p = dev->priv;
+  const struct sim_layout *l = p->layout;
+  struct hiddev_field_info finfo;
+
+  dev->usages.count = 0;
+  dev->usages.skipped = 0;
+  p->n_values = 0;
+  for (int i = 0; i < l->n_fields; i++) {
+    const struct sim_field *f = &l->field[i];
+
+    memset(&finfo, 0, sizeof(finfo));
+    finfo.report_type     = f->report_type;
+    finfo.report_id       = f->report_id;
+    finfo.maxusage        = f->n_usages;
+    finfo.logical_minimum = f->logical_minimum;
+    finfo.logical_maximum = f->logical_maximum;
+    /* fields are numbered within their report */
+    for (int j = 0; j < i; j++) {
+      if (l->field[j].report_type == f->report_type && l->field[j].report_id == f->report_id)
+        finfo.field_index++;
+    }
+    if (!usagesFit(&dev->usages, f->n_usages)) {
+      continue;
+    }
+    for (int j = 0; j < f->n_usages; j++) {
+      struct sim_value *v = &p->value[p->n_values++];
+
+      v->report_type = f->report_type;
+      v->report_id   = f->report_id;
+      v->field_index = finfo.field_index;
+      v->usage_index = j;
+      (void)addUsage(&dev->usages, &finfo, j, f->usage[j]);
+    }
+  }
+}
+
+static int simGetUsage(struct jabra_device *dev, const struct usage_entry *u, __s32 *value) {
+  struct sim_priv *p = dev->priv;
+  struct sim_value *v = findValue(p, u);
+  __u64 t0 = latencyNow();
+
+  *value = v ? v->current : 0;
+  deviceAccount(dev, DEVCALL_GUSAGE, t0, v == NULL);
+  return v ? 0 : -1;
+}
+
+static int simSetUsages(struct jabra_device *dev, const struct usage_entry *u,
+                        const __s32 *values, int n) {
+  struct sim_priv *p = dev->priv;
+  struct usage_entry next = *u;
+  __u64 t0 = latencyNow();
+  int failed = 0;
+
+  for (int i = 0; i < n; i++, next.usage_index++) {
+    struct sim_value *v = findValue(p, &next);
+    if (v == NULL) {
+      failed = 1;
+      break;
+    }
+    v->pending = values[i];
+  }
+  deviceAccount(dev, n > 1 ? DEVCALL_SUSAGES : DEVCALL_SUSAGE, t0, failed);
+  return failed ? -1 : 0;
+}
+
+/* the output report is a USB transfer taking latency_ns */
+static int simSendReport(struct jabra_device *dev, __u32 report_type, __u32 report_id) {
+  struct sim_priv *p = dev->priv;
+  struct timespec ts;
+  __u64 t0 = latencyNow();
+
+  for (int i = 0; i < p->n_values; i++) {
+    struct sim_value *v = &p->value[i];
+    if (v->report_type == report_type && v->report_id == report_id)
+      v->current = v->pending;
+  }
+  if (p->latency_ns != 0) {
+    ts.tv_sec  = p->latency_ns / 1000000000ull;
+    ts.tv_nsec = p->latency_ns % 1000000000ull;
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR);
+  }
+  p->reports++;
+  deviceAccount(dev, DEVCALL_SREPORT, t0, 0);
+  return 0;
+}
+
+/* one script step per timer expiration, those missed are caught up */
+static int simReadEvents(struct jabra_device *dev, struct hiddev_event *ev, int max) {
+  struct sim_priv *p = dev->priv;
+  __u64 expirations;
+  __u64 t0 = latencyNow();
+  int n = 0;
+
+  if (p->repeat != 0 && p->rounds >= p->repeat) {
+    return -1;
+  }
+  if (read(dev->fd, &expirations, sizeof(expirations)) < 0) {
+    deviceAccount(dev, DEVCALL_READ, t0, errno != EAGAIN);
+    return 0;
+  }
+  while (expirations-- > 0 && n + 2 <= max &&
+         (p->repeat == 0 || p->rounds < p->repeat)) {
+    n += scriptStep(p, &ev[n]);
+  }
+  p->events += n;
+  deviceAccount(dev, DEVCALL_READ, t0, 0);
+  return n;
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+const struct transport_ops sim_transport = {
+  .name          = "sim",
+  .subsystem     = NULL,
+  .node_prefix   = NULL,
+  .open          = simOpen,
+  .close         = simClose,
+  .build_usages  = simBuildUsages,
+  .check_usages  = NULL,
+  .resolve_usage = NULL,
+  .get_usage     = simGetUsage,
+  .set_usages    = simSetUsages,
+  .send_report   = simSendReport,
+  .read_events   = simReadEvents,
+};
@@ -0,0 +1,167 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_trace.c
+ *
+ * @brief  Capture and load of input event traces, see jabra_trace.h.
+ *
+ *         A trace is the header, n_usages struct layout_usage padded to 8
+ *         bytes and then struct trace_event up to the end of the file, so a capture cut
+ *         short still loads up to its last complete event.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "jabra_latency.h"
+#include "jabra_trace.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+
+/* stdio buffer of a capture, the reader thread writes through it */
+#define TRACE_BUFFER         65536
+
+/* the events start 8-byte aligned after the usages */
+#define TRACE_EVENTS(n)      ((sizeof(struct trace_header) + \
+                               (n) * sizeof(struct layout_usage) + 7) & ~(size_t) 7)
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int traceCreate(struct trace_writer *tw, const char *path, struct jabra_device *dev) {
+  struct trace_header hdr;
+  struct layout_usage lu[MAX_CACHED_USAGES];
+  static const char pad[8];
+
+  if ((tw->f = fopen(path, "we")) == NULL) {
+    perror(path);
+    return -1;
+  }
+  (void)setvbuf(tw->f, NULL, _IOFBF, TRACE_BUFFER);
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic    = TRACE_MAGIC;
+  hdr.format   = TRACE_FORMAT;
+  hdr.n_usages = dev->usages.count;
+  hdr.vendor   = dev->devinfo.vendor;
+  hdr.product  = dev->devinfo.product;
+  hdr.version  = dev->devinfo.version;
+  snprintf(hdr.name, sizeof(hdr.name), "%s", dev->name);
+  (void)fwrite(&hdr, sizeof(hdr), 1, tw->f);
+
+  layoutPack(lu, &dev->usages);
+  (void)fwrite(lu, sizeof(lu[0]), hdr.n_usages, tw->f);
+  (void)fwrite(pad, TRACE_EVENTS(hdr.n_usages) - sizeof(hdr) - hdr.n_usages * sizeof(lu[0]), 1, tw->f);
+  tw->start_ns = latencyNow();
+  tw->events = 0;
+  return 0;
+}
+
+void traceAppend(struct trace_writer *tw, __u64 read_ns, const struct hiddev_event *ev, int n) {
+  struct trace_event te;
+
+  te.time_ns = read_ns - tw->start_ns;
+  for (int i = 0; i < n; i++) {
+    te.hid   = ev[i].hid;
+    te.value = ev[i].value;
+    (void)fwrite(&te, sizeof(te), 1, tw->f);
+  }
+  tw->events += n;
+}
+
+int traceFinish(struct trace_writer *tw) {
+  int failed = ferror(tw->f);
+
+  if (fclose(tw->f) != 0 || failed) {
+    return -1;
+  }
+  return 0;
+}
+
+int traceLoad(struct trace *tr, const char *path) {
+  const struct trace_header *hdr;
+  struct stat st;
+  size_t events;
+  void *map;
+  int fd;
+
+  memset(tr, 0, sizeof(*tr));
+  if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+    perror(path);
+    return -1;
+  }
+  if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(*hdr)) {
+    fprintf(stderr, "%s: not a trace\n", path);
+    close(fd);
+    return -1;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror(path);
+    return -1;
+  }
+
+  hdr = map;
+  events = TRACE_EVENTS(hdr->n_usages);
+  if (hdr->magic != TRACE_MAGIC || hdr->format != TRACE_FORMAT ||
+      hdr->n_usages > MAX_CACHED_USAGES || events > (size_t) st.st_size) {
+    fprintf(stderr, "%s: not a trace\n", path);
+    munmap(map, st.st_size);
+    return -1;
+  }
+  /* the events are read ahead of the replay */
+  (void)madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+  tr->map      = map;
+  tr->size     = st.st_size;
+  tr->hdr      = hdr;
+  tr->usage    = (const struct layout_usage *)(hdr + 1);
+  tr->event    = (const struct trace_event *)((const char *)map + events);
+  tr->n_events = (st.st_size - events) / sizeof(struct trace_event);
+  return 0;
+}
+
+void traceUnload(struct trace *tr) {
+  if (tr->map != NULL) {
+    munmap((void *)tr->map, tr->size);
+    tr->map = NULL;
+  }
+}
+
+void traceUsages(const struct trace *tr, struct usage_cache *usages) {
+  layoutUnpack(usages, tr->usage, tr->hdr->n_usages);
+}
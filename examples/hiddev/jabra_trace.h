@@ -0,0 +1,112 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_trace.h
+ *
+ * @brief  Binary traces of the input events of one device. A trace holds
+ *         the identity and usage layout of the device it was captured
+ *         from, followed by every struct hiddev_event read from it,
+ *         stamped with the monotonic time of the read relative to the
+ *         start of the capture. Events returned by the same read share a
+ *         stamp, so the batches can be replayed as they arrived.
+ *
+ *         Traces are written with stdio and read back memory-mapped.
+ */
+
+#ifndef JABRA_TRACE_H
+#define JABRA_TRACE_H
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+#include <linux/hiddev.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "jabra_device.h"
+#include "jabra_layout.h"
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+#define TRACE_MAGIC          0x4352544A  /* "JTRC" */
+#define TRACE_FORMAT         1
+
+struct trace_header {
+  __u32 magic;
+  __u16 format;
+  __u16 n_usages;
+  __u16 vendor;
+  __u16 product;
+  __s16 version;
+  __u16 reserved;
+  char  name[128];
+};
+
+struct trace_event {
+  __u64 time_ns;         /* read() returned, since the start of the capture */
+  __u32 hid;
+  __s32 value;
+};
+
+/* Trace being captured */
+struct trace_writer {
+  FILE *f;
+  __u64 start_ns;
+  unsigned long events;
+};
+
+/* Trace loaded for replay */
+struct trace {
+  const void *map;
+  size_t size;
+  const struct trace_header *hdr;
+  const struct layout_usage *usage;
+  const struct trace_event *event;
+  unsigned long n_events;
+};
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+
+/* start a trace of dev at path, -1 if the file cannot be written */
+int traceCreate(struct trace_writer *tw, const char *path, struct jabra_device *dev);
+
+/* add the n events of one read that returned at read_ns (latencyNow()) */
+void traceAppend(struct trace_writer *tw, __u64 read_ns, const struct hiddev_event *ev, int n);
+
+/* flush and close, -1 if any write failed */
+int traceFinish(struct trace_writer *tw);
+
+/* map a trace, -1 if it cannot be read or is not a valid trace */
+int traceLoad(struct trace *tr, const char *path);
+void traceUnload(struct trace *tr);
+
+/* the usage layout of the traced device */
+void traceUsages(const struct trace *tr, struct usage_cache *usages);
+
+#endif /* JABRA_TRACE_H */
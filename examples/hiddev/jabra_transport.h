@@ -0,0 +1,97 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file   jabra_transport.h
+ *
+ * @brief  HID transport interface. The device layer reaches the kernel
+ *         only through these operations, so the same call control runs
+ *         on top of hiddev (one ioctl per usage, 8 byte events) or
+ *         hidraw (whole reports with one read() or write()), or on a
+ *         trace captured from either of them, or on a simulated device.
+ */
+
+#ifndef JABRA_TRANSPORT_H
+#define JABRA_TRANSPORT_H
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+#include <linux/hiddev.h>
+
+/****************************************************************************/
+/*                      EXPORTED TYPES and DEFINITIONS                      */
+/****************************************************************************/
+struct jabra_device;
+struct usage_entry;
+
+struct transport_ops {
+  const char *name;
+  const char *subsystem;     /* sysfs class and uevent SUBSYSTEM */
+  const char *node_prefix;   /* device nodes are node_prefix<N> */
+
+  /* open dev->path, fill fd, devinfo and name */
+  int  (*open)(struct jabra_device *dev);
+  void (*close)(struct jabra_device *dev);
+
+  /* fill dev->usages with every usage of the device */
+  void (*build_usages)(struct jabra_device *dev);
+  /* check a layout loaded from the capability cache, NULL if the
+   * transport does not use the capability cache */
+  int  (*check_usages)(struct jabra_device *dev);
+  /* locate a usage missing from dev->usages, NULL if not supported */
+  int  (*resolve_usage)(struct jabra_device *dev, __u32 report_type, __u32 usage_code,
+                        struct usage_entry *u);
+
+  int  (*get_usage)(struct jabra_device *dev, const struct usage_entry *u, __s32 *value);
+  /* set n consecutive usages of one field, starting at u */
+  int  (*set_usages)(struct jabra_device *dev, const struct usage_entry *u,
+                     const __s32 *values, int n);
+  int  (*send_report)(struct jabra_device *dev, __u32 report_type, __u32 report_id);
+
+  /* read pending input, returns the number of events stored in ev,
+   * 0 if nothing of interest arrived and -1 if the device is gone */
+  int  (*read_events)(struct jabra_device *dev, struct hiddev_event *ev, int max);
+};
+
+extern const struct transport_ops hiddev_transport;
+extern const struct transport_ops hidraw_transport;
+/* device paths are trace files, see jabra_trace.h */
+extern const struct transport_ops replay_transport;
+/* device paths describe a simulated headset, see jabra_sim.c */
+extern const struct transport_ops sim_transport;
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+
+/* "hiddev" or "hidraw", NULL if unknown */
+const struct transport_ops *transportByName(const char *name);
+
+/* replay traces at their recorded pace instead of as fast as possible,
+ * applies to traces opened afterwards, each keeps the pace it was
+ * opened with */
+void replaySetPaced(int on);
+
+#endif /* JABRA_TRANSPORT_H */
@@ -0,0 +1,611 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_transport_test.c
+ *
+ * @brief  Behavioral test of the hiddev and hidraw transports. The same
+ *         call control scenario runs on both, and both must turn it into
+ *         the same input events and the same output reports.
+ *
+ *         There is no headset, the kernel side is faked instead: the
+ *         program is linked with -Wl,--wrap for open, close, ioctl, read
+ *         and write, and paths below /fake/ are answered by a model of
+ *         the telephony headset of jabra_uhid_headset.c. The model parses
+ *         the same report descriptor with jabra_rdesc.h and serves the
+ *         hiddev ioctls (report, field and usage tables, usage values,
+ *         HIDIOCSREPORT) and the hidraw ones (descriptor, whole reports
+ *         through read() and write()). Any other fd goes to the C library.
+ *
+ *         Usage: jabra_transport_test, run by make check.
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/hiddev.h>
+#include <linux/hidraw.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "jabra_callctl.h"
+#include "jabra_device.h"
+#include "jabra_hid.h"
+#include "jabra_log.h"
+#include "jabra_rdesc.h"
+#include "jabra_test.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+#define FAKE_PREFIX          "/fake/"
+#define FAKE_PRODUCT         0x0999
+#define FAKE_INPUTS          16    /* input reports queued at a time */
+#define FAKE_SENT            32    /* output reports remembered */
+
+/* input report 1 bits */
+#define IN_HOOK              0x01
+#define IN_MUTE              0x02
+#define IN_VOLUME_UP         0x04
+
+/* usages of each input report 3 array */
+#define BUTTONS              200
+
+/* output report 2 bits */
+#define OUT_MUTE             0x01
+#define OUT_OFF_HOOK         0x02
+#define OUT_RING             0x04
+#define OUT_RINGER           0x08
+
+/* ioctl request without its size, for the variable length ones */
+#define IOC_BASE(req)        ((req) & ~((unsigned long) _IOC_SIZEMASK << _IOC_SIZESHIFT))
+
+/* the kernel side of one open node */
+struct fake_headset {
+  int fd;                /* -1 when not open */
+  int hidraw;            /* hidraw node, else hiddev */
+  struct rdesc rd;
+  struct rdesc_decoder dec;
+  struct rdesc_state state;
+  __u8 report[RDESC_MAX_REPORTS][RDESC_MAX_REPORT + 1];  /* id + data */
+  __u8 input[FAKE_INPUTS][2];                            /* waiting to be read */
+  int n_inputs;
+  __u8 sent[FAKE_SENT];  /* output report 2 data bytes as sent */
+  int n_sent;
+};
+
+/* what the scenario saw on one transport */
+struct outcome {
+  struct hiddev_event ev[64];
+  int n_ev;
+  __u8 sent[FAKE_SENT];
+  int n_sent;
+  __u32 state[16];       /* call state after each step */
+  int n_state;
+};
+
+/****************************************************************************/
+/*                              PRIVATE DATA                                */
+/****************************************************************************/
+
+/* the descriptor of the headsets of jabra_uhid_headset.c, with input
+ * report 3 added: two arrays of button usages, together more than the
+ * usage cache holds, which the headset never sends */
+static const __u8 report_descriptor[] = {
+  0x05, 0x0B, 0x09, 0x05, 0xA1, 0x01,
+  0x85, 0x01, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x02,
+  0x09, 0x20, 0x09, 0x2F, 0x81, 0x02,
+  0x05, 0x0C, 0x09, 0xE9, 0x09, 0xEA, 0x81, 0x02,
+  0x95, 0x04, 0x81, 0x03,
+  0x85, 0x02, 0x05, 0x08, 0x95, 0x03, 0x09, 0x09, 0x09, 0x17, 0x09, 0x18, 0x91, 0x02,
+  0x05, 0x0B, 0x95, 0x01, 0x09, 0x9E, 0x91, 0x02,
+  0x95, 0x04, 0x91, 0x03,
+  0x85, 0x03, 0x05, 0x09, 0x75, 0x10, 0x95, 0x01,
+  0x19, 0x01, 0x2A, BUTTONS & 0xFF, BUTTONS >> 8,
+  0x15, 0x01, 0x26, BUTTONS & 0xFF, BUTTONS >> 8, 0x81, 0x00,
+  0x1A, (BUTTONS + 1) & 0xFF, (BUTTONS + 1) >> 8, 0x2A, (2 * BUTTONS) & 0xFF, (2 * BUTTONS) >> 8,
+  0x16, (BUTTONS + 1) & 0xFF, (BUTTONS + 1) >> 8, 0x26, (2 * BUTTONS) & 0xFF, (2 * BUTTONS) >> 8,
+  0x81, 0x00,
+  0xC0,
+};
+
+static struct fake_headset fake = { -1 };
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+int __real_open(const char *path, int flags, ...);
+int __real_close(int fd);
+int __real_ioctl(int fd, unsigned long request, ...);
+ssize_t __real_read(int fd, void *buf, size_t count);
+ssize_t __real_write(int fd, const void *buf, size_t count);
+
+static struct fake_headset *fakeOf(int fd) {
+  return (fd >= 0 && fd == fake.fd) ? &fake : NULL;
+}
+
+static int fail(int err) {
+  errno = err;
+  return -1;
+}
+
+static const struct rdesc_field *fakeField(struct fake_headset *f, __u32 type, __u32 id, __u32 index) {
+  for (int i = 0; i < f->rd.n_fields; i++) {
+    const struct rdesc_field *fl = &f->rd.field[i];
+    if (fl->report_type == type && fl->report_id == id && fl->field_index == index) {
+      return fl;
+    }
+  }
+  return NULL;
+}
+
+static __u8 *fakeReport(struct fake_headset *f, __u32 type, __u32 id) {
+  int ri = rdescFindReport(&f->rd, type, id);
+
+  return ri < 0 ? NULL : f->report[ri];
+}
+
+static int fakeRecordSent(struct fake_headset *f, const __u8 *report) {
+  if (report[0] != 2 || f->n_sent >= FAKE_SENT) {
+    return fail(EINVAL);
+  }
+  f->sent[f->n_sent++] = report[1];
+  return 0;
+}
+
+/* HIDIOCGREPORTINFO: with HID_REPORT_ID_FIRST or _NEXT the report after
+ * the given id, like the kernel */
+static int fakeReportInfo(struct fake_headset *f, struct hiddev_report_info *rinfo) {
+  __u32 id = rinfo->report_id;
+  int best = -1;
+
+  for (int i = 0; i < f->rd.n_reports; i++) {
+    const struct rdesc_report *r = &f->rd.report[i];
+    int match;
+
+    if (r->report_type != rinfo->report_type) {
+      continue;
+    }
+    if (id & HID_REPORT_ID_FIRST) {
+      match = 1;
+    } else if (id & HID_REPORT_ID_NEXT) {
+      match = r->report_id > (id & HID_REPORT_ID_MASK);
+    } else {
+      match = r->report_id == id;
+    }
+    if (match && (best < 0 || r->report_id < f->rd.report[best].report_id)) {
+      best = i;
+    }
+  }
+  if (best < 0) {
+    return fail(EINVAL);
+  }
+  rinfo->report_id  = f->rd.report[best].report_id;
+  rinfo->num_fields = f->rd.report[best].n_fields;
+  return 0;
+}
+
+static int fakeFieldInfo(struct fake_headset *f, struct hiddev_field_info *finfo) {
+  const struct rdesc_field *fl = fakeField(f, finfo->report_type, finfo->report_id, finfo->field_index);
+
+  if (fl == NULL) {
+    return fail(EINVAL);
+  }
+  finfo->maxusage        = fl->n_usages;
+  finfo->flags           = fl->flags;
+  finfo->logical_minimum = fl->logical_minimum;
+  finfo->logical_maximum = fl->logical_maximum;
+  finfo->physical = finfo->logical = finfo->application = 0;
+  return 0;
+}
+
+/* HIDIOCGUSAGE with HID_REPORT_ID_UNKNOWN looks the usage up first */
+static int fakeLocate(struct fake_headset *f, struct hiddev_usage_ref *uref) {
+  for (int i = 0; i < f->rd.n_fields; i++) {
+    const struct rdesc_field *fl = &f->rd.field[i];
+    if (fl->report_type != uref->report_type) {
+      continue;
+    }
+    for (int j = 0; j < fl->n_usages; j++) {
+      if (f->rd.usage[fl->first_usage + j] == uref->usage_code) {
+        uref->report_id   = fl->report_id;
+        uref->field_index = fl->field_index;
+        uref->usage_index = j;
+        return 0;
+      }
+    }
+  }
+  return fail(EINVAL);
+}
+
+/* HIDIOCGUCODE: any usage of the field, arrays included */
+static int fakeUsageCode(struct fake_headset *f, struct hiddev_usage_ref *uref) {
+  const struct rdesc_field *fl = fakeField(f, uref->report_type, uref->report_id, uref->field_index);
+
+  if (fl == NULL || uref->usage_index >= fl->n_usages) {
+    return fail(EINVAL);
+  }
+  uref->usage_code = f->rd.usage[fl->first_usage + uref->usage_index];
+  return 0;
+}
+
+/* value of uref, or set it when value is not NULL */
+static int fakeUsage(struct fake_headset *f, struct hiddev_usage_ref *uref, const __s32 *value) {
+  const struct rdesc_field *fl = fakeField(f, uref->report_type, uref->report_id, uref->field_index);
+  __u8 *report = fakeReport(f, uref->report_type, uref->report_id);
+  __u32 bit;
+
+  if (fl == NULL || report == NULL || uref->usage_index >= fl->count) {
+    return fail(EINVAL);
+  }
+  bit = fl->bit_offset + uref->usage_index * fl->bit_size;
+  if (value != NULL) {
+    rdescInsert(report + 1, bit, fl->bit_size, (__u32) *value);
+  } else {
+    uref->value = (__s32) rdescExtract(report + 1, bit, fl->bit_size);
+  }
+  uref->usage_code = f->rd.usage[fl->first_usage + uref->usage_index];
+  return 0;
+}
+
+static int fakeHiddevIoctl(struct fake_headset *f, unsigned long request, void *arg) {
+  struct hiddev_usage_ref_multi *mref = arg;
+  struct hiddev_usage_ref *uref = arg;
+  struct hiddev_report_info *rinfo = arg;
+  struct hiddev_devinfo *info = arg;
+
+  switch (request) {
+    case HIDIOCGDEVINFO:
+      memset(info, 0, sizeof(*info));
+      info->bustype = 3;
+      info->vendor  = JABRA_VID;
+      info->product = FAKE_PRODUCT;
+      info->num_applications = 1;
+      return 0;
+    case HIDIOCINITREPORT:
+      return 0;
+    case HIDIOCGREPORTINFO:
+      return fakeReportInfo(f, rinfo);
+    case HIDIOCGFIELDINFO:
+      return fakeFieldInfo(f, arg);
+    case HIDIOCGUCODE:
+      return fakeUsageCode(f, uref);
+    case HIDIOCGUSAGE:
+      if (uref->report_id == HID_REPORT_ID_UNKNOWN && fakeLocate(f, uref) < 0) {
+        return -1;
+      }
+      return fakeUsage(f, uref, NULL);
+    case HIDIOCSUSAGE:
+      return fakeUsage(f, uref, &uref->value);
+    case HIDIOCSUSAGES:
+      for (int k = 0; k < mref->num_values; k++) {
+        struct hiddev_usage_ref u = mref->uref;
+
+        u.usage_index += k;
+        if (fakeUsage(f, &u, &mref->values[k]) < 0) {
+          return -1;
+        }
+      }
+      return 0;
+    case HIDIOCSREPORT:
+      if (rinfo->report_type != HID_REPORT_TYPE_OUTPUT) {
+        return fail(EINVAL);
+      }
+      return fakeRecordSent(f, fakeReport(f, rinfo->report_type, rinfo->report_id));
+    default:
+      break;
+  }
+  if (IOC_BASE(request) == IOC_BASE(HIDIOCGNAME(0))) {
+    snprintf(arg, _IOC_SIZE(request), "Fake Jabra hiddev headset");
+    return 0;
+  }
+  return fail(ENOTTY);
+}
+
+static int fakeHidrawIoctl(struct fake_headset *f, unsigned long request, void *arg) {
+  struct hidraw_report_descriptor *desc = arg;
+  struct hidraw_devinfo *info = arg;
+  int len = _IOC_SIZE(request);
+  __u8 *buf = arg;
+  __u8 *report;
+
+  switch (request) {
+    case HIDIOCGRAWINFO:
+      info->bustype = 3;
+      info->vendor  = JABRA_VID;
+      info->product = FAKE_PRODUCT;
+      return 0;
+    case HIDIOCGRDESCSIZE:
+      *(int *) arg = sizeof(report_descriptor);
+      return 0;
+    case HIDIOCGRDESC:
+      if (desc->size > sizeof(report_descriptor)) {
+        return fail(EINVAL);
+      }
+      memcpy(desc->value, report_descriptor, desc->size);
+      return 0;
+    default:
+      break;
+  }
+  if (IOC_BASE(request) == IOC_BASE(HIDIOCGRAWNAME(0))) {
+    snprintf(arg, len, "Fake Jabra hidraw headset");
+    return 0;
+  }
+  if (IOC_BASE(request) == IOC_BASE(HIDIOCGOUTPUT(0)) &&
+      (report = fakeReport(f, HID_REPORT_TYPE_OUTPUT, buf[0])) != NULL) {
+    memcpy(buf, report, len);
+    return len;
+  }
+  return fail(IOC_BASE(request) == IOC_BASE(HIDIOCGFEATURE(0)) ? EINVAL : ENOTTY);
+}
+
+/****************************************************************************/
+/*                  WRAPPED C LIBRARY CALLS (-Wl,--wrap)                    */
+/****************************************************************************/
+int __wrap_open(const char *path, int flags, ...);
+int __wrap_close(int fd);
+int __wrap_ioctl(int fd, unsigned long request, ...);
+ssize_t __wrap_read(int fd, void *buf, size_t count);
+ssize_t __wrap_write(int fd, const void *buf, size_t count);
+
+int __wrap_open(const char *path, int flags, ...) {
+  va_list ap;
+  int mode;
+
+  va_start(ap, flags);
+  mode = (flags & O_CREAT) ? va_arg(ap, int) : 0;
+  va_end(ap);
+  if (strncmp(path, FAKE_PREFIX, strlen(FAKE_PREFIX)) != 0) {
+    return __real_open(path, flags, mode);
+  }
+  if (fake.fd >= 0) {
+    return fail(EBUSY);
+  }
+
+  /* a real fd, so that the number cannot clash with another one */
+  memset(&fake, 0, sizeof(fake));
+  if ((fake.fd = __real_open("/dev/null", O_RDWR | O_CLOEXEC)) < 0 ||
+      rdescParse(&fake.rd, report_descriptor, sizeof(report_descriptor)) < 0) {
+    return -1;
+  }
+  fake.hidraw = strstr(path, "hidraw") != NULL;
+  rdescCompile(&fake.rd, &fake.dec);
+  for (int i = 0; i < fake.rd.n_reports; i++) {
+    fake.report[i][0] = fake.rd.report[i].report_id;
+  }
+  return fake.fd;
+}
+
+int __wrap_close(int fd) {
+  if (fakeOf(fd) != NULL) {
+    fake.fd = -1;
+  }
+  return __real_close(fd);
+}
+
+int __wrap_ioctl(int fd, unsigned long request, ...) {
+  struct fake_headset *f = fakeOf(fd);
+  va_list ap;
+  void *arg;
+
+  va_start(ap, request);
+  arg = va_arg(ap, void *);
+  va_end(ap);
+  if (f == NULL) {
+    return __real_ioctl(fd, request, arg);
+  }
+  return f->hidraw ? fakeHidrawIoctl(f, request, arg) : fakeHiddevIoctl(f, request, arg);
+}
+
+/* hidraw: the next input report, hiddev: the events it makes */
+ssize_t __wrap_read(int fd, void *buf, size_t count) {
+  struct fake_headset *f = fakeOf(fd);
+  __u8 report[2 + RDESC_DECODE_PAD];
+  int n;
+
+  if (f == NULL) {
+    return __real_read(fd, buf, count);
+  }
+  if (f->n_inputs == 0) {
+    return fail(EAGAIN);
+  }
+  memset(report, 0, sizeof(report));
+  memcpy(report, f->input[0], 2);
+  memmove(f->input[0], f->input[1], (--f->n_inputs) * sizeof(f->input[0]));
+  if (f->hidraw) {
+    memcpy(buf, report, count < 2 ? count : 2);
+    return count < 2 ? count : 2;
+  }
+  n = rdescDecode(&f->dec, &f->state, report, 2, buf, count / sizeof(struct hiddev_event));
+  return n < 0 ? fail(EIO) : n * (ssize_t) sizeof(struct hiddev_event);
+}
+
+/* hidraw only: an output report, with the id since they are numbered */
+ssize_t __wrap_write(int fd, const void *buf, size_t count) {
+  struct fake_headset *f = fakeOf(fd);
+  const __u8 *data = buf;
+  __u8 *report;
+
+  if (f == NULL) {
+    return __real_write(fd, buf, count);
+  }
+  if (!f->hidraw || count != 2 || (report = fakeReport(f, HID_REPORT_TYPE_OUTPUT, data[0])) == NULL) {
+    return fail(EINVAL);
+  }
+  memcpy(report, data, count);
+  return fakeRecordSent(f, report) < 0 ? -1 : (ssize_t) count;
+}
+
+/****************************************************************************/
+/*                                SCENARIO                                  */
+/****************************************************************************/
+
+/* the headset sends input report 1 with bits, the program reads and
+ * handles it like the demo's handler thread does */
+static void press(struct jabra_device *dev, struct outcome *out, __u8 bits) {
+  struct hiddev_event ev[16];
+  struct output_txn txn;
+  int n, event;
+
+  fake.input[fake.n_inputs][0] = 1;
+  fake.input[fake.n_inputs][1] = bits;
+  fake.n_inputs++;
+  n = deviceReadEvents(dev, ev, 16);
+  CHECK(n >= 0);
+
+  (void)pthread_mutex_lock(&dev->lock);
+  txnBegin(&txn, dev);
+  for (int i = 0; i < n; i++) {
+    if (out->n_ev < 64)
+      out->ev[out->n_ev++] = ev[i];
+    if ((event = callEvent(ev[i].hid, ev[i].value)) >= 0)
+      (void)callStep(dev, &txn, event);
+  }
+  txnCommit(&txn);
+  (void)pthread_mutex_unlock(&dev->lock);
+  out->state[out->n_state++] = callState(dev) & CALL_FLAGS;
+}
+
+/* a local command, like a key press or a control client */
+static void command(struct jabra_device *dev, struct outcome *out, int event) {
+  struct output_txn txn;
+
+  (void)pthread_mutex_lock(&dev->lock);
+  txnBegin(&txn, dev);
+  (void)callStep(dev, &txn, event);
+  txnCommit(&txn);
+  (void)pthread_mutex_unlock(&dev->lock);
+  out->state[out->n_state++] = callState(dev) & CALL_FLAGS;
+}
+
+static void runScenario(const struct transport_ops *ops, const char *path, struct outcome *out) {
+  struct jabra_device *dev;
+  int cached;
+
+  memset(out, 0, sizeof(*out));
+  dev = deviceOpen(ops, path, JABRA_VID);
+  CHECK(dev != NULL);
+  if (dev == NULL) {
+    return;
+  }
+  CHECK_EQ(callState(dev) & CALL_FLAGS, 0);
+  CHECK(strstr(dev->name, ops->name) != NULL);
+
+  /* the second button array does not fit, the outputs are cached all
+   * the same even though they come last in the descriptor */
+  CHECK_EQ(dev->usages.skipped, BUTTONS);
+  CHECK(findUsage(&dev->usages, HID_REPORT_TYPE_OUTPUT, (LEDUsagePage << 16) | Led_Off_Hook) != NULL);
+  CHECK(findUsage(&dev->usages, HID_REPORT_TYPE_OUTPUT, (LEDUsagePage << 16) | Led_Mute) != NULL);
+  CHECK(findUsage(&dev->usages, HID_REPORT_TYPE_OUTPUT, (LEDUsagePage << 16) | Led_Ring) != NULL);
+  CHECK(findUsage(&dev->usages, HID_REPORT_TYPE_OUTPUT, (TelephonyUsagePage << 16) | Tel_Ringer) != NULL);
+  cached = dev->usages.count;
+
+  press(dev, out, IN_HOOK);                  /* call answered on the headset */
+  press(dev, out, IN_HOOK | IN_MUTE);        /* mute pressed */
+  press(dev, out, IN_HOOK);                  /* mute released, nothing to send */
+  press(dev, out, IN_HOOK | IN_VOLUME_UP);   /* volume, not call control */
+  press(dev, out, IN_HOOK);
+  press(dev, out, 0);                        /* hung up, still muted */
+  command(dev, out, CALL_EV_KEY_RING);       /* incoming call */
+  press(dev, out, IN_HOOK);                  /* answered, ringer stops */
+  command(dev, out, CALL_EV_KEY_MUTE);       /* unmuted by the program */
+
+  memcpy(out->sent, fake.sent, fake.n_sent);
+  out->n_sent = fake.n_sent;
+  /* and no write needed a slot of its own */
+  CHECK_EQ(dev->usages.count, cached);
+  deviceClose(dev);
+  CHECK_EQ(fake.fd, -1);
+}
+
+static void checkOutcome(const char *name, const struct outcome *out) {
+  static const __u32 state[] = {
+    CALL_HOOK, CALL_HOOK | CALL_MUTE, CALL_HOOK | CALL_MUTE, CALL_HOOK | CALL_MUTE,
+    CALL_HOOK | CALL_MUTE, CALL_MUTE, CALL_MUTE | CALL_RING, CALL_HOOK | CALL_MUTE,
+    CALL_HOOK,
+  };
+  static const __u8 sent[] = {
+    OUT_OFF_HOOK,
+    OUT_OFF_HOOK | OUT_MUTE,
+    OUT_MUTE,
+    OUT_MUTE | OUT_RING | OUT_RINGER,
+    OUT_MUTE | OUT_OFF_HOOK,
+    OUT_OFF_HOOK,
+  };
+  /* the first report reports every value, later ones what changed */
+  static const struct hiddev_event ev[] = {
+    { (TelephonyUsagePage << 16) | Tel_Hook_Switch, 1 },
+    { (TelephonyUsagePage << 16) | Tel_Phone_Mute, 0 },
+    { (ConsumerUsagePage << 16) | Con_Volume_Incr, 0 },
+    { (ConsumerUsagePage << 16) | Con_Volume_Decr, 0 },
+    { (TelephonyUsagePage << 16) | Tel_Phone_Mute, 1 },
+    { (TelephonyUsagePage << 16) | Tel_Phone_Mute, 0 },
+    { (ConsumerUsagePage << 16) | Con_Volume_Incr, 1 },
+    { (ConsumerUsagePage << 16) | Con_Volume_Incr, 0 },
+    { (TelephonyUsagePage << 16) | Tel_Hook_Switch, 0 },
+    { (TelephonyUsagePage << 16) | Tel_Hook_Switch, 1 },
+  };
+
+  fprintf(stdout, "%s: %d events, %d output reports\n", name, out->n_ev, out->n_sent);
+  CHECK_EQ(out->n_state, sizeof(state) / sizeof(state[0]));
+  for (int i = 0; i < out->n_state && i < sizeof(state) / sizeof(state[0]); i++) {
+    CHECK_EQ(out->state[i], state[i]);
+  }
+  CHECK_EQ(out->n_sent, sizeof(sent));
+  for (int i = 0; i < out->n_sent && i < sizeof(sent); i++) {
+    CHECK_EQ(out->sent[i], sent[i]);
+  }
+  CHECK_EQ(out->n_ev, sizeof(ev) / sizeof(ev[0]));
+  for (int i = 0; i < out->n_ev && i < sizeof(ev) / sizeof(ev[0]); i++) {
+    CHECK_EQ(out->ev[i].hid, ev[i].hid);
+    CHECK_EQ(out->ev[i].value, ev[i].value);
+  }
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int main(int argc, char **argv) {
+  struct outcome hiddev, hidraw;
+
+  if (logInit(LOG_WARN) < 0) {
+    return 1;
+  }
+  runScenario(&hiddev_transport, FAKE_PREFIX "hiddev0", &hiddev);
+  checkOutcome("hiddev", &hiddev);
+  runScenario(&hidraw_transport, FAKE_PREFIX "hidraw0", &hidraw);
+  checkOutcome("hidraw", &hidraw);
+
+  /* and the two agree with each other, not only with the expectation */
+  CHECK(hiddev.n_sent == hidraw.n_sent && memcmp(hiddev.sent, hidraw.sent, hiddev.n_sent) == 0);
+  CHECK(hiddev.n_ev == hidraw.n_ev &&
+        memcmp(hiddev.ev, hidraw.ev, hiddev.n_ev * sizeof(hiddev.ev[0])) == 0);
+  logClose();
+  return testResult("jabra_transport_test");
+}
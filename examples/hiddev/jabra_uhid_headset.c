@@ -0,0 +1,449 @@
+/* MIT License
+ *
+ * Copyright (c) 2017 GN Audio A/S (Jabra)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file   jabra_uhid_headset.c
+ *
+ * @brief  Virtual Jabra headsets for benchmarking through the kernel.
+ *         Every headset is a /dev/uhid device with the Jabra vendor id
+ *         and a telephony report descriptor carrying the usages of
+ *         jabra_hid.h: hook switch, phone mute and volume up/down in
+ *         input report 1, the mute, off-hook and ring LEDs and the
+ *         ringer in output report 2.
+ *
+ *         Once a reader has opened a headset, script steps are injected
+ *         at the given rate as input reports, and the output reports
+ *         coming back are counted. The time from a hook or mute report
+ *         to the next output report is the round trip through the
+ *         kernel and the program under test.
+ *
+ *         uhid devices are not USB devices, so the kernel gives them a
+ *         /dev/hidraw node but no hiddev node; run the demo with
+ *         -t hidraw against them. Needs write access to /dev/uhid.
+ *
+ *         Usage: jabra_uhid_headset [-n headsets] [-r steps/s per headset]
+ *                                   [-d seconds] [-s script]
+ *         The script uses the steps of jabra_sim.c: h toggles the hook
+ *         switch, m presses mute, + and - press volume, . waits.
+ *
+ *         To compile run make (see the Makefile), or:
+ *         gcc jabra_uhid_headset.c jabra_latency.c jabra_reactor.c \
+ *             -o jabra_uhid_headset
+ */
+
+/****************************************************************************/
+/*                              INCLUDE FILES                               */
+/****************************************************************************/
+#include <asm/types.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/uhid.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "jabra_hid.h"
+#include "jabra_latency.h"
+#include "jabra_reactor.h"
+
+/****************************************************************************/
+/*                      PRIVATE TYPES and DEFINITIONS                       */
+/****************************************************************************/
+#define MAX_HEADSETS         256
+#define HEADSET_PRODUCT      0x0999
+
+/* input report 1 bits */
+#define IN_HOOK              0x01
+#define IN_MUTE              0x02
+#define IN_VOLUME_UP         0x04
+#define IN_VOLUME_DOWN       0x08
+
+struct headset {
+  int fd;
+  int index;
+  int opened;            /* a reader has the hidraw node open */
+  __u8 input;            /* current input report 1 */
+  __u8 output;           /* last output report 2 */
+  int step;
+  __u64 inject_ns;       /* hook or mute report waiting for an answer */
+  unsigned long injected;
+  unsigned long outputs;
+  unsigned long requests; /* GET_REPORT and SET_REPORT answered */
+  unsigned long unanswered;
+};
+
+/****************************************************************************/
+/*                              PRIVATE DATA                                */
+/****************************************************************************/
+static const __u8 report_descriptor[] = {
+  0x05, 0x0B,        /* Usage Page (Telephony) */
+  0x09, 0x05,        /* Usage (Headset) */
+  0xA1, 0x01,        /* Collection (Application) */
+  0x85, 0x01,        /*   Report ID (1) */
+  0x15, 0x00,        /*   Logical Minimum (0) */
+  0x25, 0x01,        /*   Logical Maximum (1) */
+  0x75, 0x01,        /*   Report Size (1) */
+  0x95, 0x02,        /*   Report Count (2) */
+  0x09, 0x20,        /*   Usage (Hook Switch) */
+  0x09, 0x2F,        /*   Usage (Phone Mute) */
+  0x81, 0x02,        /*   Input (Data,Var,Abs) */
+  0x05, 0x0C,        /*   Usage Page (Consumer) */
+  0x09, 0xE9,        /*   Usage (Volume Increment) */
+  0x09, 0xEA,        /*   Usage (Volume Decrement) */
+  0x81, 0x02,        /*   Input (Data,Var,Abs) */
+  0x95, 0x04,        /*   Report Count (4) */
+  0x81, 0x03,        /*   Input (Const) */
+  0x85, 0x02,        /*   Report ID (2) */
+  0x05, 0x08,        /*   Usage Page (LED) */
+  0x95, 0x03,        /*   Report Count (3) */
+  0x09, 0x09,        /*   Usage (Mute) */
+  0x09, 0x17,        /*   Usage (Off-Hook) */
+  0x09, 0x18,        /*   Usage (Ring) */
+  0x91, 0x02,        /*   Output (Data,Var,Abs) */
+  0x05, 0x0B,        /*   Usage Page (Telephony) */
+  0x95, 0x01,        /*   Report Count (1) */
+  0x09, 0x9E,        /*   Usage (Ringer) */
+  0x91, 0x02,        /*   Output (Data,Var,Abs) */
+  0x95, 0x04,        /*   Report Count (4) */
+  0x91, 0x03,        /*   Output (Const) */
+  0xC0,              /* End Collection */
+};
+
+static struct reactor reactor;
+static struct headset headsets[MAX_HEADSETS];
+static int n_headsets = 1;
+static const char *script = "hmmh";
+static int next_headset = 0;
+static struct histogram round_trip;
+
+/****************************************************************************/
+/*                            PRIVATE FUNCTIONS                             */
+/****************************************************************************/
+static int sendEvent(struct headset *h, const struct uhid_event *ev) {
+  if (write(h->fd, ev, sizeof(*ev)) != sizeof(*ev)) {
+    perror("uhid write");
+    return -1;
+  }
+  return 0;
+}
+
+static int createHeadset(struct headset *h, int index) {
+  struct uhid_event ev;
+
+  h->index = index;
+  if ((h->fd = open("/dev/uhid", O_RDWR | O_CLOEXEC | O_NONBLOCK)) < 0) {
+    perror("/dev/uhid");
+    return -1;
+  }
+  memset(&ev, 0, sizeof(ev));
+  ev.type = UHID_CREATE2;
+  snprintf((char *) ev.u.create2.name, sizeof(ev.u.create2.name),
+    "Jabra Virtual Headset %d", index);
+  snprintf((char *) ev.u.create2.phys, sizeof(ev.u.create2.phys), "uhid/jabra%d", index);
+  memcpy(ev.u.create2.rd_data, report_descriptor, sizeof(report_descriptor));
+  ev.u.create2.rd_size = sizeof(report_descriptor);
+  ev.u.create2.bus     = BUS_USB;
+  ev.u.create2.vendor  = JABRA_VID;
+  ev.u.create2.product = HEADSET_PRODUCT;
+  ev.u.create2.version = 0x0100;
+  if (sendEvent(h, &ev) < 0) {
+    close(h->fd);
+    h->fd = -1;
+    return -1;
+  }
+  return 0;
+}
+
+static void destroyHeadset(struct headset *h) {
+  struct uhid_event ev;
+
+  if (h->fd < 0) {
+    return;
+  }
+  memset(&ev, 0, sizeof(ev));
+  ev.type = UHID_DESTROY;
+  (void)sendEvent(h, &ev);
+  close(h->fd);
+  h->fd = -1;
+}
+
+static void sendInput(struct headset *h) {
+  struct uhid_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.type = UHID_INPUT2;
+  ev.u.input2.size = 2;
+  ev.u.input2.data[0] = 1;
+  ev.u.input2.data[1] = h->input;
+  if (sendEvent(h, &ev) == 0) {
+    h->injected++;
+  }
+}
+
+/* a press is a report with the bit set followed by one without */
+static void press(struct headset *h, __u8 bit) {
+  h->input |= bit;
+  sendInput(h);
+  h->input &= ~bit;
+  sendInput(h);
+}
+
+static void scriptStep(struct headset *h) {
+  int answer = 0;
+
+  switch (script[h->step]) {
+    case 'h':
+      h->input ^= IN_HOOK;
+      sendInput(h);
+      answer = 1;
+      break;
+    case 'm':
+      press(h, IN_MUTE);
+      answer = 1;
+      break;
+    case '+':
+      press(h, IN_VOLUME_UP);
+      break;
+    case '-':
+      press(h, IN_VOLUME_DOWN);
+      break;
+    default:
+      break;
+  }
+  if (answer) {
+    if (h->inject_ns != 0)
+      h->unanswered++;
+    h->inject_ns = latencyNow();
+  }
+  if (script[++h->step] == '\0') {
+    h->step = 0;
+  }
+}
+
+static void outputReport(struct headset *h, const __u8 *data, int size) {
+  if (size >= 2 && data[0] == 2) {
+    h->output = data[1];
+  }
+  h->outputs++;
+  if (h->inject_ns != 0) {
+    histRecord(&round_trip, latencyNow() - h->inject_ns);
+    h->inject_ns = 0;
+  }
+}
+
+static void headset_event(int fd, __u32 events, void *arg) {
+  struct headset *h = arg;
+  struct uhid_event ev, reply;
+
+  if (read(fd, &ev, sizeof(ev)) <= 0) {
+    if (errno != EAGAIN) {
+      perror("uhid read");
+      reactorRemove(&reactor, fd);
+    }
+    return;
+  }
+  memset(&reply, 0, sizeof(reply));
+  switch (ev.type) {
+    case UHID_OPEN:
+      h->opened = 1;
+      fprintf(stdout, "[%d] opened\n", h->index);
+      break;
+    case UHID_CLOSE:
+      h->opened = 0;
+      h->inject_ns = 0;
+      fprintf(stdout, "[%d] closed\n", h->index);
+      break;
+    case UHID_OUTPUT:
+      outputReport(h, ev.u.output.data, ev.u.output.size);
+      break;
+    case UHID_GET_REPORT:
+      /* the last output report, input and feature reports are not kept */
+      reply.type = UHID_GET_REPORT_REPLY;
+      reply.u.get_report_reply.id = ev.u.get_report.id;
+      if (ev.u.get_report.rnum == 2) {
+        reply.u.get_report_reply.size = 2;
+        reply.u.get_report_reply.data[0] = 2;
+        reply.u.get_report_reply.data[1] = h->output;
+      } else if (ev.u.get_report.rnum == 1) {
+        reply.u.get_report_reply.size = 2;
+        reply.u.get_report_reply.data[0] = 1;
+        reply.u.get_report_reply.data[1] = h->input;
+      } else {
+        reply.u.get_report_reply.err = EIO;
+      }
+      h->requests++;
+      (void)sendEvent(h, &reply);
+      break;
+    case UHID_SET_REPORT:
+      if (ev.u.set_report.rtype == UHID_OUTPUT_REPORT) {
+        outputReport(h, ev.u.set_report.data, ev.u.set_report.size);
+      }
+      reply.type = UHID_SET_REPORT_REPLY;
+      reply.u.set_report_reply.id = ev.u.set_report.id;
+      h->requests++;
+      (void)sendEvent(h, &reply);
+      break;
+    default:
+      break;
+  }
+}
+
+/* one script step per expiration, handed round the opened headsets */
+static void tick_event(int fd, __u32 events, void *arg) {
+  __u64 expirations;
+
+  if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+    return;
+  }
+  while (expirations-- > 0) {
+    struct headset *h = &headsets[next_headset];
+
+    next_headset = (next_headset + 1) % n_headsets;
+    if (h->fd >= 0 && h->opened) {
+      scriptStep(h);
+    }
+  }
+}
+
+static void stop_event(int fd, __u32 events, void *arg) {
+  __u64 expirations;
+
+  (void)read(fd, &expirations, sizeof(expirations));
+  reactorStop(&reactor);
+}
+
+/****************************************************************************/
+/*                           EXPORTED FUNCTIONS                             */
+/****************************************************************************/
+int main(int argc, char **argv) {
+  struct itimerspec its;
+  sigset_t mask;
+  double rate = 10.0;
+  int seconds = 10;
+  int tickfd = -1, stopfd = -1;
+  unsigned long injected = 0, outputs = 0, requests = 0, unanswered = 0;
+  __u64 interval, start_ns;
+  double s;
+  int retval = -1;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:r:d:s:")) != -1) {
+    switch (opt) {
+      case 'n':
+        n_headsets = atoi(optarg);
+        break;
+      case 'r':
+        rate = atof(optarg);
+        break;
+      case 'd':
+        seconds = atoi(optarg);
+        break;
+      case 's':
+        script = optarg;
+        break;
+      default:
+        n_headsets = 0;
+        break;
+    }
+  }
+  if (n_headsets < 1 || n_headsets > MAX_HEADSETS || rate <= 0 || seconds < 1 || *script == '\0') {
+    fprintf(stderr, "usage: %s [-n 1-%d headsets] [-r steps/s per headset] [-d seconds] [-s script]\n",
+      argv[0], MAX_HEADSETS);
+    return -1;
+  }
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  sigprocmask(SIG_BLOCK, &mask, NULL);
+  if (reactorInit(&reactor) < 0) {
+    reactorClose(&reactor);
+    return -1;
+  }
+
+  for (int i = 0; i < n_headsets; i++) {
+    headsets[i].fd = -1;
+  }
+  for (int i = 0; i < n_headsets; i++) {
+    if (createHeadset(&headsets[i], i) < 0 ||
+        reactorAdd(&reactor, headsets[i].fd, headset_event, &headsets[i]) < 0) {
+      goto out;
+    }
+  }
+  fprintf(stdout, "%d headset(s) created, %.1f steps/s each while opened, for %d s\n",
+    n_headsets, rate, seconds);
+
+  /* the steps of all headsets are spread evenly over time */
+  interval = (__u64) (1e9 / (rate * n_headsets));
+  if (interval == 0)
+    interval = 1;
+  tickfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  stopfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (tickfd < 0 || stopfd < 0) {
+    perror("timerfd_create");
+    goto out;
+  }
+  its.it_interval.tv_sec  = interval / 1000000000ull;
+  its.it_interval.tv_nsec = interval % 1000000000ull;
+  its.it_value = its.it_interval;
+  (void)timerfd_settime(tickfd, 0, &its, NULL);
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = seconds;
+  (void)timerfd_settime(stopfd, 0, &its, NULL);
+  if (reactorAdd(&reactor, tickfd, tick_event, NULL) < 0 ||
+      reactorAdd(&reactor, stopfd, stop_event, NULL) < 0) {
+    goto out;
+  }
+
+  start_ns = latencyNow();
+  reactorRun(&reactor);
+  s = (latencyNow() - start_ns) / 1e9;
+
+  for (int i = 0; i < n_headsets; i++) {
+    injected   += headsets[i].injected;
+    outputs    += headsets[i].outputs;
+    requests   += headsets[i].requests;
+    unanswered += headsets[i].unanswered + (headsets[i].inject_ns != 0);
+  }
+  fprintf(stdout, "Input reports=%lu (%.0f/s) output reports=%lu (%.0f/s) requests=%lu"
+    " unanswered=%lu in %.3f s\n",
+    injected, injected / s, outputs, outputs / s, requests, unanswered, s);
+  histPrint("", "input->output", &round_trip);
+  retval = 0;
+
+out:
+  for (int i = 0; i < n_headsets; i++) {
+    destroyHeadset(&headsets[i]);
+  }
+  if (tickfd >= 0)
+    close(tickfd);
+  if (stopfd >= 0)
+    close(stopfd);
+  reactorClose(&reactor);
+  return retval;
+}